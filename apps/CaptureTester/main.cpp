@@ -22,6 +22,9 @@
 #include <algorithm> //used for transform string to lowercase
 #include <sgct.h>
 #include <FFmpegCapture.hpp>
+#include <PersistentUploadBuffer.hpp>
+#include <YUVConversionPass.hpp>
+#include <FrameConverter.hpp>
 
 #ifdef RGBEASY_ENABLED
 #include <RGBEasyCaptureCPU.hpp>
@@ -93,7 +96,9 @@ sgct::SharedBool stats(false);
 sgct::SharedFloat fadingTime(2.0f);
 
 //Captures (FFmpegCapture and RGBEasyCapture)
-void uploadFFmpegCaptureData(uint8_t ** data, int width, int height);
+void uploadFFmpegCaptureData(const FrameView & frame);
+bool uploadFrame(const FrameView & frame, GLuint texId, PersistentUploadBuffer & uploadBuffer, YUVConversionPass * yuvPass = nullptr);
+bool runYUVSelfTest();
 void parseArguments(int& argc, char**& argv);
 GLuint allocateCaptureTexture(int w, int h);
 void ffmpegCaptureLoop();
@@ -101,7 +106,7 @@ void startFFmpegCapture();
 void stopFFmpegCapture();
 
 #ifdef RGBEASY_ENABLED
-void uploadRGBEasyCaptureCPUData(void* data, unsigned long width, unsigned long height);
+void uploadRGBEasyCaptureCPUData(const FrameView & frame);
 void RGBEasyCaptureCPULoop();
 void startRGBEasyCaptureCPU();
 void stopRGBEasyCaptureCPU();
@@ -114,6 +119,7 @@ void stopRGBEasyCaptureGPU();
 #endif
 
 void calculateStats();
+void addUploadTime(double uploadTime);
 
 struct RT
 {
@@ -130,11 +136,23 @@ GLint Matrix_Loc_RT = -1;
 GLint ScaleUV_Loc = -1;
 GLint OffsetUV_Loc = -1;
 GLint flipFrame_Loc = -1;
+GLint FlipV_Loc = -1;
 
 GLuint ffmpegCaptureTexId = GL_FALSE;
 GLuint RGBEasyCaptureTexId = GL_FALSE;
 GLuint RGBEasyCapturePBO = GL_FALSE;
 
+//upload path, persistent mapped buffer or the map/unmap per frame path for comparison
+bool persistentUpload = true;
+PersistentUploadBuffer ffmpegUploadBuffer;
+PersistentUploadBuffer RGBEasyUploadBuffer;
+//YUV frames are uploaded as planes and converted on the GPU
+YUVConversionPass ffmpegYUVPass;
+bool yuvSelfTestRequested = false;
+std::atomic<std::size_t> uploadCount(0);
+std::atomic<double> uploadTimeLast(0.0);
+std::atomic<double> uploadTimeAverage(0.0);
+
 std::thread * ffmpegCaptureThread;
 std::thread * RGBEasyCaptureCPUThread;
 std::thread * RGBEasyCaptureGPUThread;
@@ -166,6 +184,8 @@ int main( int argc, char* argv[] )
     // -video <device name>
     // -option <key> <val>
     // -flip
+    // -uploadmode <persistent|map>
+    // -yuvselftest (compares the GPU YUV conversion with the CPU one at startup)
     // -plane <azimuth> <elevation> <roll>
     //
     // to obtain video device names in windows use:
@@ -254,11 +274,16 @@ void myDraw3DFun()
 
 	sgct::ShaderManager::instance()->bindShaderProgram("xform");
 	glActiveTexture(GL_TEXTURE0);
+	FrameOrientation orientation = FRAME_BOTTOM_UP;
 	if(ffmpegCaptureRequested) {
 		glBindTexture(GL_TEXTURE_2D, ffmpegCaptureTexId);
+		orientation = gFFmpegCapture->getOrientation();
 	}
     else if (RGBEasyCaptureCPURequested) {
         glBindTexture(GL_TEXTURE_2D, RGBEasyCaptureTexId);
+#ifdef RGBEASY_ENABLED
+        orientation = gRGBEasyCaptureCPU->getOrientation();
+#endif
     }
 	else if (RGBEasyCaptureGPURequested) {
 		glBindTexture(GL_TEXTURE_2D, captureRT.texture);
@@ -267,6 +292,7 @@ void myDraw3DFun()
 	glUniform2f(OffsetUV_Loc, 0.f, 0.f);
 	glUniform2f(OffsetUV_Loc, 0.f, 0.f);
 	glUniform1i(flipFrame_Loc, flipFrame);
+	glUniform1i(FlipV_Loc, needsVerticalFlip(orientation));
 	glUniformMatrix4fv(Matrix_Loc, 1, GL_FALSE, &MVP[0][0]);
 
     //draw square
@@ -292,11 +318,29 @@ void myDraw2DFun()
         sgct_text::print(font, sgct_text::TOP_LEFT,
             padding, static_cast<float>(gEngine->getCurrentWindowPtr()->getYFramebufferResolution() - font_size) - padding, //x and y pos
             glm::vec4(1.0, 1.0, 1.0, 1.0), //color
-            "Format: %s\nResolution: %d x %d\nRate: %.2lf Hz",
+            "Format: %s (conversion: %s, %u threads, %.3lf ms)\nResolution: %d x %d\nRate: %.2lf Hz\nQueues: packets %u/%u frames %u/%u\nDropped: packets %u frames %u (paced %u)\nUnchanged: %u frames skipped (signature %.3lf ms)\nLatency: %.2lf ms (avg %.2lf ms, max %.2lf ms)\nUpload CPU time (%s): %.3lf ms (avg %.3lf ms)",
             gFFmpegCapture->getFormat(),
+            ffmpegYUVPass.isInited() ? "gpu" : gFFmpegCapture->getConversionName(),
+            static_cast<unsigned int>(gFFmpegCapture->getConversionThreads()),
+            gFFmpegCapture->getAverageConversionTime() * 1000.0,
             gFFmpegCapture->getWidth(),
             gFFmpegCapture->getHeight(),
-            captureRate.getVal());
+            captureRate.getVal(),
+            static_cast<unsigned int>(gFFmpegCapture->getPacketQueueSize()),
+            static_cast<unsigned int>(gFFmpegCapture->getQueueDepth()),
+            static_cast<unsigned int>(gFFmpegCapture->getFrameQueueSize()),
+            static_cast<unsigned int>(gFFmpegCapture->getQueueDepth()),
+            static_cast<unsigned int>(gFFmpegCapture->getNumberOfDroppedPackets()),
+            static_cast<unsigned int>(gFFmpegCapture->getNumberOfDroppedFrames()),
+            static_cast<unsigned int>(gFFmpegCapture->getNumberOfPacedFrames()),
+            static_cast<unsigned int>(gFFmpegCapture->getNumberOfUnchangedFrames()),
+            gFFmpegCapture->getAverageSignatureTime() * 1000.0,
+            gFFmpegCapture->getLastDeliveryLatency() * 1000.0,
+            gFFmpegCapture->getAverageDeliveryLatency() * 1000.0,
+            gFFmpegCapture->getMaxDeliveryLatency() * 1000.0,
+            persistentUpload ? "persistent" : "map",
+            uploadTimeLast * 1000.0,
+            uploadTimeAverage * 1000.0);
     }
 }
 
@@ -326,11 +370,11 @@ void stopFFmpegCapture()
 }
 
 #ifdef RGBEASY_ENABLED
-void uploadRGBEasyCaptureCPUData(void* data, unsigned long width, unsigned long height) {
+void uploadRGBEasyCaptureCPUData(const FrameView & frame) {
     if (!RGBEasyCaptureCPURunning.getVal())
         return;
 
-    int dataSize = gRGBEasyCaptureCPU->getWidth() * gRGBEasyCaptureCPU->getHeight() * 3;
+    std::size_t dataSize = frame.getDataSize();
 
     if (!hiddenRGBEasyCaptureCPUWindow) {
         glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
@@ -345,30 +389,28 @@ void uploadRGBEasyCaptureCPUData(void* data, unsigned long width, unsigned long
 
         if (!RGBEasyCaptureTexId)
         {
-            RGBEasyCaptureTexId = allocateCaptureTexture(width, height);
+            RGBEasyCaptureTexId = allocateCaptureTexture(frame.width, frame.height);
         }
 
-        glGenBuffers(1, &RGBEasyCapturePBO);
+        if (persistentUpload)
+        {
+            RGBEasyUploadBuffer.init(dataSize, 3);
+        }
+        else
+        {
+            glGenBuffers(1, &RGBEasyCapturePBO);
 
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, RGBEasyCapturePBO);
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, dataSize, 0, GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, RGBEasyCapturePBO);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, dataSize, 0, GL_DYNAMIC_DRAW);
+        }
     }
     else
         glfwMakeContextCurrent(hiddenRGBEasyCaptureCPUWindow);
 
-    void* GPU_ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-    if (GPU_ptr)
-    {
-        memcpy(GPU_ptr, data, dataSize);
+    double uploadStart = sgct::Engine::getTime();
 
-        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, RGBEasyCaptureTexId);
-
-        //Assuming BGR24
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, 0);
-    }
+    if (uploadFrame(frame, RGBEasyCaptureTexId, RGBEasyUploadBuffer))
+        addUploadTime(sgct::Engine::getTime() - uploadStart);
 
     glfwMakeContextCurrent(NULL); //detach context
 }
@@ -384,7 +426,9 @@ void RGBEasyCaptureCPULoop() {
 
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    glDeleteBuffers(1, &RGBEasyCapturePBO);
+    if (RGBEasyCapturePBO)
+        glDeleteBuffers(1, &RGBEasyCapturePBO);
+    RGBEasyUploadBuffer.cleanup();
 
     glfwMakeContextCurrent(NULL); //detach context
 }
@@ -445,6 +489,7 @@ void RGBEasyCaptureGPUPollAndDraw() {
 			//transform
 			glm::mat4 planeTransform = glm::mat4(1.0f);
 			glUniform1i(flipFrame_Loc, false);
+			glUniform1i(FlipV_Loc, false);
 			glUniformMatrix4fv(Matrix_Loc, 1, GL_FALSE, &planeTransform[0][0]);
 		}
 
@@ -548,6 +593,9 @@ void rgbEasyRenderToTextureSetup() {
 
 void myInitOGLFun()
 {
+	if (yuvSelfTestRequested)
+		runYUVSelfTest();
+
 	if (ffmpegCaptureRequested) {
 		bool captureReady = gFFmpegCapture->init();
 		//allocate texture
@@ -586,7 +634,7 @@ void myInitOGLFun()
         sgct_core::SGCTNode * thisNode = sgct_core::ClusterManager::instance()->getThisNodePtr();
         if (thisNode->getAddress() == gRGBEasyCaptureCPU->getCaptureHost()) {
             if (gRGBEasyCaptureCPU->initialize()) {
-                std::function<void(void* data, unsigned long width, unsigned long height)> callback = uploadRGBEasyCaptureCPUData;
+                std::function<void(const FrameView & frame)> callback = uploadRGBEasyCaptureCPUData;
                 gRGBEasyCaptureCPU->setCaptureCallback(callback);
 
                 startRGBEasyCaptureCPU();
@@ -595,8 +643,8 @@ void myInitOGLFun()
     }
 #endif
 
-    std::function<void(uint8_t ** data, int width, int height)> callback = uploadFFmpegCaptureData;
-    gFFmpegCapture->setVideoDecoderCallback(callback);
+    std::function<void(const FrameView & frame)> callback = uploadFFmpegCaptureData;
+    gFFmpegCapture->setVideoFrameCallback(callback);
 
 	//create RT square
 	RTsquare = new sgct_utils::SGCTPlane(2.0f, 2.0f);
@@ -611,6 +659,7 @@ void myInitOGLFun()
     ScaleUV_Loc = sgct::ShaderManager::instance()->getShaderProgram( "xform").getUniformLocation("scaleUV");
     OffsetUV_Loc = sgct::ShaderManager::instance()->getShaderProgram( "xform").getUniformLocation("offsetUV");
 	flipFrame_Loc = sgct::ShaderManager::instance()->getShaderProgram("xform").getUniformLocation("flipFrame");
+	FlipV_Loc = sgct::ShaderManager::instance()->getShaderProgram("xform").getUniformLocation("flipV");
     GLint Tex_Loc = sgct::ShaderManager::instance()->getShaderProgram( "xform").getUniformLocation( "Tex" );
     glUniform1i( Tex_Loc, 0 );
 
@@ -724,6 +773,15 @@ void parseArguments(int& argc, char**& argv)
 		{
 			flipFrame = true;
 		}
+		else if (strcmp(argv[i], "-uploadmode") == 0 && argc > (i + 1))
+		{
+			persistentUpload = strcmp(argv[i + 1], "map") != 0;
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Upload mode: %s\n", persistentUpload ? "persistent" : "map");
+		}
+		else if (strcmp(argv[i], "-yuvselftest") == 0)
+		{
+			yuvSelfTestRequested = true;
+		}
 #ifdef RGBEASY_ENABLED
 		else if (strcmp(argv[i], "-rgbeasycapturecpu") == 0)
 		{
@@ -780,7 +838,7 @@ GLuint allocateCaptureTexture(int w, int h)
     return texId;
 }
 
-void uploadFFmpegCaptureData(uint8_t ** data, int width, int height)
+void uploadFFmpegCaptureData(const FrameView & frame)
 {
     // At least two textures and GLSync objects
     // should be used to control that the uploaded texture is the same
@@ -788,64 +846,206 @@ void uploadFFmpegCaptureData(uint8_t ** data, int width, int height)
 
 	if (ffmpegCaptureTexId)
 	{
-		unsigned char * GPU_ptr = reinterpret_cast<unsigned char*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
-		if (GPU_ptr)
-		{
-			int dataOffset = 0;
-			int stride = width * 3; //Assuming BGR24
-			if (gFFmpegCapture->isFormatYUYV422()) {
-				stride = width * 2;
-			}
+		double uploadStart = sgct::Engine::getTime();
 
-			for (int row = height - 1; row > -1; row--)
-			{
-				memcpy(GPU_ptr + dataOffset, data[0] + row * stride, stride);
-				dataOffset += stride;
-			}
+		//single copy per plane, rows are flipped in the shader
+		if (uploadFrame(frame, ffmpegCaptureTexId, ffmpegUploadBuffer, &ffmpegYUVPass))
+			addUploadTime(sgct::Engine::getTime() - uploadStart);
 
-			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		//calculateStats();
+	}
+}
 
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, ffmpegCaptureTexId);
+bool uploadFrame(const FrameView & frame, GLuint texId, PersistentUploadBuffer & uploadBuffer, YUVConversionPass * yuvPass)
+{
+	bool convertOnGPU = yuvPass && yuvPass->isInited() && yuvPass->getFormat() == frame.format;
 
-			if (gFFmpegCapture->isFormatYUYV422()) {
-				//AV_PIX_FMT_YUYV422
-				//int y1, u, y2, v;
-				glTexImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, 0);
-			}
-			else { //Assuming BGR24*/
-				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, 0);
-			}
-		}
+	if (persistentUpload)
+	{
+		if (!convertOnGPU)
+			return uploadBuffer.write(texId, frame);
+
+		if (frame.getDataSize() > uploadBuffer.getRangeSize())
+			return false;
+		unsigned char * ptr = uploadBuffer.beginWrite();
+		if (!ptr)
+			return false;
+		frame.copyTo(ptr);
+		uploadBuffer.upload([&](const unsigned char * data) {
+			yuvPass->uploadPlanes(data);
+		});
+		yuvPass->convert(texId);
+		return true;
+	}
 
-		//calculateStats();
+	//map the bound pbo for every frame
+	GLenum format, type;
+	if (!convertOnGPU && !PersistentUploadBuffer::getTextureFormat(frame.format, format, type))
+		return false;
+
+	unsigned char * GPU_ptr = reinterpret_cast<unsigned char*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
+	if (!GPU_ptr)
+		return false;
+
+	frame.copyTo(GPU_ptr);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+	if (convertOnGPU)
+	{
+		yuvPass->uploadPlanes(0);
+		yuvPass->convert(texId);
+		return true;
 	}
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texId);
+
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame.width, frame.height, format, type, 0);
+	return true;
 }
 
 void ffmpegCaptureLoop()
 {
     glfwMakeContextCurrent(hiddenFFmpegCaptureWindow);
 
-    int dataSize = gFFmpegCapture->getWidth() * gFFmpegCapture->getHeight() * 3;
-    GLuint PBO;
-    glGenBuffers(1, &PBO);
+    std::size_t dataSize = getFrameDataSize(gFFmpegCapture->getFramePixelFormat(), gFFmpegCapture->getWidth(), gFFmpegCapture->getHeight());
+    if (YUVConversionPass::isSupported(gFFmpegCapture->getFramePixelFormat(), gFFmpegCapture->getWidth()))
+        ffmpegYUVPass.init(gFFmpegCapture->getWidth(), gFFmpegCapture->getHeight(), gFFmpegCapture->getFramePixelFormat());
+    GLuint PBO = GL_FALSE;
+    if (persistentUpload)
+    {
+        ffmpegUploadBuffer.init(dataSize, 3);
+    }
+    else
+    {
+        glGenBuffers(1, &PBO);
 
-	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
-	glBufferData(GL_PIXEL_UNPACK_BUFFER, dataSize, 0, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, dataSize, 0, GL_DYNAMIC_DRAW);
+    }
 
     while (ffmpegCaptureRunning.getVal())
     {
-		gFFmpegCapture->poll();
-		sgct::Engine::sleep(0.02); //take a short break to offload the cpu
+		gFFmpegCapture->poll(0.1); //blocks until the device delivers a frame, short timeout to check for exit
     }
 
 	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
-    glDeleteBuffers(1, &PBO);
+    if (PBO)
+        glDeleteBuffers(1, &PBO);
+    ffmpegUploadBuffer.cleanup();
+    ffmpegYUVPass.cleanup();
 
     glfwMakeContextCurrent(NULL); //detach context
 }
 
+//Converts random frames of every YUV format with YUVConversionPass and compares
+//the texture with the scalar FrameConverter output, which has to be bit exact.
+bool runYUVSelfTest()
+{
+	const FramePixelFormat formats[] = { FRAME_FORMAT_YUYV422, FRAME_FORMAT_UYVY422, FRAME_FORMAT_NV12, FRAME_FORMAT_YUV420P };
+	const int sizes[][2] = { { 64, 36 }, { 1920, 1080 }, { 37, 19 } };
+	bool allPassed = true;
+	uint32_t random = 12345;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	for (int f = 0; f < 4; f++)
+	{
+		for (int s = 0; s < 3; s++)
+		{
+			int width = sizes[s][0];
+			int height = sizes[s][1];
+			FramePixelFormat format = formats[f];
+			if (!YUVConversionPass::isSupported(format, width))
+				continue;
+
+			FrameView src;
+			src.width = width;
+			src.height = height;
+			src.format = format;
+			std::vector<uint8_t> srcData(src.getDataSize());
+			for (std::size_t i = 0; i < srcData.size(); i++)
+			{
+				random = random * 1664525u + 1013904223u;
+				srcData[i] = static_cast<uint8_t>(random >> 24);
+			}
+			src.setPackedPlanes(srcData.data());
+
+			//the kernels have no i420 path, interleave the chroma into nv12 for the reference
+			FrameView reference = src;
+			std::vector<uint8_t> nv12Data;
+			if (format == FRAME_FORMAT_YUV420P)
+			{
+				reference.format = FRAME_FORMAT_NV12;
+				nv12Data.resize(reference.getDataSize());
+				reference.setPackedPlanes(nv12Data.data());
+				memcpy(reference.planes[0], src.planes[0], static_cast<std::size_t>(width) * height);
+				for (int y = 0; y < getFramePlaneHeight(format, 1, height); y++)
+				{
+					for (int x = 0; x < src.linesizes[1]; x++)
+					{
+						reference.planes[1][y * reference.linesizes[1] + x * 2] = src.planes[1][y * src.linesizes[1] + x];
+						reference.planes[1][y * reference.linesizes[1] + x * 2 + 1] = src.planes[2][y * src.linesizes[2] + x];
+					}
+				}
+			}
+
+			FrameView expected;
+			expected.width = width;
+			expected.height = height;
+			expected.format = FRAME_FORMAT_BGR24;
+			std::vector<uint8_t> expectedData(expected.getDataSize());
+			expected.setPackedPlanes(expectedData.data());
+			FrameConverter::convert(reference, expected, CONVERSION_SCALAR);
+
+			YUVConversionPass pass;
+			GLuint texId = allocateCaptureTexture(width, height);
+			std::vector<uint8_t> result(expectedData.size());
+			bool passed = texId && pass.init(width, height, format);
+			if (passed)
+			{
+				pass.uploadPlanes(srcData.data());
+				pass.convert(texId);
+
+				glBindTexture(GL_TEXTURE_2D, texId);
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				glGetTexImage(GL_TEXTURE_2D, 0, GL_BGR, GL_UNSIGNED_BYTE, result.data());
+				glBindTexture(GL_TEXTURE_2D, 0);
+			}
+
+			std::size_t mismatches = 0;
+			for (std::size_t i = 0; passed && i < result.size(); i++)
+			{
+				if (result[i] != expectedData[i])
+					mismatches++;
+			}
+			passed = passed && mismatches == 0;
+			allPassed = allPassed && passed;
+
+			sgct::MessageHandler::instance()->print(passed ? sgct::MessageHandler::NOTIFY_INFO : sgct::MessageHandler::NOTIFY_ERROR,
+				"YUV self test %s %dx%d: %s (%u differing bytes)\n", getFramePixelFormatName(format), width, height,
+				passed ? "passed" : "FAILED", static_cast<unsigned int>(mismatches));
+
+			pass.cleanup();
+			if (texId)
+				glDeleteTextures(1, &texId);
+		}
+	}
+
+	sgct::Engine::checkForOGLErrors();
+	return allPassed;
+}
+
+void addUploadTime(double uploadTime)
+{
+    //running average over all uploads, written from the capture thread only
+    std::size_t count = ++uploadCount;
+    uploadTimeLast = uploadTime;
+    uploadTimeAverage = uploadTimeAverage + (uploadTime - uploadTimeAverage) / static_cast<double>(count);
+}
+
 void calculateStats()
 {
     double timeStamp = sgct::Engine::getTime();
@@ -7,6 +7,7 @@ layout(location = 2) in vec3 vertPositions;
 
 uniform mat4 MVP;
 uniform bool flipFrame;
+uniform bool flipV; //frame rows stored top-down
 
 out vec2 UV;
 
@@ -21,6 +22,6 @@ void main()
 		gl_Position =  MVP * vec4(vertPositions, 1.0);
 	}
 
-	UV = texCoords;
+	UV = flipV ? vec2(texCoords.x, 1.0 - texCoords.y) : texCoords;
 }
 
@@ -0,0 +1,359 @@
+/*
+*  Copyright 2016-2017 Erik Sundn
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+* 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//Headless benchmark of the capture frame conversion.
+//Checks that all conversion levels give the same bytes as the scalar code,
+//compares their speed with swscale (SWS_FAST_BILINEAR, as used by FFmpegCapture before)
+//and shows how sliced conversion scales with the number of threads.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <FrameConverter.hpp>
+#include <SliceConverter.hpp>
+
+extern "C"
+{
+#ifndef __STDC_CONSTANT_MACROS
+#define __STDC_CONSTANT_MACROS
+#endif
+#include <libswscale/swscale.h>
+#include <libavutil/pixfmt.h>
+}
+
+//a frame with its own, optionally padded, memory
+struct TestFrame
+{
+	std::vector<uint8_t> data;
+	FrameView view;
+};
+
+void allocateFrame(TestFrame & frame, FramePixelFormat format, int width, int height, int padding)
+{
+	frame.view = FrameView();
+	frame.view.format = format;
+	frame.view.width = width;
+	frame.view.height = height;
+
+	std::size_t size = 0;
+	int offsets[4] = { 0, 0, 0, 0 };
+	for (int p = 0; p < getFramePlaneCount(format); p++)
+	{
+		frame.view.linesizes[p] = getFramePlaneRowBytes(format, p, width) + padding;
+		offsets[p] = static_cast<int>(size);
+		size += static_cast<std::size_t>(frame.view.linesizes[p]) * getFramePlaneHeight(format, p, height);
+	}
+
+	frame.data.assign(size + 64, 0);
+	for (int p = 0; p < getFramePlaneCount(format); p++)
+		frame.view.planes[p] = frame.data.data() + offsets[p];
+}
+
+void fillRandom(TestFrame & frame, unsigned int seed)
+{
+	srand(seed);
+	for (std::size_t i = 0; i < frame.data.size(); i++)
+		frame.data[i] = static_cast<uint8_t>(rand() & 255);
+}
+
+//compares the pixel bytes of two frames, ignores padding
+bool isEqual(const FrameView & a, const FrameView & b)
+{
+	int rowBytes = getFramePlaneRowBytes(a.format, 0, a.width);
+	for (int y = 0; y < a.height; y++)
+	{
+		if (memcmp(a.planes[0] + y * a.linesizes[0], b.planes[0] + y * b.linesizes[0], rowBytes) != 0)
+			return false;
+	}
+	return true;
+}
+
+int getMaxDifference(const FrameView & a, const FrameView & b)
+{
+	int rowBytes = getFramePlaneRowBytes(a.format, 0, a.width);
+	int maxDiff = 0;
+	for (int y = 0; y < a.height; y++)
+	{
+		for (int x = 0; x < rowBytes; x++)
+			maxDiff = std::max(maxDiff, abs(static_cast<int>(a.planes[0][y * a.linesizes[0] + x]) - static_cast<int>(b.planes[0][y * b.linesizes[0] + x])));
+	}
+	return maxDiff;
+}
+
+//every level against the scalar code, for odd sizes, padded rows and all yuv values
+bool verify(const std::vector<FramePixelFormat> & srcFormats, const std::vector<FramePixelFormat> & dstFormats)
+{
+	const int widths[] = { 2, 6, 8, 14, 16, 18, 30, 32, 34, 62, 66, 1918, 1920, 7, 17, 33 };
+	const int paddings[] = { 0, 5, 64 };
+	int failures = 0;
+	int checks = 0;
+
+	for (std::size_t s = 0; s < srcFormats.size(); s++)
+	{
+		for (std::size_t d = 0; d < dstFormats.size(); d++)
+		{
+			for (std::size_t w = 0; w < sizeof(widths) / sizeof(int); w++)
+			{
+				for (std::size_t p = 0; p < sizeof(paddings) / sizeof(int); p++)
+				{
+					TestFrame src;
+					allocateFrame(src, srcFormats[s], widths[w], 9, paddings[p]);
+					if (!FrameConverter::isSupported(src.view, dstFormats[d]))
+						continue;
+					fillRandom(src, static_cast<unsigned int>(w * 31 + p));
+
+					TestFrame reference;
+					allocateFrame(reference, dstFormats[d], widths[w], 9, paddings[p] + 3);
+					FrameConverter::convert(src.view, reference.view, CONVERSION_SCALAR);
+
+					for (int level = CONVERSION_SCALAR + 1; level <= FrameConverter::getBestLevel(); level++)
+					{
+						TestFrame dst;
+						allocateFrame(dst, dstFormats[d], widths[w], 9, paddings[p]);
+						checks++;
+						if (!FrameConverter::convert(src.view, dst.view, static_cast<ConversionLevel>(level)) || !isEqual(reference.view, dst.view))
+						{
+							fprintf(stderr, "Mismatch: %s -> %s, %s, width %d, padding %d\n", getFramePixelFormatName(srcFormats[s]), getFramePixelFormatName(dstFormats[d]),
+								FrameConverter::getLevelName(static_cast<ConversionLevel>(level)), widths[w], paddings[p]);
+							failures++;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//all y, u and v combinations, one frame per y with a row per u and a pixel pair per v
+	TestFrame src;
+	allocateFrame(src, FRAME_FORMAT_YUYV422, 512, 256, 0);
+	TestFrame reference;
+	allocateFrame(reference, FRAME_FORMAT_BGRA, 512, 256, 0);
+	TestFrame dst;
+	allocateFrame(dst, FRAME_FORMAT_BGRA, 512, 256, 0);
+	for (int y = 0; y < 256; y++)
+	{
+		for (int u = 0; u < 256; u++)
+		{
+			uint8_t * row = src.view.planes[0] + u * src.view.linesizes[0];
+			for (int v = 0; v < 256; v++)
+			{
+				row[v * 4 + 0] = static_cast<uint8_t>(y);
+				row[v * 4 + 1] = static_cast<uint8_t>(u);
+				row[v * 4 + 2] = static_cast<uint8_t>(255 - y);
+				row[v * 4 + 3] = static_cast<uint8_t>(v);
+			}
+		}
+
+		FrameConverter::convert(src.view, reference.view, CONVERSION_SCALAR);
+		for (int level = CONVERSION_SCALAR + 1; level <= FrameConverter::getBestLevel(); level++)
+		{
+			checks++;
+			if (!FrameConverter::convert(src.view, dst.view, static_cast<ConversionLevel>(level)) || !isEqual(reference.view, dst.view))
+			{
+				fprintf(stderr, "Mismatch: y %d, %s\n", y, FrameConverter::getLevelName(static_cast<ConversionLevel>(level)));
+				failures++;
+			}
+		}
+	}
+
+	fprintf(stdout, "Bit-exactness: %d of %d checks passed\n", checks - failures, checks);
+	return failures == 0;
+}
+
+template<typename Function>
+double measure(int iterations, Function function)
+{
+	function(); //warm up
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+		function();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() / static_cast<double>(iterations);
+}
+
+void benchmark(FramePixelFormat srcFormat, FramePixelFormat dstFormat, int width, int height, int iterations)
+{
+	TestFrame src;
+	allocateFrame(src, srcFormat, width, height, 0);
+	fillRandom(src, 1);
+	TestFrame dst;
+	allocateFrame(dst, dstFormat, width, height, 0);
+	TestFrame swsDst;
+	allocateFrame(swsDst, dstFormat, width, height, 0);
+
+	fprintf(stdout, "\n%s -> %s %dx%d, %d iterations\n", getFramePixelFormatName(srcFormat), getFramePixelFormatName(dstFormat), width, height, iterations);
+
+	SwsContext * swsContext = sws_getContext(width, height, SliceConverter::toAVPixelFormat(srcFormat),
+		width, height, SliceConverter::toAVPixelFormat(dstFormat), SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+	double swsTime = 0.0;
+	if (swsContext)
+	{
+		swsTime = measure(iterations, [&]() {
+			sws_scale(swsContext, src.view.planes, src.view.linesizes, 0, height, swsDst.view.planes, swsDst.view.linesizes);
+		});
+		fprintf(stdout, "  %-8s %8.3f ms\n", "swscale", swsTime);
+	}
+	else
+		fprintf(stdout, "  swscale context could not be created\n");
+
+	if (!FrameConverter::isSupported(src.view, dstFormat))
+	{
+		fprintf(stdout, "  not supported by the conversion kernels\n");
+		sws_freeContext(swsContext);
+		return;
+	}
+
+	for (int level = CONVERSION_SCALAR; level <= FrameConverter::getBestLevel(); level++)
+	{
+		ConversionLevel conversionLevel = static_cast<ConversionLevel>(level);
+		double time = measure(iterations, [&]() {
+			FrameConverter::convert(src.view, dst.view, conversionLevel);
+		});
+
+		fprintf(stdout, "  %-8s %8.3f ms", FrameConverter::getLevelName(conversionLevel), time);
+		if (swsContext)
+			fprintf(stdout, "  %5.2fx swscale, max difference %d", swsTime / time, getMaxDifference(dst.view, swsDst.view));
+		fprintf(stdout, "\n");
+	}
+
+	sws_freeContext(swsContext);
+}
+
+//sliced conversion for 1 to maxThreads threads, with the kernels and with swscale
+void benchmarkScaling(FramePixelFormat srcFormat, FramePixelFormat dstFormat, int width, int height, std::size_t maxThreads, int iterations)
+{
+	TestFrame src;
+	allocateFrame(src, srcFormat, width, height, 0);
+	fillRandom(src, 1);
+	TestFrame dst;
+	allocateFrame(dst, dstFormat, width, height, 0);
+	TestFrame singleDst;
+	allocateFrame(singleDst, dstFormat, width, height, 0);
+
+	fprintf(stdout, "\nSliced %s -> %s %dx%d, %d iterations\n", getFramePixelFormatName(srcFormat), getFramePixelFormatName(dstFormat), width, height, iterations);
+
+	for (int kernels = 1; kernels >= 0; kernels--)
+	{
+		double singleTime = 0.0;
+		for (std::size_t threads = 1; threads <= maxThreads; threads++)
+		{
+			SliceConverter converter;
+			if (!converter.init(width, height, SliceConverter::toAVPixelFormat(srcFormat), SliceConverter::toAVPixelFormat(dstFormat), threads, kernels == 1, FrameConverter::getBestLevel()))
+			{
+				fprintf(stdout, "  %s not available\n", kernels == 1 ? "kernels" : "swscale");
+				break;
+			}
+			if (kernels == 1 && !converter.isUsingKernels())
+				break;
+
+			double time = measure(iterations, [&]() {
+				converter.convert(src.view.planes, src.view.linesizes, dst.view.planes, dst.view.linesizes);
+			});
+			if (threads == 1)
+			{
+				singleTime = time;
+				singleDst.data = dst.data;
+			}
+
+			//slices must not change the result
+			double speedup = singleTime / time;
+			fprintf(stdout, "  %-8s %u threads %8.3f ms  %5.2fx (%3.0f%% efficiency)%s\n", converter.getName(),
+				static_cast<unsigned int>(converter.getThreadCount()), time, speedup, 100.0 * speedup / static_cast<double>(converter.getThreadCount()),
+				isEqual(dst.view, singleDst.view) ? "" : " MISMATCH");
+		}
+	}
+}
+
+bool parseFormat(const char * name, std::vector<FramePixelFormat> & formats)
+{
+	const FramePixelFormat known[] = { FRAME_FORMAT_YUYV422, FRAME_FORMAT_UYVY422, FRAME_FORMAT_NV12, FRAME_FORMAT_BGR24, FRAME_FORMAT_BGRA };
+	for (std::size_t i = 0; i < sizeof(known) / sizeof(FramePixelFormat); i++)
+	{
+		if (strcmp(name, getFramePixelFormatName(known[i])) == 0)
+		{
+			formats.assign(1, known[i]);
+			return true;
+		}
+	}
+	return false;
+}
+
+int main( int argc, char* argv[] )
+{
+	int width = 1920;
+	int height = 1080;
+	int iterations = 100;
+	bool verifyOnly = false;
+	bool scalingOnly = false;
+	std::size_t maxThreads = 4;
+
+	std::vector<FramePixelFormat> srcFormats;
+	srcFormats.push_back(FRAME_FORMAT_YUYV422);
+	srcFormats.push_back(FRAME_FORMAT_UYVY422);
+	srcFormats.push_back(FRAME_FORMAT_NV12);
+	std::vector<FramePixelFormat> dstFormats;
+	dstFormats.push_back(FRAME_FORMAT_BGRA);
+	dstFormats.push_back(FRAME_FORMAT_BGR24);
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-width") == 0 && argc > (i + 1))
+			width = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-height") == 0 && argc > (i + 1))
+			height = atoi(argv[i + 1]);
+		else if (strcmp(argv[i], "-iterations") == 0 && argc > (i + 1))
+			iterations = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-src") == 0 && argc > (i + 1))
+		{
+			if (!parseFormat(argv[i + 1], srcFormats))
+				fprintf(stderr, "Unknown source format %s\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-dst") == 0 && argc > (i + 1))
+		{
+			if (!parseFormat(argv[i + 1], dstFormats))
+				fprintf(stderr, "Unknown destination format %s\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-verify") == 0)
+			verifyOnly = true;
+		else if (strcmp(argv[i], "-scaling") == 0)
+			scalingOnly = true;
+		else if (strcmp(argv[i], "-threads") == 0 && argc > (i + 1))
+			maxThreads = static_cast<std::size_t>(std::max(1, atoi(argv[i + 1])));
+	}
+
+	fprintf(stdout, "Best conversion level: %s\n", FrameConverter::getLevelName(FrameConverter::getBestLevel()));
+
+	bool exact = verify(srcFormats, dstFormats);
+	if (!verifyOnly)
+	{
+		for (std::size_t s = 0; s < srcFormats.size(); s++)
+		{
+			for (std::size_t d = 0; d < dstFormats.size(); d++)
+			{
+				if (!scalingOnly)
+					benchmark(srcFormats[s], dstFormats[d], width, height, iterations);
+
+				//4k and two ganged 1080p inputs
+				benchmarkScaling(srcFormats[s], dstFormats[d], 3840, 2160, maxThreads, iterations);
+				benchmarkScaling(srcFormats[s], dstFormats[d], 3840, 1080, maxThreads, iterations);
+			}
+		}
+	}
+
+	return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -20,8 +20,11 @@
 #include <sstream>
 #include <iterator>
 #include <algorithm> //used for transform string to lowercase
+#include <atomic>
 #include <sgct.h>
 #include <FFmpegCapture.hpp>
+#include <CaptureTextureRing.hpp>
+#include <RenderCommandQueue.hpp>
 
 #ifdef RGBEASY_ENABLED
 #include <RGBEasyCaptureCPU.hpp>
@@ -29,8 +32,11 @@
 #endif
 
 #ifdef ZXING_ENABLED
-#include <BGR24LuminanceSource.h>
+#include <FrameLuminanceSource.h>
 #include <QRCodeInterpreter.h>
+#include <QRRegionScanner.hpp>
+#include <QRDetectionWorker.hpp>
+#include <QRCommandRegistry.hpp>
 #endif
 
 #ifdef OPENVR_SUPPORT
@@ -260,7 +266,10 @@ enum imageType { IM_JPEG, IM_PNG };
 const int headerSize = 1;
 
 //Captures (FFmpegCapture and RGBEasyCaptureGPU)
-void uploadCaptureData(uint8_t ** data, int width, int height);
+void uploadCaptureFrame(const FrameView & capturedFrame);
+bool acquireCaptureDestination(FrameView & destination);
+void captureDestinationWritten(const FrameView & frame, bool success);
+FrameView applyFlipFrame(FrameView frame);
 void parseArguments(int& argc, char**& argv);
 GLuint allocateCaptureTexture();
 void planeCaptureLoop();
@@ -270,6 +279,7 @@ void stopPlaneCapture();
 void updateCapturePlaneTexIDs();
 void allocateCapturePlanes();
 void createPlanes();
+void updateRenderSnapshot();
 
 struct RT
 {
@@ -282,7 +292,7 @@ struct RT
 RT fisheyeCaptureRT;
 
 #ifdef RGBEASY_ENABLED
-void uploadRGBEasyCapturePlaneData(void* data, unsigned long width, unsigned long height);
+void uploadRGBEasyCapturePlaneData(const FrameView & frame);
 void planeDPCaptureLoop();
 void startPlaneDPCapture();
 void stopPlaneDPCapture();
@@ -295,7 +305,8 @@ void RGBEasyRenderToTextureSetup(RGBEasyCaptureGPU* capture, RT& captureRT);
 #endif
 
 #ifdef ZXING_ENABLED
-bool checkQRoperations(uint8_t** data, int width, int height, bool flipped);
+void applyQRoperations();
+void processQRResults();
 #endif
 
 GLint Matrix_Loc = -1;
@@ -304,6 +315,7 @@ GLint ScaleUV_Loc = -1;
 GLint OffsetUV_Loc = -1;
 GLint Opacity_Loc = -1;
 GLint flipFrame_Loc = -1;
+GLint FlipV_Loc = -1;
 GLint Matrix_Loc_BLEND = -1;
 GLint ScaleUV_Loc_BLEND = -1;
 GLint OffsetUV_Loc_BLEND = -1;
@@ -312,12 +324,18 @@ GLint Matrix_Loc_CK = -1;
 GLint ScaleUV_Loc_CK = -1;
 GLint OffsetUV_Loc_CK = -1;
 GLint Opacity_Loc_CK = -1;
+GLint FlipV_Loc_CK = -1;
 GLint ChromaKeyColor_Loc_CK = -1;
 GLint ChromaKeyFactor_Loc_CK = -1;
 
 GLuint planeCaptureTexId = GL_FALSE;
 GLuint planeDPCaptureTexId = GL_FALSE;
-GLuint planeDPCapturePBO = GL_FALSE;
+CaptureTextureRing planeCaptureRing;
+std::size_t planeCaptureRingSize = 3;
+int planeCaptureFreezeSlots = -1; //-1 = one per capture plane, so a freeze never fails
+//auto writes frames straight into upload memory where it can (not while QR codes are scanned) and tiles otherwise
+enum CaptureUploadMode { CAPTURE_UPLOAD_AUTO, CAPTURE_UPLOAD_TILES, CAPTURE_UPLOAD_FRAME };
+CaptureUploadMode planeCaptureUploadMode = CAPTURE_UPLOAD_AUTO;
 int planceCaptureWidth = 0;
 int planeCaptureHeight = 0;
 
@@ -327,6 +345,9 @@ std::thread * fisheyeCaptureThread;
 bool flipFrame = false;
 bool fulldomeMode = false;
 bool planeDPCaptureRequested = false;
+//the RGBEasy capture thread asks the render thread for the upload ring with its first frame
+enum CaptureRingState { CAPTURE_RING_NONE, CAPTURE_RING_REQUESTED, CAPTURE_RING_READY, CAPTURE_RING_FAILED };
+std::atomic<int> planeDPCaptureRingState(CAPTURE_RING_NONE);
 bool fisheyeCaptureRequested = false;
 ContentPlaneLocalAttribs fullDomeAttribs = ContentPlaneLocalAttribs("fullDome");
 glm::vec2 planeScaling(1.0f, 1.0f);
@@ -350,10 +371,34 @@ sgct::SharedBool chromaKey(false);
 sgct::SharedObject<glm::vec3> chromaKeyColor(glm::vec3(0.f, 177.f, 64.f));
 sgct::SharedFloat chromaKeyFactor(22.f);
 
-std::vector<GLuint> planeTexOwnedIds;
+//ring textures retained by the frozen capture planes, 0 while live
+std::vector<GLuint> planeTexFrozenIds;
+std::vector<FrameOrientation> planeTexFrozenOrientations;
+//capture threads post what needs the render context or the draw state, run in myPostSyncPreDrawFun
+RenderCommandQueue renderCommands;
+
+//what the viewports draw of a plane this frame
+struct PlaneRenderState {
+	glm::mat4 transform; //azimuth, elevation, roll and distance, the MVP of the viewport is applied when drawn
+	float opacity;
+	GLuint texture;
+	bool flipV;
+};
+
+//built once in myPostSyncPreDrawFun, all viewports and cube faces of the frame only read it
+struct RenderSnapshot {
+	std::vector<PlaneRenderState> planes; //in the order of planeAttributesGlobal, capture planes first
+	float fulldomeOpacity;
+	bool captureFlipV;
+};
+RenderSnapshot renderSnapshot;
 
 #ifdef ZXING_ENABLED
+//render thread only, the detection worker posts its results there
 std::vector<std::string> operationsQueue;
+QRCommandRegistry qrCommands;
+QRDetectionWorker qrDetectionWorker;
+std::vector<QRDetectionWorker::Result> qrResults;
 #endif
 
 //ImGUI variables
@@ -394,6 +439,16 @@ int main( int argc, char* argv[] )
     // -video <device name>
     // -option <key> <val>
     // -flip
+    // -capturebuffers <number of capture upload textures, at least 3>
+    // -capturefreezebuffers <number of extra capture textures for frozen planes>
+    // -captureupload <auto|tiles|frame>
+    // -qrregions <corners|top|bottom|left|right|x,y,width,height> (repeatable)
+    // -qrtracking
+    // -qrsweep <frames between full frame QR scans>
+    // -qrmodulesize <pixels per QR module in the frame>
+    // -qrdecoder <global|hybrid|global-tryhard|hybrid-tryhard|adaptive>
+    // -qrrecall <lowest recall of the adaptive QR decoder, 0-1>
+    // -qrrescan <frames between decodes of unchanged QR scan regions, 0 = every frame>
     // -plane <azimuth> <elevation> <roll>
     //
     // to obtain video device names in windows use:
@@ -407,6 +462,9 @@ int main( int argc, char* argv[] )
     // For options look at: http://ffmpeg.org/ffmpeg-devices.html
 
     parseArguments(argc, argv);
+
+    // slides mostly change in small regions, tiles are used for the frames that go through system memory
+    planeCaptureRing.setTileUpload(planeCaptureUploadMode != CAPTURE_UPLOAD_FRAME);
     
     gEngine->setInitOGLFunction( myInitOGLFun );
 	gEngine->setPreSyncFunction(myPreSyncFun);
@@ -535,9 +593,27 @@ void myPostSyncPreDrawFun()
 		screenshotPassOn = true;
 	}
 
+	//before the planes are recreated, a new capture size recreates them this frame
+	renderCommands.drain();
+
 	if (planeReCreate.getVal())
 		createPlanes();
 
+#ifdef ZXING_ENABLED
+	//QR operations and which held back frames may be shown
+	if (planeCaptureRing.isInited())
+		processQRResults();
+#endif
+
+	//bind the latest complete capture frame for all viewports this frame
+	if (planeCaptureRing.isInited()) {
+		GLuint latestTexId = planeCaptureRing.acquireLatest();
+		if (latestTexId)
+			planeCaptureTexId = latestTexId;
+	}
+
+	updateRenderSnapshot();
+
 #ifdef RGBEASY_ENABLED
 	// Run a poll from the capturing
 	// If we are not doing that in the background
@@ -554,31 +630,12 @@ void myPostSyncPreDrawFun()
 #endif
 }
 
-float getContentPlaneOpacity(int planeIdx) {
-    //If planeIdx=-1 we assume the attribs fulldome view is asked for
-	std::vector<ContentPlaneLocalAttribs> pA = planeAttributesLocal.getVal();
-    ContentPlaneLocalAttribs pl = ContentPlaneLocalAttribs("dummy");
-
-    if (planeIdx>=0){
-        pl = pA[planeIdx];
-    }
-    else {
-        pl = fullDomeAttribs;
-    }
-
+float updateContentPlaneOpacity(ContentPlaneLocalAttribs & pl) {
 	float planeOpacity = 1.f;
 
 	if (pl.currentlyVisible != pl.previouslyVisible && pl.fadeStartTime == -1.0) {
 		pl.fadeStartTime = curr_time.getVal();
 		pl.previouslyVisible = pl.currentlyVisible;
-		
-        if (planeIdx >= 0) {
-		    pA[planeIdx] = pl;
-		    planeAttributesLocal.setVal(pA);
-        }
-        else {
-            fullDomeAttribs = pl;
-        }
 	}
 
 	if (pl.fadeStartTime != -1.0) {
@@ -601,13 +658,6 @@ float getContentPlaneOpacity(int planeIdx) {
 
 		if (abort) {
 			pl.fadeStartTime = -1.0;
-			if (planeIdx >= 0) {
-		        pA[planeIdx] = pl;
-		        planeAttributesLocal.setVal(pA);
-            }
-            else {
-                fullDomeAttribs = pl;
-            }
 		}
 	}
 	else if (!pl.currentlyVisible) {
@@ -617,6 +667,47 @@ float getContentPlaneOpacity(int planeIdx) {
 	return planeOpacity;
 }
 
+void updateRenderSnapshot() {
+	//one copy of the shared plane state per frame, fades advance here instead of in every viewport
+	std::vector<ContentPlaneGlobalAttribs> pAG = planeAttributesGlobal.getVal();
+	std::vector<ContentPlaneLocalAttribs> pAL = planeAttributesLocal.getVal();
+
+	fullDomeAttribs.currentlyVisible = fulldomeMode;
+	renderSnapshot.fulldomeOpacity = updateContentPlaneOpacity(fullDomeAttribs);
+
+	//capture frames are uploaded in capture row order
+	renderSnapshot.captureFlipV = needsVerticalFlip(planeCaptureRing.getAcquiredOrientation());
+
+	std::size_t planeCount = std::min(pAG.size(), pAL.size());
+	renderSnapshot.planes.resize(planeCount);
+	for (std::size_t i = 0; i < planeCount; i++) {
+		PlaneRenderState & plane = renderSnapshot.planes[i];
+		plane.opacity = updateContentPlaneOpacity(pAL[i]);
+
+		//freeze is synced, frozen textures only exist on the capturing node, the others keep the live capture
+		if (i < captureContentPlanes.size() && pAL[i].freeze && planeTexFrozenIds[i] != 0) {
+			plane.texture = planeTexFrozenIds[i];
+			plane.flipV = needsVerticalFlip(planeTexFrozenOrientations[i]);
+		}
+		else if (pAG[i].planeStrId > 0) {
+			plane.texture = texIds.getValAt(pAG[i].planeTexId);
+			plane.flipV = false;
+		}
+		else {
+			plane.texture = planeCaptureTexId;
+			plane.flipV = renderSnapshot.captureFlipV;
+		}
+
+		plane.transform = glm::mat4(1.0f);
+		plane.transform = glm::rotate(plane.transform, glm::radians(pAG[i].azimuth), glm::vec3(0.0f, -1.0f, 0.0f)); //azimuth
+		plane.transform = glm::rotate(plane.transform, glm::radians(pAG[i].elevation), glm::vec3(1.0f, 0.0f, 0.0f)); //elevation
+		plane.transform = glm::rotate(plane.transform, glm::radians(pAG[i].roll), glm::vec3(0.0f, 0.0f, 1.0f)); //roll
+		plane.transform = glm::translate(plane.transform, glm::vec3(0.0f, 0.0f, pAG[i].distance)); //distance
+	}
+
+	planeAttributesLocal.setVal(pAL);
+}
+
 void myDraw3DFun()
 {
     glEnable(GL_DEPTH_TEST);
@@ -649,8 +740,7 @@ void myDraw3DFun()
     //Set up backface culling
     glCullFace(GL_BACK);
 
-    fullDomeAttribs.currentlyVisible = fulldomeMode;
-    float fulldomeOpacity = getContentPlaneOpacity(-1);
+    float fulldomeOpacity = renderSnapshot.fulldomeOpacity;
 
     if (domeTexIndex.getVal() != -1
         && fulldomeOpacity <= 0.f)  // && texIds.getSize() > domeTexIndex.getVal())
@@ -685,6 +775,7 @@ void myDraw3DFun()
 			glUniform2f(ScaleUV_Loc, 1.f, 1.f);
 			glUniform2f(OffsetUV_Loc, 0.f, 0.f);
             glUniform1i(flipFrame_Loc, 0);
+            glUniform1i(FlipV_Loc, 0);
 			glUniform1f(Opacity_Loc, 1.f);
 			glUniformMatrix4fv(Matrix_Loc, 1, GL_FALSE, &MVP[0][0]);
 		}
@@ -700,6 +791,7 @@ void myDraw3DFun()
     GLint OffsetUV_L = OffsetUV_Loc;
     GLint Matrix_L = Matrix_Loc;
 	GLint Opacity_L = Opacity_Loc;
+    GLint FlipV_L = FlipV_Loc;
     if (chromaKey.getVal())
     {
         sgct::ShaderManager::instance()->bindShaderProgram("chromakey");
@@ -712,6 +804,7 @@ void myDraw3DFun()
         OffsetUV_L = OffsetUV_Loc_CK;
         Matrix_L = Matrix_Loc_CK;
 		Opacity_L = Opacity_Loc_CK;
+        FlipV_L = FlipV_Loc_CK;
     }
     else
     {
@@ -721,6 +814,8 @@ void myDraw3DFun()
 
     glFrontFace(GL_CCW);
 
+    bool captureFlipV = renderSnapshot.captureFlipV;
+
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
@@ -737,29 +832,16 @@ void myDraw3DFun()
 		glUniform2f(ScaleUV_L, planeScaling.x, planeScaling.y);
 		glUniform2f(OffsetUV_L, planeOffset.x, planeOffset.y);
 
-		for (int i = 0; i < captureContentPlanes.size(); i++) {
+		for (int i = 0; i < captureContentPlanes.size() && i < renderSnapshot.planes.size(); i++) {
+			const PlaneRenderState & plane = renderSnapshot.planes[i];
 			glActiveTexture(GL_TEXTURE0);
-			if (planeAttributesLocal.getVal()[i].freeze) {
-				glBindTexture(GL_TEXTURE_2D, planeTexOwnedIds[i]);
-			}
-			else if (planeAttributesGlobal.getVal()[i].planeStrId > 0) {
-				glBindTexture(GL_TEXTURE_2D, texIds.getValAt(planeAttributesGlobal.getVal()[i].planeTexId));
-			}
-			else {
-                glBindTexture(GL_TEXTURE_2D, planeCaptureTexId);
-			}
-
-			float planeOpacity = getContentPlaneOpacity(i);
-			if (planeOpacity > 0.f) {
-				glUniform1f(Opacity_L, planeOpacity);
+			glBindTexture(GL_TEXTURE_2D, plane.texture);
+			glUniform1i(FlipV_L, plane.flipV);
 
-				glm::mat4 capturePlaneTransform = glm::mat4(1.0f);
-				capturePlaneTransform = glm::rotate(capturePlaneTransform, glm::radians(planeAttributesGlobal.getVal()[i].azimuth), glm::vec3(0.0f, -1.0f, 0.0f)); //azimuth
-				capturePlaneTransform = glm::rotate(capturePlaneTransform, glm::radians(planeAttributesGlobal.getVal()[i].elevation), glm::vec3(1.0f, 0.0f, 0.0f)); //elevation
-				capturePlaneTransform = glm::rotate(capturePlaneTransform, glm::radians(planeAttributesGlobal.getVal()[i].roll), glm::vec3(0.0f, 0.0f, 1.0f)); //roll
-				capturePlaneTransform = glm::translate(capturePlaneTransform, glm::vec3(0.0f, 0.0f, planeAttributesGlobal.getVal()[i].distance)); //distance
+			if (plane.opacity > 0.f) {
+				glUniform1f(Opacity_L, plane.opacity);
 
-				capturePlaneTransform = MVP * capturePlaneTransform;
+				glm::mat4 capturePlaneTransform = MVP * plane.transform;
 				glUniformMatrix4fv(Matrix_L, 1, GL_FALSE, &capturePlaneTransform[0][0]);
 
 				captureContentPlanes[i]->draw();
@@ -767,31 +849,20 @@ void myDraw3DFun()
 		}
 	}
 
-	float planeOpacity;
-	for (int i = static_cast<int>(captureContentPlanes.size()); i < planeAttributesGlobal.getSize(); i++) {
-		planeOpacity = getContentPlaneOpacity(i);
-		if (planeOpacity > 0.f && masterContentPlanes.size() > i-captureContentPlanes.size()) {
+	for (int i = static_cast<int>(captureContentPlanes.size()); i < renderSnapshot.planes.size(); i++) {
+		const PlaneRenderState & plane = renderSnapshot.planes[i];
+		if (plane.opacity > 0.f && masterContentPlanes.size() > i-captureContentPlanes.size()) {
 			glActiveTexture(GL_TEXTURE0);
-			if (planeAttributesGlobal.getVal()[i].planeStrId > 0) {
-				glBindTexture(GL_TEXTURE_2D, texIds.getValAt(planeAttributesGlobal.getVal()[i].planeTexId));
-			}
-			else {
-				glBindTexture(GL_TEXTURE_2D, planeCaptureTexId);
-			}
+			glBindTexture(GL_TEXTURE_2D, plane.texture);
+			glUniform1i(FlipV_L, plane.flipV);
 
-			glUniform1f(Opacity_L, planeOpacity);
+			glUniform1f(Opacity_L, plane.opacity);
 
 			glUniform2f(ScaleUV_L, 1.0f, 1.0f);
 			glUniform2f(OffsetUV_L, 0.0f, 0.0f);
 
 			//transform and draw plane
-			glm::mat4 contentPlaneTransform = glm::mat4(1.0f);
-			contentPlaneTransform = glm::rotate(contentPlaneTransform, glm::radians(planeAttributesGlobal.getVal()[i].azimuth), glm::vec3(0.0f, -1.0f, 0.0f)); //azimuth
-			contentPlaneTransform = glm::rotate(contentPlaneTransform, glm::radians(planeAttributesGlobal.getVal()[i].elevation), glm::vec3(1.0f, 0.0f, 0.0f)); //elevation
-			contentPlaneTransform = glm::rotate(contentPlaneTransform, glm::radians(planeAttributesGlobal.getVal()[i].roll), glm::vec3(0.0f, 0.0f, 1.0f)); //roll
-			contentPlaneTransform = glm::translate(contentPlaneTransform, glm::vec3(0.0f, 0.0f, planeAttributesGlobal.getVal()[i].distance)); //distance
-
-			contentPlaneTransform = MVP * contentPlaneTransform;
+			glm::mat4 contentPlaneTransform = MVP * plane.transform;
 			glUniformMatrix4fv(Matrix_L, 1, GL_FALSE, &contentPlaneTransform[0][0]);
 
 			masterContentPlanes[i- captureContentPlanes.size()]->draw();
@@ -801,6 +872,7 @@ void myDraw3DFun()
     if (fulldomeOpacity > 0.f) {
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, planeCaptureTexId);
+        glUniform1i(FlipV_L, captureFlipV);
         glm::vec2 texSize = glm::vec2(static_cast<float>(planceCaptureWidth),
                                         static_cast<float>(planeCaptureHeight));
 
@@ -835,19 +907,67 @@ void myDraw2DFun()
 {
     if (info.getVal())
     {
+        char qrInfo[512] = "";
+#ifdef ZXING_ENABLED
+        const QRRegionScanner & qrScanner = qrDetectionWorker.getScanner();
+        if (planeCaptureRing.isHoldingBack())
+        {
+            int length = snprintf(qrInfo, sizeof(qrInfo), "\nQR scan: %u of %u frames (%.1lf ms), full %u (%.1lf ms), regions %u (%.1lf ms), unchanged %u",
+                static_cast<unsigned int>(qrDetectionWorker.getNumberOfScannedFrames()),
+                static_cast<unsigned int>(qrDetectionWorker.getNumberOfPostedFrames()),
+                qrDetectionWorker.getAverageScanTime() * 1000.0,
+                static_cast<unsigned int>(qrScanner.getNumberOfFullScans()),
+                qrScanner.getAverageFullScanTime() * 1000.0,
+                static_cast<unsigned int>(qrScanner.getNumberOfRegionScans()),
+                qrScanner.getAverageRegionScanTime() * 1000.0,
+                static_cast<unsigned int>(qrScanner.getNumberOfSkippedScans()));
+
+            //hit rate of the pyramid levels, the scans start at the coarsest and fall back to full resolution
+            int coarsest = qrScanner.getCoarsestLevel();
+            for (int level = coarsest; coarsest > 0 && level >= 0 && length > 0 && length < static_cast<int>(sizeof(qrInfo)); level--)
+                length += snprintf(qrInfo + length, sizeof(qrInfo) - length, "%s %dx: %u of %u (%.1lf ms)", level == coarsest ? "\nQR pyramid" : ",",
+                    1 << level,
+                    static_cast<unsigned int>(qrScanner.getNumberOfLevelHits(level)),
+                    static_cast<unsigned int>(qrScanner.getNumberOfLevelScans(level)),
+                    qrScanner.getAverageLevelScanTime(level) * 1000.0);
+
+            //the configuration in use and what the adaptive decoder learnt about it
+            const QRDecoderSelector & qrDecoder = qrScanner.getDecoder();
+            int config = qrDecoder.getSelectedConfig();
+            QRDecoderSelector::ConfigStats decoderStats = qrDecoder.getStats(config);
+            if (length > 0 && length < static_cast<int>(sizeof(qrInfo)))
+                snprintf(qrInfo + length, sizeof(qrInfo) - length, "\nQR decoder: %s%s, recall %.2lf, %.1lf ms/Mpixel, %u explorations",
+                    qrDecoder.isAdaptive() ? "adaptive " : "", QRDecoderSelector::getConfigName(config),
+                    decoderStats.recall, decoderStats.timePerMegapixel * 1000.0,
+                    static_cast<unsigned int>(qrDecoder.getNumberOfExplorations()));
+        }
+#endif
+
         unsigned int font_size = static_cast<unsigned int>(9.0f*gEngine->getCurrentWindowPtr()->getXScale());
         sgct_text::Font * font = sgct_text::FontManager::instance()->getFont("SGCTFont", font_size);
         float padding = 10.0f;
 
-        /*sgct_text::print(font, sgct_text::TOP_LEFT,
+        sgct_text::print(font, sgct_text::TOP_LEFT,
             padding, static_cast<float>(gEngine->getCurrentWindowPtr()->getYFramebufferResolution() - font_size) - padding, //x and y pos
             glm::vec4(1.0, 1.0, 1.0, 1.0), //color
-            "Format: %s\nResolution: %d x %d\nRate: %.2lf Hz",
+            "Format: %s\nResolution: %d x %d\nRate: %.2lf Hz\nUnchanged: %u frames skipped\nUpload ring: %u slots (%u/%u frozen), %u frames (%s)\nUpload: %.1lf KB/frame (avg %.1lf KB), tiles %u/%u\nFence waits: %u (%.2lf ms)%s",
             gPlaneCapture->getFormat(),
             planceCaptureWidth,
             planeCaptureHeight,
-            captureRate.getVal());
-			*/
+            captureRate.getVal(),
+            static_cast<unsigned int>(gPlaneCapture->getNumberOfUnchangedFrames()),
+            static_cast<unsigned int>(planeCaptureRing.getSlotCount()),
+            static_cast<unsigned int>(planeCaptureRing.getNumberOfRetainedSlots()),
+            static_cast<unsigned int>(planeCaptureRing.getRetainSlotCount()),
+            static_cast<unsigned int>(planeCaptureRing.getNumberOfUploadedFrames()),
+            planeCaptureRing.isPersistentlyMapped() ? "persistent" : "mapped",
+            static_cast<double>(planeCaptureRing.getLastUploadBytes()) / 1024.0,
+            planeCaptureRing.getAverageUploadBytes() / 1024.0,
+            static_cast<unsigned int>(planeCaptureRing.getLastDirtyTiles()),
+            static_cast<unsigned int>(planeCaptureRing.getTileCount()),
+            static_cast<unsigned int>(planeCaptureRing.getNumberOfFenceWaits()),
+            planeCaptureRing.getFenceWaitTime() * 1000.0,
+            qrInfo);
     }
 
 	bool drawGUI = true;
@@ -1016,6 +1136,9 @@ void myDraw2DFun()
 
 void myPostDrawFun()
 {
+	//capture thread may reuse the slot once the GPU is done with it
+	planeCaptureRing.releaseRead();
+
 #ifdef OPENVR_SUPPORT
 	if (FirstOpenVRWindow) {
 		//Copy the first OpenVR window to the HMD
@@ -1046,12 +1169,10 @@ void stopPlaneCapture()
 }
 
 #ifdef RGBEASY_ENABLED
-void uploadRGBEasyCapturePlaneData(void* data, unsigned long width, unsigned long height) {
+void uploadRGBEasyCapturePlaneData(const FrameView & frame) {
     if (!planeDPCaptureRunning.getVal())
         return;
 
-    int dataSize = gPlaneDPCapture->getWidth() * gPlaneDPCapture->getHeight() * 3;
-
     if (!hiddenPlaneDPCaptureWindow) {
         glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
 
@@ -1060,71 +1181,83 @@ void uploadRGBEasyCapturePlaneData(void* data, unsigned long width, unsigned lon
         {
             sgct::MessageHandler::instance()->print("Failed to create capture context!\n");
         }
+    }
 
-        glfwMakeContextCurrent(hiddenPlaneDPCaptureWindow);
+    //the size is only known with the first frame, the render thread allocates the ring and the planes for it
+    //while the frames before are dropped
+    static int requestedWidth = 0;
+    static int requestedHeight = 0;
+    static FramePixelFormat requestedFormat = FRAME_FORMAT_UNKNOWN;
+    int ringState = planeDPCaptureRingState.load();
+    bool signalChanged = frame.width != requestedWidth || frame.height != requestedHeight || frame.format != requestedFormat;
+    if (ringState == CAPTURE_RING_READY && signalChanged)
+    {
+        //the ring only takes frames of its own size and format, it is rebuilt for the new signal
+        sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Capture signal changed to %dx%d %s, rebuilding the capture ring\n",
+            frame.width, frame.height, getFramePixelFormatName(frame.format));
+        ringState = CAPTURE_RING_NONE;
+    }
+    else if (ringState == CAPTURE_RING_FAILED && signalChanged)
+        ringState = CAPTURE_RING_NONE; //the signal changed, try again with the new frames
+
+    if (ringState == CAPTURE_RING_NONE)
+    {
+        int width = frame.width;
+        int height = frame.height;
+        FramePixelFormat format = frame.format;
+        planeDPCaptureRingState = CAPTURE_RING_REQUESTED;
+        bool posted = renderCommands.post([width, height, format]() {
+            //frozen planes hold textures of the ring that is rebuilt, they start live with the new one
+            updateCapturePlaneTexIDs();
 
-        if (!planeCaptureTexId)
-        {
             planceCaptureWidth = width;
             planeCaptureHeight = height;
-            planeCaptureTexId = allocateCaptureTexture();
-
-            //update capture textures
-            updateCapturePlaneTexIDs();
+            if (!planeCaptureRing.init(width, height, format, planeCaptureRingSize, allocateCaptureTexture)) {
+                planeDPCaptureRingState = CAPTURE_RING_FAILED;
+                return;
+            }
 
             planeReCreate.setVal(true);
-        }
 
-        glGenBuffers(1, &planeDPCapturePBO);
-
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, planeDPCapturePBO);
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, dataSize, 0, GL_DYNAMIC_DRAW);
+            //the capture context only sees the new textures and buffers once they are flushed here
+            glFlush();
+            planeDPCaptureRingState = CAPTURE_RING_READY;
+        });
+        if (posted)
+        {
+            requestedWidth = width;
+            requestedHeight = height;
+            requestedFormat = format;
+        }
+        else
+            planeDPCaptureRingState = CAPTURE_RING_NONE; //the queue is full, the next frame asks again
+        return;
     }
-    else
-        glfwMakeContextCurrent(hiddenPlaneDPCaptureWindow);
 
-    if (planeCaptureTexId)
+    if (ringState == CAPTURE_RING_FAILED)
     {
-#ifdef ZXING_ENABLED
-        uint8_t* dataUC = (uint8_t*)data;
-        if (checkQRoperations(&dataUC, width, height, !flipFrame)) {
-#endif
-
-        void* GPU_ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
-        if (GPU_ptr)
+        //logged once per failed request
+        static int loggedWidth = 0;
+        static int loggedHeight = 0;
+        static FramePixelFormat loggedFormat = FRAME_FORMAT_UNKNOWN;
+        if (loggedWidth != requestedWidth || loggedHeight != requestedHeight || loggedFormat != requestedFormat)
         {
+            sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "No capture ring for %dx%d %s frames, RGBEasy frames are dropped!\n",
+                requestedWidth, requestedHeight, getFramePixelFormatName(requestedFormat));
+            loggedWidth = requestedWidth;
+            loggedHeight = requestedHeight;
+            loggedFormat = requestedFormat;
+        }
+        return;
+    }
 
-            if (flipFrame)
-            {
-                int dataOffset = 0;
-                int stride = width * 3; //Assuming BGR24
-                unsigned char* GPU_ptrUC = static_cast<unsigned char*>(GPU_ptr);
-                unsigned char* dataUC = static_cast<unsigned char*>(data);
-                for (int row = height - 1; row > -1; row--)
-                {
-                    memcpy(GPU_ptrUC + dataOffset, dataUC + row * stride, stride);
-                    dataOffset += stride;
-                }
-            }
-            else
-            {
-            
-                memcpy(GPU_ptr, data, dataSize);
-            }
-
-            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
-
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, planeCaptureTexId);
+    if (ringState != CAPTURE_RING_READY)
+        return;
 
-            //Assuming BGR24
-            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, 0);
-        }
+    glfwMakeContextCurrent(hiddenPlaneDPCaptureWindow);
 
-#ifdef ZXING_ENABLED
-        }
-#endif
-    }
+    //same path as the ffmpeg frames, the DIB rows are kept in capture order
+    uploadCaptureFrame(frame);
 
     glfwMakeContextCurrent(NULL); //detach context
 }
@@ -1156,14 +1289,6 @@ void planeDPCaptureLoop() {
 		// Frame capture running...
         sgct::Engine::sleep(0.02);
     }
-
-    glfwMakeContextCurrent(hiddenPlaneDPCaptureWindow);
-
-    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-
-    glDeleteBuffers(1, &planeDPCapturePBO);
-
-    glfwMakeContextCurrent(NULL); //detach context
 }
 
 void startFisheyeCapture()
@@ -1211,6 +1336,7 @@ void RGBEasyCaptureGPUPollAndDraw(RGBEasyCaptureGPU* capture, RT& captureRT) {
 			glm::mat4 planeTransform = glm::mat4(1.0f);
 			glUniformMatrix4fv(Matrix_Loc, 1, GL_FALSE, &planeTransform[0][0]);
             glUniform1i(flipFrame_Loc, flipFrame);
+            glUniform1i(FlipV_Loc, 0);
 		}
 
 		sgct_core::OffScreenBuffer * fbo = gEngine->getCurrentFBO();
@@ -1305,134 +1431,225 @@ void RGBEasyRenderToTextureSetup(RGBEasyCaptureGPU* capture, RT& captureRT) {
 #endif
 
 #ifdef ZXING_ENABLED
-bool checkQRoperations(uint8_t** data, int width, int height, bool flipped)
+void freezeCapturePlane(int p, std::vector<ContentPlaneLocalAttribs> & pAL)
 {
-    // If result is not empty, we have to interpret the message to decide it the plane should lock the capture to the previous frame or update it.
-    std::vector<std::string> decodedResults;
-    if (planeCapturePresMode.getVal())
-        decodedResults = QRCodeInterpreter::decodeImageMulti(BGR24LuminanceSource::create(data, width, height, flipped));
-
-    if (!decodedResults.empty()) {
-        //Save only unique operations
-        for each(std::string decodedResult in decodedResults) {
-            if (std::find(operationsQueue.begin(), operationsQueue.end(), decodedResult) == operationsQueue.end()) {
-                //Operation not in queue, add it
-                sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Decode %i characters, with resulting string: %s\n", decodedResult.size(), decodedResult.c_str());
-                operationsQueue.push_back(decodedResult.c_str());
+    if (pAL[p].freeze)
+        return;
+
+    // Frozen planes keep the last clean frame, which is still the latest one in the ring
+    GLuint frozenTexId = planeCaptureRing.retainLatest(planeTexFrozenOrientations[p]);
+    if (!frozenTexId) {
+        sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Could not freeze %s (no frame yet or all freeze textures in use), it stays live\n", pAL[p].name.c_str());
+        return;
+    }
+    pAL[p].freeze = true;
+    planeTexFrozenIds[p] = frozenTexId;
+}
+
+void unfreezeCapturePlane(int p, std::vector<ContentPlaneLocalAttribs> & pAL)
+{
+    pAL[p].freeze = false;
+    planeCaptureRing.release(planeTexFrozenIds[p]);
+    planeTexFrozenIds[p] = 0;
+}
+
+void applyQRoperations()
+{
+    std::vector<ContentPlaneLocalAttribs> pAL = planeAttributesLocal.getVal();
+    std::vector<ContentPlaneGlobalAttribs> pAG = planeAttributesGlobal.getVal();
+    bool globalChanged = false;
+
+    // The compiled payloads are kept until a plane is added, removed or renamed
+    bool planesChanged = qrCommands.getPlaneCount() != pAL.size();
+    for (size_t p = 0; !planesChanged && p < pAL.size(); p++)
+        planesChanged = qrCommands.getPlaneName(p) != pAL[p].name;
+    if (planesChanged) {
+        std::vector<std::string> planeNames;
+        for (size_t p = 0; p < pAL.size(); p++)
+            planeNames.push_back(pAL[p].name);
+        qrCommands.setPlanes(planeNames);
+    }
+
+    for (size_t i = 0; i < operationsQueue.size(); i++) {
+        sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Applying Operation: %s\n", operationsQueue[i].c_str());
+        const QRCommandRegistry::Command & command = qrCommands.compile(operationsQueue[i]);
+        if (!command.hasTarget()) {
+            sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Could not find plane named: %s\n", command.errors.empty() ? "" : command.errors[0].c_str());
+            continue;
+        }
+        for (size_t e = 0; e < command.errors.size(); e++)
+            sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Unknown QR operation: %s\n", command.errors[e].c_str());
+
+        int plane = command.plane;
+        for (size_t o = 0; o < command.operations.size(); o++) {
+            const QRCommandRegistry::Operation & operation = command.operations[o];
+            switch (operation.opcode) {
+            case QRCommandRegistry::OP_SET_ACTIVE:
+                if (plane >= captureContentPlanes.size()) {
+                    sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "SetActive needs a capture plane: %s\n", pAL[plane].name.c_str());
+                    break;
+                }
+                // Setting plane as active capture plane
+                pAL[plane].previouslyVisible = false;
+                unfreezeCapturePlane(plane, pAL);
+
+                //Freezing other planes which are not already frozen
+                for (int p = 0; p < captureContentPlanes.size(); p++) {
+                    if (p != plane)
+                        freezeCapturePlane(p, pAL);
+                }
+
+                pAL[plane].currentlyVisible = true;
+                break;
+            case QRCommandRegistry::OP_CLEAR:
+                //Making all planes fade out, need to freeze all planes
+                for (int p = 0; p < captureContentPlanes.size(); p++) {
+                    freezeCapturePlane(p, pAL);
+                    pAL[p].currentlyVisible = false;
+                }
+                break;
+            case QRCommandRegistry::OP_SHOW:
+            case QRCommandRegistry::OP_HIDE:
+                pAL[plane].currentlyVisible = operation.opcode == QRCommandRegistry::OP_SHOW;
+                if (gEngine->isMaster() && plane == imPlaneIdx)
+                    imPlaneShow = pAL[plane].currentlyVisible;
+                break;
+            default:
+                // Placement, source and fading time are synced from the master, the gui values follow them there
+                if (!gEngine->isMaster()) {
+                    sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "%s is only applied on the master\n", QRCommandRegistry::getOpcodeName(operation.opcode));
+                    break;
+                }
+                if (operation.opcode == QRCommandRegistry::OP_MOVE) {
+                    pAG[plane].azimuth = operation.values[0];
+                    pAG[plane].elevation = operation.values[1];
+                    if (operation.valueCount > 2)
+                        pAG[plane].roll = operation.values[2];
+                }
+                else if (operation.opcode == QRCommandRegistry::OP_RESIZE) {
+                    pAG[plane].height = operation.values[0];
+                    planeReCreate.setVal(true);
+                }
+                else if (operation.opcode == QRCommandRegistry::OP_SET_IMAGE) {
+                    std::vector<std::string>::iterator image = std::find(planeImageFileNames.begin(), planeImageFileNames.end(), operation.text);
+                    if (image == planeImageFileNames.end()) {
+                        sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Could not find image named: %s\n", operation.text.c_str());
+                        break;
+                    }
+                    pAG[plane].planeStrId = static_cast<int>(image - planeImageFileNames.begin());
+                    pAG[plane].planeTexId = imagePathsMap[operation.text];
+                    planeReCreate.setVal(true);
+                }
+                else if (operation.opcode == QRCommandRegistry::OP_FADE_TIME) {
+                    imFadingTime = operation.values[0];
+                    break;
+                }
+
+                globalChanged = true;
+                if (plane == imPlaneIdx) {
+                    imPlaneHeight = pAG[plane].height;
+                    imPlaneAzimuth = pAG[plane].azimuth;
+                    imPlaneElevation = pAG[plane].elevation;
+                    imPlaneRoll = pAG[plane].roll;
+                    imPlaneImageIdx = pAG[plane].planeStrId;
+                }
+                break;
             }
         }
-        return false;
     }
-    else {
-        std::vector<ContentPlaneLocalAttribs> pAL = planeAttributesLocal.getVal();
-        std::vector<ContentPlaneGlobalAttribs> pAG = planeAttributesGlobal.getVal();
-        if (!operationsQueue.empty()) {
-            // Now we can process them when decodedResults is empty
-            for (size_t i = 0; i < operationsQueue.size(); i++) {
-                sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Applying Operation: %s\n", operationsQueue[i].c_str());
-                std::vector<std::string> operation = split(operationsQueue[i].c_str(), ';');
-                if (operation.size() > 1) {
-                    int capturePlaneIdx = -1;
-                    for (int p = 0; p < captureContentPlanes.size(); p++) {
-                        if (pAL[p].name == operation[0]) {
-                            capturePlaneIdx = p;
-                            break;
-                        }
-                    }
-                    if (capturePlaneIdx >= 0) {
-                        for (int o = 1; o < operation.size(); o++) {
-                            if (operation[o] == "SetActive") {
-                                // Setting capturePlaneIdx as active capture plane
-                                pAL[capturePlaneIdx].previouslyVisible = false;
-                                pAL[capturePlaneIdx].freeze = false;
-                                pAG[capturePlaneIdx].planeTexId = 0;
-
-                                //Freezing other planes which are not already frozen
-                                for (int p = 0; p < captureContentPlanes.size(); p++) {
-                                    if (p != capturePlaneIdx && !pAL[p].freeze) {
-                                        pAL[p].freeze = true;
-                                        glCopyImageSubData(planeCaptureTexId, GL_TEXTURE_2D, 0, 0, 0, 0, planeTexOwnedIds[p], GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
-                                        glFlush();
-                                    }
-                                }
-
-                                // Setting capturePlaneIdx as active capture plane
-                                pAL[capturePlaneIdx].currentlyVisible = true;
-                            }
-                        }
-                    }
-                    else if (operation[0] == "AllCaptures") {
-                        if (operation[1] == "Clear") {
-                            //Making all planes fade out
-                            for (int p = 0; p < captureContentPlanes.size(); p++) {
-                                //Need to freeze all planes
-                                if (!pAL[p].freeze) {
-                                    pAL[p].freeze = true;
-                                    glCopyImageSubData(planeCaptureTexId, GL_TEXTURE_2D, 0, 0, 0, 0, planeTexOwnedIds[p], GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
-                                    glFlush();
-                                }
-                                pAL[p].currentlyVisible = false;
-                            }
-                        }
-                    }
-                    else {
-                        sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Could not find plane named: %s\n", operation[0].c_str());
-                    }
+
+    planeAttributesLocal.setVal(pAL);
+    if (globalChanged)
+        planeAttributesGlobal.setVal(pAG);
+    operationsQueue.clear();
+}
+
+void processQRResults()
+{
+    // In presentation mode frames are uploaded as they come but only shown once the worker found them clean,
+    // so a slide with a QR code is never displayed and the capture never waits for the detector
+    bool holdBack = planeCapturePresMode.getVal() && qrDetectionWorker.isRunning() && LumaConverter::isSupported(planeCaptureRing.getFormat());
+    planeCaptureRing.setHoldBack(holdBack);
+
+    qrDetectionWorker.takeResults(qrResults);
+    if (!holdBack)
+        return;
+
+    for (size_t r = 0; r < qrResults.size(); r++) {
+        const QRDetectionWorker::Result & result = qrResults[r];
+        if (!result.texts.empty()) {
+            //Save only unique operations
+            for each(std::string decodedResult in result.texts) {
+                if (std::find(operationsQueue.begin(), operationsQueue.end(), decodedResult) == operationsQueue.end()) {
+                    //Operation not in queue, add it
+                    sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Decode %i characters, with resulting string: %s (frame %u)\n", decodedResult.size(), decodedResult.c_str(), static_cast<unsigned int>(result.sequence));
+                    operationsQueue.push_back(decodedResult.c_str());
                 }
             }
-            planeAttributesLocal.setVal(pAL);
-            operationsQueue.clear();
+            planeCaptureRing.dropPending(result.sequence);
+        }
+        else {
+            // Now we can process them as the codes are gone
+            if (!operationsQueue.empty())
+                applyQRoperations();
+            planeCaptureRing.publish(result.sequence);
         }
-        return true;
     }
 }
 #endif
 
 void updateCapturePlaneTexIDs() {
-    size_t planesTexCount = planeTexOwnedIds.size();
-    planeTexOwnedIds.clear();
-
-    for (size_t i = 0; i < planesTexCount; i++)
-        planeTexOwnedIds.push_back(allocateCaptureTexture());
+    //before the ring is rebuilt, the frozen planes give back their textures and start live
+    std::vector<ContentPlaneLocalAttribs> pAL = planeAttributesLocal.getVal();
+    for (size_t p = 0; p < planeTexFrozenIds.size() && p < pAL.size(); p++)
+        pAL[p].freeze = false;
+    planeAttributesLocal.setVal(pAL);
+
+    for (size_t p = 0; p < planeTexFrozenIds.size(); p++)
+        planeCaptureRing.release(planeTexFrozenIds[p]);
+    planeTexFrozenIds.assign(planeTexFrozenIds.size(), 0);
+    planeTexFrozenOrientations.assign(planeTexFrozenIds.size(), FRAME_BOTTOM_UP);
 }
 
 void allocateCapturePlanes() {
     //define capture planes
     imPlanes.push_back("FrontCapture");
     ContentPlane frontCapture = ContentPlane("FrontCapture", imPlaneHeight, imPlaneAzimuth, imPlaneElevation, imPlaneRoll, imPlaneDistance, true);
-    planeTexOwnedIds.push_back(allocateCaptureTexture());
+    planeTexFrozenIds.push_back(0);
     planeAttributesGlobal.addVal(frontCapture.getGlobal());
     planeAttributesLocal.addVal(frontCapture.getLocal());
     captureContentPlanes.push_back(nullptr);
 
     imPlanes.push_back("BackCapture");
     ContentPlane backCapture = ContentPlane("BackCapture", 1.8f, -155.f, 20.f, imPlaneRoll, imPlaneDistance, false);
-    planeTexOwnedIds.push_back(allocateCaptureTexture());
+    planeTexFrozenIds.push_back(0);
     planeAttributesGlobal.addVal(backCapture.getGlobal());
     planeAttributesLocal.addVal(backCapture.getLocal());
     captureContentPlanes.push_back(nullptr);
 
     imPlanes.push_back("LeftCapture");
     ContentPlane leftCapture = ContentPlane("LeftCapture", 2.865f, -75.135f, 26.486f, imPlaneRoll, imPlaneDistance, false);
-    planeTexOwnedIds.push_back(allocateCaptureTexture());
+    planeTexFrozenIds.push_back(0);
     planeAttributesGlobal.addVal(leftCapture.getGlobal());
     planeAttributesLocal.addVal(leftCapture.getLocal());
     captureContentPlanes.push_back(nullptr);
 
     imPlanes.push_back("RightCapture");
     ContentPlane rightCapture = ContentPlane("RightCapture", 2.865f, 75.135f, 26.486f, imPlaneRoll, imPlaneDistance, false);
-    planeTexOwnedIds.push_back(allocateCaptureTexture());
+    planeTexFrozenIds.push_back(0);
     planeAttributesGlobal.addVal(rightCapture.getGlobal());
     planeAttributesLocal.addVal(rightCapture.getLocal());
     captureContentPlanes.push_back(nullptr);
 
     imPlanes.push_back("TopCapture");
     ContentPlane topCapture = ContentPlane("TopCapture", imPlaneHeight, 0.f, 75.135f, imPlaneRoll, imPlaneDistance, false);
-    planeTexOwnedIds.push_back(allocateCaptureTexture());
+    planeTexFrozenIds.push_back(0);
     planeAttributesGlobal.addVal(topCapture.getGlobal());
     planeAttributesLocal.addVal(topCapture.getLocal());
     captureContentPlanes.push_back(nullptr);
 
+    planeTexFrozenOrientations.assign(planeTexFrozenIds.size(), FRAME_BOTTOM_UP);
+
     //define default content plane
     //imPlanes.push_back("Content 1");
     //planeAttributes.addVal(ContentPlane(1.6f, 0.f, 95.0f, 0.f));
@@ -1630,15 +1847,24 @@ void myInitOGLFun()
     fullDomeAttribs.currentlyVisible = false;
     fullDomeAttribs.previouslyVisible = false;
 
+    //define capture planes, before the capture ring which keeps their frozen frames
+    allocateCapturePlanes();
+    planeCaptureRing.setRetainSlots(planeCaptureFreezeSlots >= 0 ? static_cast<std::size_t>(planeCaptureFreezeSlots) : captureContentPlanes.size());
+
+#ifdef ZXING_ENABLED
+	//QR codes are decoded next to the capture, in presentation mode only
+	qrDetectionWorker.start();
+#endif
+
 	// do directshow if we don't use the better RGBEasy solution
 	if (!planeDPCaptureRequested) {
 		bool captureReady = gPlaneCapture->init();
 		planceCaptureWidth = gPlaneCapture->getWidth();
 		planeCaptureHeight = gPlaneCapture->getHeight();
 
-		//allocate texture
+		//allocate upload ring
 		if (captureReady) {
-			planeCaptureTexId = allocateCaptureTexture();
+			planeCaptureRing.init(planceCaptureWidth, planeCaptureHeight, gPlaneCapture->getFramePixelFormat(), planeCaptureRingSize, allocateCaptureTexture);
 		}
 		planeImageFileNames.push_back("Single Capture");
 
@@ -1647,8 +1873,9 @@ void myInitOGLFun()
 			startPlaneCapture();
 		}
 
-		std::function<void(uint8_t ** data, int width, int height)> callback = uploadCaptureData;
-		gPlaneCapture->setVideoDecoderCallback(callback);
+		std::function<void(const FrameView & frame)> callback = uploadCaptureFrame;
+		gPlaneCapture->setVideoFrameCallback(callback);
+		gPlaneCapture->setVideoDestinationCallbacks(acquireCaptureDestination, captureDestinationWritten);
 	}
 
 #ifdef RGBEASY_ENABLED
@@ -1657,7 +1884,7 @@ void myInitOGLFun()
 		sgct_core::SGCTNode * thisNode = sgct_core::ClusterManager::instance()->getThisNodePtr();
 		if (thisNode->getAddress() == gPlaneDPCapture->getCaptureHost()) {
 			if (gPlaneDPCapture->initialize()) {
-                std::function<void(void* data, unsigned long width, unsigned long height)> callback = uploadRGBEasyCapturePlaneData;
+                std::function<void(const FrameView & frame)> callback = uploadRGBEasyCapturePlaneData;
                 gPlaneDPCapture->setCaptureCallback(callback);
 				startPlaneDPCapture();
 
@@ -1703,9 +1930,6 @@ void myInitOGLFun()
     if (gEngine->isMaster())
         loadThread = new (std::nothrow) std::thread(threadWorker);
 
-    //define capture planes
-    allocateCapturePlanes();
-
     //create plane
 	createPlanes();
 
@@ -1725,6 +1949,7 @@ void myInitOGLFun()
     ScaleUV_Loc = sgct::ShaderManager::instance()->getShaderProgram( "flipxform").getUniformLocation("scaleUV");
     OffsetUV_Loc = sgct::ShaderManager::instance()->getShaderProgram( "flipxform").getUniformLocation("offsetUV");
     flipFrame_Loc = sgct::ShaderManager::instance()->getShaderProgram("flipxform").getUniformLocation("flipFrame");
+    FlipV_Loc = sgct::ShaderManager::instance()->getShaderProgram("flipxform").getUniformLocation("flipV");
 	Opacity_Loc = sgct::ShaderManager::instance()->getShaderProgram("flipxform").getUniformLocation("opacity");
     GLint Tex_Loc = sgct::ShaderManager::instance()->getShaderProgram( "flipxform").getUniformLocation( "Tex" );
     glUniform1i( Tex_Loc, 0 );
@@ -1758,6 +1983,7 @@ void myInitOGLFun()
     ScaleUV_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("scaleUV");
     OffsetUV_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("offsetUV");
 	Opacity_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("opacity");
+    FlipV_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("flipV");
     ChromaKeyColor_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("chromaKeyColor");
 	ChromaKeyFactor_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("chromaKeyFactor");
     GLint Tex_Loc_CK = sgct::ShaderManager::instance()->getShaderProgram("chromakey").getUniformLocation("Tex");
@@ -1920,11 +2146,13 @@ void myCleanUpFun()
 	}
 	masterContentPlanes.clear();
 
-    if (planeCaptureTexId)
-    {
-        glDeleteTextures(1, &planeCaptureTexId);
-		planeCaptureTexId = GL_FALSE;
-    }
+#ifdef ZXING_ENABLED
+    qrDetectionWorker.stop();
+#endif
+
+    //capture textures are owned by the ring
+    planeCaptureRing.cleanup();
+    planeCaptureTexId = GL_FALSE;
     
     for(std::size_t i=0; i < texIds.getSize(); i++)
     {
@@ -2388,6 +2616,80 @@ void parseArguments(int& argc, char**& argv)
 		{
 			flipFrame = true;
 		}
+		else if (strcmp(argv[i], "-capturebuffers") == 0 && argc > (i + 1))
+		{
+			planeCaptureRingSize = static_cast<std::size_t>(atoi(argv[i + 1]));
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Capture upload ring size %u\n", static_cast<unsigned int>(planeCaptureRingSize));
+		}
+		else if (strcmp(argv[i], "-capturefreezebuffers") == 0 && argc > (i + 1))
+		{
+			planeCaptureFreezeSlots = std::max(0, atoi(argv[i + 1]));
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Capture freeze textures %d\n", planeCaptureFreezeSlots);
+		}
+		else if (strcmp(argv[i], "-captureupload") == 0 && argc > (i + 1))
+		{
+			if (strcmp(argv[i + 1], "tiles") == 0)
+				planeCaptureUploadMode = CAPTURE_UPLOAD_TILES;
+			else if (strcmp(argv[i + 1], "frame") == 0)
+				planeCaptureUploadMode = CAPTURE_UPLOAD_FRAME;
+			else
+				planeCaptureUploadMode = CAPTURE_UPLOAD_AUTO;
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Capture upload: %s\n",
+				planeCaptureUploadMode == CAPTURE_UPLOAD_TILES ? "tiles" : (planeCaptureUploadMode == CAPTURE_UPLOAD_FRAME ? "frame" : "auto"));
+		}
+#ifdef ZXING_ENABLED
+		else if (strcmp(argv[i], "-qrregions") == 0 && argc > (i + 1))
+		{
+			if (qrDetectionWorker.getScanner().addRegions(std::string(argv[i + 1])))
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "QR scan regions: %s\n", argv[i + 1]);
+			else
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Invalid QR scan region %s!\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-qrtracking") == 0)
+		{
+			qrDetectionWorker.getScanner().setTracking(true);
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "QR scans track the last found codes\n");
+		}
+		else if (strcmp(argv[i], "-qrsweep") == 0 && argc > (i + 1))
+		{
+			qrDetectionWorker.getScanner().setFullSweepInterval(static_cast<std::size_t>(atoi(argv[i + 1])));
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Full frame QR scan every %s frames\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-qrmodulesize") == 0 && argc > (i + 1))
+		{
+			qrDetectionWorker.getScanner().setModuleSize(static_cast<float>(atof(argv[i + 1])));
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "QR module size %s pixels, scans start %dx smaller\n", argv[i + 1],
+				1 << qrDetectionWorker.getScanner().getCoarsestLevel());
+		}
+		else if (strcmp(argv[i], "-qrdecoder") == 0 && argc > (i + 1))
+		{
+			QRDecoderSelector & qrDecoder = qrDetectionWorker.getScanner().getDecoder();
+			int config = QRDecoderSelector::findConfig(std::string(argv[i + 1]));
+			if (strcmp(argv[i + 1], "adaptive") == 0)
+			{
+				qrDecoder.setAdaptive(true);
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "QR decoder: adaptive\n");
+			}
+			else if (config >= 0)
+			{
+				qrDecoder.setAdaptive(false);
+				qrDecoder.setConfig(config);
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "QR decoder: %s\n", argv[i + 1]);
+			}
+			else
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Unknown QR decoder %s!\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-qrrecall") == 0 && argc > (i + 1))
+		{
+			qrDetectionWorker.getScanner().getDecoder().setRecallThreshold(atof(argv[i + 1]));
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Adaptive QR decoder recall above %s\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-qrrescan") == 0 && argc > (i + 1))
+		{
+			qrDetectionWorker.getScanner().setRescanInterval(static_cast<std::size_t>(std::max(0, atoi(argv[i + 1]))));
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Unchanged QR scan regions decoded every %s frames\n", argv[i + 1]);
+		}
+#endif
 #ifdef RGBEASY_ENABLED
 		else if (strcmp(argv[i], "-planecapture") == 0)
 		{
@@ -2475,163 +2777,78 @@ GLuint allocateCaptureTexture()
 	return texId;
 }
 
-void uploadCaptureData(uint8_t ** data, int width, int height)
+void uploadCaptureFrame(const FrameView & capturedFrame)
 {
-    // At least two textures and GLSync objects
-    // should be used to control that the uploaded texture is the same
-    // for all viewports to prevent any tearing and maintain frame sync
+    // Frames are written to a ring of textures guarded by GLSync objects,
+    // the render thread binds the latest complete one for all viewports
+    // to prevent any tearing and maintain frame sync
 
-    if (planeCaptureTexId)
+    if (planeCaptureRing.isInited())
     {
+        // the frame references the capture memory, nothing is copied before the upload
+        FrameView frame = applyFlipFrame(capturedFrame);
+
+        //one copy per plane, the orientation travels with the frame
+        bool written = planeCaptureRing.write(frame);
 #ifdef ZXING_ENABLED
-        if(checkQRoperations(data, width, height, flipFrame)) {
-		/*// If result is not empty, we have to interpret the message to decide it the plane should lock the capture to the previous frame or update it.
-		std::vector<std::string> decodedResults;
-		if(planeCapturePresMode.getVal())
-			decodedResults = QRCodeInterpreter::decodeImageMulti(BGR24LuminanceSource::create(data, width, height, flipFrame));
-		
-		if (!decodedResults.empty()) {
-			//Save only unique operations
-			for each(std::string decodedResult in decodedResults) {
-				if (std::find(operationsQueue.begin(), operationsQueue.end(), decodedResult) == operationsQueue.end()) {
-					//Operation not in queue, add it
-					sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Decode %i characters, with resulting string: %s\n", decodedResult.size(), decodedResult.c_str());
-					operationsQueue.push_back(decodedResult.c_str());
-				}
-			}
-		}
-		else {
-			std::vector<ContentPlaneLocalAttribs> pAL = planeAttributesLocal.getVal();
-			std::vector<ContentPlaneGlobalAttribs> pAG = planeAttributesGlobal.getVal();
-			if (!operationsQueue.empty()) {
-				// Now we can process them when decodedResults is empty
-				for (size_t i = 0; i < operationsQueue.size(); i++) {
-					sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Applying Operation: %s\n", operationsQueue[i].c_str());
-					std::vector<std::string> operation = split(operationsQueue[i].c_str(), ';');
-					if (operation.size() > 1) {
-						int capturePlaneIdx = -1;
-						for (int p = 0; p < captureContentPlanes.size(); p++) {
-							if (pAL[p].name == operation[0]) {
-								capturePlaneIdx = p;
-								break;
-							}
-						}
-						if (capturePlaneIdx >= 0) {
-							for (int o = 1; o < operation.size(); o++) {
-								if (operation[o] == "SetActive") {
-									// Setting capturePlaneIdx as active capture plane
-									pAL[capturePlaneIdx].previouslyVisible = false;
-									pAL[capturePlaneIdx].freeze = false;
-									pAG[capturePlaneIdx].planeTexId = 0;
-
-									//Freezing other planes which are not already frozen
-									for (int p = 0; p < captureContentPlanes.size(); p++) {
-										if (p != capturePlaneIdx && !pAL[p].freeze) {
-											pAL[p].freeze = true;
-											glCopyImageSubData(planeCaptureTexId, GL_TEXTURE_2D, 0, 0, 0, 0, planeTexOwnedIds[p], GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
-											glFlush();
-										}
-									}
-									
-									// Setting capturePlaneIdx as active capture plane
-									pAL[capturePlaneIdx].currentlyVisible = true;
-								}
-							}
-						}
-						else if (operation[0] == "AllCaptures") {
-							if (operation[1] == "Clear") {
-								//Making all planes fade out
-								for (int p = 0; p < captureContentPlanes.size(); p++) {
-									//Need to freeze all planes
-									if (!pAL[p].freeze) {
-										pAL[p].freeze = true;
-										glCopyImageSubData(planeCaptureTexId, GL_TEXTURE_2D, 0, 0, 0, 0, planeTexOwnedIds[p], GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
-										glFlush();
-									}
-									pAL[p].currentlyVisible = false;
-								}
-							}
-						}
-						else {
-							sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Could not find plane named: %s\n", operation[0].c_str());
-						}
-					}
-				}
-			}*/
+        // the worker scans the frame while it waits in the ring, a newer frame replaces it if the worker is busy
+        bool replaced;
+        uint64_t replacedSequence;
+        if (written && planeCaptureRing.isHoldingBack() && qrDetectionWorker.post(frame, replaced, replacedSequence) && replaced)
+            planeCaptureRing.discardPending(replacedSequence);
 #endif
-			unsigned char * GPU_ptr = reinterpret_cast<unsigned char*>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
-			if (GPU_ptr)
-			{
-				int dataOffset = 0;
-				int stride = width * 3; //Assuming BGR24
-				if (gPlaneCapture->isFormatYUYV422()) {
-					stride = width * 2;
-				}
-
-				if (flipFrame)
-				{
-					for (int row = 0; row < height; row++)
-					{
-						memcpy(GPU_ptr + dataOffset, data[0] + row * stride, stride);
-						dataOffset += stride;
-					}
-				}
-				else
-				{
-					for (int row = height - 1; row > -1; row--)
-					{
-						memcpy(GPU_ptr + dataOffset, data[0] + row * stride, stride);
-						dataOffset += stride;
-					}
-				}
-
-				glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
 
-				glActiveTexture(GL_TEXTURE0);
-				glBindTexture(GL_TEXTURE_2D, planeCaptureTexId);
+        //calculateStats();
+    }
+}
 
-				if (gPlaneCapture->isFormatYUYV422()) {
-					//AV_PIX_FMT_YUYV422
-					//int y1, u, y2, v;
-					glTexImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_INT_8_8_8_8, 0);
-				}
-				else { //Assuming BGR24
-					glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, 0);
-				}
-			}
+bool acquireCaptureDestination(FrameView & destination)
+{
 #ifdef ZXING_ENABLED
-			/*if (!operationsQueue.empty()) {
-				planeAttributesLocal.setVal(pAL);
-				operationsQueue.clear();
-			}*/
-		}
+    // QR scanning needs the frame in system memory, use the regular upload path
+    if (planeCapturePresMode.getVal())
+        return false;
 #endif
 
-        //calculateStats();
+    if (!planeCaptureRing.isInited())
+        return false;
+
+    // changed tiles are found in system memory, mapped upload memory is slow to read
+    if (planeCaptureUploadMode == CAPTURE_UPLOAD_TILES && planeCaptureRing.isTileUploadActive())
+        return false;
+
+    // the decoder/converter writes the rows as they come, the shaders flip in UV space
+    return planeCaptureRing.beginWrite(destination);
+}
+
+void captureDestinationWritten(const FrameView & frame, bool success)
+{
+    if (!success)
+    {
+        planeCaptureRing.cancelWrite();
+        return;
     }
+
+    planeCaptureRing.endWrite(applyFlipFrame(frame));
+}
+
+FrameView applyFlipFrame(FrameView frame)
+{
+    // -flip shows the frame upside down
+    if (flipFrame)
+        frame.orientation = flipOrientation(frame.orientation);
+    return frame;
 }
 
 void planeCaptureLoop()
 {
     glfwMakeContextCurrent(hiddenPlaneCaptureWindow);
 
-    int dataSize = planceCaptureWidth * planeCaptureHeight * 3;
-    GLuint PBO;
-    glGenBuffers(1, &PBO);
-
-	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
-	glBufferData(GL_PIXEL_UNPACK_BUFFER, dataSize, 0, GL_DYNAMIC_DRAW);
-
     while (planeCaptureRunning.getVal())
     {
-		gPlaneCapture->poll();
-		sgct::Engine::sleep(0.02); //take a short break to offload the cpu
+		gPlaneCapture->poll(0.1); //blocks until the device delivers a frame, short timeout to check for exit
     }
 
-	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-
-    glDeleteBuffers(1, &PBO);
-
     glfwMakeContextCurrent(NULL); //detach context
 }
 
@@ -6,6 +6,7 @@ layout(location = 1) in vec3 normals;
 layout(location = 2) in vec3 vertPositions;
 
 uniform mat4 MVP;
+uniform bool flipV; //frame rows stored top-down
 
 out vec2 UV;
 
@@ -13,6 +14,6 @@ void main()
 {
     // Output position of the vertex, in clip space : MVP * position
 	gl_Position =  MVP * vec4(vertPositions, 1.0);
-	UV = texCoords;
+	UV = flipV ? vec2(texCoords.x, 1.0 - texCoords.y) : texCoords;
 }
 
@@ -0,0 +1,298 @@
+/*
+*  Copyright 2016-2017 Erik Sundn
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+* 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//Headless benchmark of the luminance kernels of the QR detection.
+//Checks that all levels give the same bytes as the scalar code (the zxing weights)
+//and compares their speed with the scalar per pixel conversion.
+//The 2x and 4x box filters of the detection pyramid are checked and timed the same way.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <LumaConverter.hpp>
+
+//a frame with its own, optionally padded, memory
+struct TestFrame
+{
+	std::vector<uint8_t> data;
+	FrameView view;
+};
+
+void allocateFrame(TestFrame & frame, FramePixelFormat format, int width, int height, int padding)
+{
+	frame.view = FrameView();
+	frame.view.format = format;
+	frame.view.width = width;
+	frame.view.height = height;
+
+	std::size_t size = 0;
+	int offsets[4] = { 0, 0, 0, 0 };
+	for (int p = 0; p < getFramePlaneCount(format); p++)
+	{
+		frame.view.linesizes[p] = getFramePlaneRowBytes(format, p, width) + padding;
+		offsets[p] = static_cast<int>(size);
+		size += static_cast<std::size_t>(frame.view.linesizes[p]) * getFramePlaneHeight(format, p, height);
+	}
+
+	frame.data.assign(size + 64, 0);
+	for (int p = 0; p < getFramePlaneCount(format); p++)
+		frame.view.planes[p] = frame.data.data() + offsets[p];
+}
+
+void fillRandom(TestFrame & frame, unsigned int seed)
+{
+	srand(seed);
+	for (std::size_t i = 0; i < frame.data.size(); i++)
+		frame.data[i] = static_cast<uint8_t>(rand() & 255);
+}
+
+//every level against the scalar code, for odd sizes, padded rows and both orientations
+bool verify(const std::vector<FramePixelFormat> & formats)
+{
+	const int widths[] = { 1, 2, 7, 15, 16, 17, 18, 31, 32, 33, 34, 35, 63, 64, 66, 1918, 1920 };
+	const int paddings[] = { 0, 5, 64 };
+	int failures = 0;
+	int checks = 0;
+
+	for (std::size_t f = 0; f < formats.size(); f++)
+	{
+		for (std::size_t w = 0; w < sizeof(widths) / sizeof(int); w++)
+		{
+			for (std::size_t p = 0; p < sizeof(paddings) / sizeof(int); p++)
+			{
+				TestFrame src;
+				allocateFrame(src, formats[f], widths[w], 9, paddings[p]);
+				fillRandom(src, static_cast<unsigned int>(w * 31 + p));
+				src.view.orientation = p == 1 ? FRAME_BOTTOM_UP : FRAME_TOP_DOWN;
+
+				std::vector<uint8_t> reference(static_cast<std::size_t>(widths[w]) * 9);
+				LumaConverter::convert(src.view, reference.data(), CONVERSION_SCALAR);
+
+				for (int level = CONVERSION_SCALAR + 1; level <= FrameConverter::getBestLevel(); level++)
+				{
+					std::vector<uint8_t> dst(reference.size() + 1, 0xA5);
+					checks++;
+					if (!LumaConverter::convert(src.view, dst.data(), static_cast<ConversionLevel>(level)) ||
+						memcmp(reference.data(), dst.data(), reference.size()) != 0 || dst.back() != 0xA5)
+					{
+						fprintf(stderr, "Mismatch: %s, %s, width %d, padding %d\n", getFramePixelFormatName(formats[f]),
+							FrameConverter::getLevelName(static_cast<ConversionLevel>(level)), widths[w], paddings[p]);
+						failures++;
+					}
+				}
+			}
+		}
+	}
+
+	//the scalar code against the weights for every gray and every pure channel value
+	TestFrame bgr;
+	allocateFrame(bgr, FRAME_FORMAT_BGR24, 256, 4, 0);
+	for (int v = 0; v < 256; v++)
+	{
+		uint8_t pixels[4][3] = { { (uint8_t)v, (uint8_t)v, (uint8_t)v }, { (uint8_t)v, 0, 0 }, { 0, (uint8_t)v, 0 }, { 0, 0, (uint8_t)v } };
+		for (int row = 0; row < 4; row++)
+			memcpy(bgr.view.planes[0] + row * bgr.view.linesizes[0] + v * 3, pixels[row], 3);
+	}
+	std::vector<uint8_t> luma(256 * 4);
+	for (int level = CONVERSION_SCALAR; level <= FrameConverter::getBestLevel(); level++)
+	{
+		LumaConverter::convert(bgr.view, luma.data(), static_cast<ConversionLevel>(level));
+		for (int v = 0; v < 256; v++)
+		{
+			int expected[4] = { (1024 * v + 0x200) >> 10, (117 * v + 0x200) >> 10, (601 * v + 0x200) >> 10, (306 * v + 0x200) >> 10 };
+			for (int row = 0; row < 4; row++)
+			{
+				checks++;
+				if (luma[row * 256 + v] != expected[row])
+				{
+					fprintf(stderr, "Mismatch: weights, %s, value %d\n", FrameConverter::getLevelName(static_cast<ConversionLevel>(level)), v);
+					failures++;
+				}
+			}
+		}
+	}
+
+	//box filters against the rounded average, the last output is written by the scalar tail
+	for (int factor = 2; factor <= 4; factor += 2)
+	{
+		for (std::size_t w = 0; w < sizeof(widths) / sizeof(int); w++)
+		{
+			std::vector<uint8_t> rows(static_cast<std::size_t>(widths[w]) * factor * factor);
+			srand(static_cast<unsigned int>(w));
+			for (std::size_t i = 0; i < rows.size(); i++)
+				rows[i] = static_cast<uint8_t>(rand() & 255);
+			const uint8_t * rowPointers[4];
+			for (int r = 0; r < factor; r++)
+				rowPointers[r] = rows.data() + static_cast<std::size_t>(r) * widths[w] * factor;
+
+			for (int level = CONVERSION_SCALAR; level <= FrameConverter::getBestLevel(); level++)
+			{
+				std::vector<uint8_t> dst(widths[w] + 1, 0xA5);
+				LumaConverter::getDownsampleFunction(factor, static_cast<ConversionLevel>(level))(rowPointers, dst.data(), widths[w]);
+				checks++;
+				bool exactRow = dst.back() == 0xA5;
+				for (int x = 0; x < widths[w] && exactRow; x++)
+				{
+					int sum = 0;
+					for (int r = 0; r < factor; r++)
+					{
+						for (int c = 0; c < factor; c++)
+							sum += rowPointers[r][x * factor + c];
+					}
+					exactRow = dst[x] == (sum + factor * factor / 2) / (factor * factor);
+				}
+				if (!exactRow)
+				{
+					fprintf(stderr, "Mismatch: %dx box filter, %s, width %d\n", factor, FrameConverter::getLevelName(static_cast<ConversionLevel>(level)), widths[w]);
+					failures++;
+				}
+			}
+		}
+	}
+
+	fprintf(stdout, "Bit-exactness: %d of %d checks passed\n", checks - failures, checks);
+	return failures == 0;
+}
+
+template<typename Function>
+double measure(int iterations, Function function)
+{
+	function(); //warm up
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+		function();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() / static_cast<double>(iterations);
+}
+
+void benchmarkDownsample(int factor, int width, int height, int iterations)
+{
+	std::vector<uint8_t> luma(static_cast<std::size_t>(width) * height);
+	for (std::size_t i = 0; i < luma.size(); i++)
+		luma[i] = static_cast<uint8_t>(i * 7);
+	std::vector<uint8_t> level(static_cast<std::size_t>(width / factor) * (height / factor));
+
+	fprintf(stdout, "\nluminance %dx%d -> %dx box filter, %d iterations\n", width, height, factor, iterations);
+
+	double scalarTime = 0.0;
+	for (int l = CONVERSION_SCALAR; l <= FrameConverter::getBestLevel(); l++)
+	{
+		ConversionLevel conversionLevel = static_cast<ConversionLevel>(l);
+		LumaConverter::DownsampleFunction downsample = LumaConverter::getDownsampleFunction(factor, conversionLevel);
+		double time = measure(iterations, [&]() {
+			const uint8_t * rows[4];
+			for (int y = 0; y < height / factor; y++)
+			{
+				for (int r = 0; r < factor; r++)
+					rows[r] = luma.data() + static_cast<std::size_t>(y * factor + r) * width;
+				downsample(rows, level.data() + static_cast<std::size_t>(y) * (width / factor), width / factor);
+			}
+		});
+		if (l == CONVERSION_SCALAR)
+			scalarTime = time;
+
+		fprintf(stdout, "  %-8s %8.3f ms  %7.1f Mpixels/s  %5.2fx scalar\n", FrameConverter::getLevelName(conversionLevel), time,
+			static_cast<double>(width) * height / (time * 1000.0), scalarTime / time);
+	}
+}
+
+void benchmark(FramePixelFormat format, int width, int height, int iterations)
+{
+	TestFrame src;
+	allocateFrame(src, format, width, height, 0);
+	fillRandom(src, 1);
+	std::vector<uint8_t> luma(static_cast<std::size_t>(width) * height);
+
+	fprintf(stdout, "\n%s -> luminance %dx%d, %d iterations\n", getFramePixelFormatName(format), width, height, iterations);
+
+	double scalarTime = 0.0;
+	for (int level = CONVERSION_SCALAR; level <= FrameConverter::getBestLevel(); level++)
+	{
+		ConversionLevel conversionLevel = static_cast<ConversionLevel>(level);
+		double time = measure(iterations, [&]() {
+			LumaConverter::convert(src.view, luma.data(), conversionLevel);
+		});
+		if (level == CONVERSION_SCALAR)
+			scalarTime = time;
+
+		fprintf(stdout, "  %-8s %8.3f ms  %7.1f Mpixels/s  %5.2fx scalar\n", FrameConverter::getLevelName(conversionLevel), time,
+			static_cast<double>(width) * height / (time * 1000.0), scalarTime / time);
+	}
+}
+
+bool parseFormat(const char * name, std::vector<FramePixelFormat> & formats)
+{
+	const FramePixelFormat known[] = { FRAME_FORMAT_BGR24, FRAME_FORMAT_BGRA, FRAME_FORMAT_YUYV422, FRAME_FORMAT_UYVY422, FRAME_FORMAT_NV12 };
+	for (std::size_t i = 0; i < sizeof(known) / sizeof(FramePixelFormat); i++)
+	{
+		if (strcmp(name, getFramePixelFormatName(known[i])) == 0)
+		{
+			formats.assign(1, known[i]);
+			return true;
+		}
+	}
+	return false;
+}
+
+int main( int argc, char* argv[] )
+{
+	int width = 1920;
+	int height = 1080;
+	int iterations = 100;
+	bool verifyOnly = false;
+
+	std::vector<FramePixelFormat> formats;
+	formats.push_back(FRAME_FORMAT_BGR24);
+	formats.push_back(FRAME_FORMAT_BGRA);
+	formats.push_back(FRAME_FORMAT_YUYV422);
+	formats.push_back(FRAME_FORMAT_UYVY422);
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-width") == 0 && argc > (i + 1))
+			width = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-height") == 0 && argc > (i + 1))
+			height = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-iterations") == 0 && argc > (i + 1))
+			iterations = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-format") == 0 && argc > (i + 1))
+		{
+			if (!parseFormat(argv[i + 1], formats))
+				fprintf(stderr, "Unknown format %s\n", argv[i + 1]);
+		}
+		else if (strcmp(argv[i], "-verify") == 0)
+			verifyOnly = true;
+	}
+
+	fprintf(stdout, "Best conversion level: %s\n", FrameConverter::getLevelName(FrameConverter::getBestLevel()));
+
+	bool exact = verify(formats);
+	if (!verifyOnly)
+	{
+		for (std::size_t f = 0; f < formats.size(); f++)
+		{
+			benchmark(formats[f], width, height, iterations);
+			//4k captures
+			benchmark(formats[f], 3840, 2160, iterations);
+		}
+		benchmarkDownsample(2, width, height, iterations);
+		benchmarkDownsample(4, width, height, iterations);
+	}
+
+	return exact ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,585 @@
+#include "SyntheticSlide.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+	//error correction level M, index is the version
+	const int MaxVersion = 6;
+	const int EccCodewordsPerBlock[MaxVersion + 1] = { 0, 10, 16, 26, 18, 24, 16 };
+	const int ErrorCorrectionBlocks[MaxVersion + 1] = { 0, 1, 1, 1, 2, 2, 4 };
+	const int FormatLevelBits = 0; //M
+
+	//modules that carry codewords (no version information below version 7)
+	int getRawDataModules(int version)
+	{
+		int modules = (16 * version + 128) * version + 64;
+		if (version >= 2)
+		{
+			int alignments = version / 7 + 2;
+			modules -= (25 * alignments - 10) * alignments - 55;
+		}
+		return modules;
+	}
+
+	//baseline tables of the JPEG standard (Annex K), row by row
+	const int LumaQuantization[64] = {
+		16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55,
+		14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+		18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92,
+		49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99 };
+	const int ChromaQuantization[64] = {
+		17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+		24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+		99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+		99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 };
+
+	int getDataCodewords(int version)
+	{
+		return getRawDataModules(version) / 8 - EccCodewordsPerBlock[version] * ErrorCorrectionBlocks[version];
+	}
+
+	uint8_t multiply(uint8_t x, uint8_t y)
+	{
+		int z = 0;
+		for (int i = 7; i >= 0; i--)
+		{
+			z = (z << 1) ^ ((z >> 7) * 0x11D);
+			z ^= ((y >> i) & 1) * x;
+		}
+		return static_cast<uint8_t>(z);
+	}
+
+	std::vector<uint8_t> getReedSolomonDivisor(int degree)
+	{
+		std::vector<uint8_t> result(degree, 0);
+		result[degree - 1] = 1;
+		uint8_t root = 1;
+		for (int i = 0; i < degree; i++)
+		{
+			for (int j = 0; j < degree; j++)
+			{
+				result[j] = multiply(result[j], root);
+				if (j + 1 < degree)
+					result[j] ^= result[j + 1];
+			}
+			root = multiply(root, 0x02);
+		}
+		return result;
+	}
+
+	std::vector<uint8_t> getReedSolomonRemainder(const std::vector<uint8_t> & data, const std::vector<uint8_t> & divisor)
+	{
+		std::vector<uint8_t> result(divisor.size(), 0);
+		for (std::size_t i = 0; i < data.size(); i++)
+		{
+			uint8_t factor = data[i] ^ result[0];
+			result.erase(result.begin());
+			result.push_back(0);
+			for (std::size_t j = 0; j < result.size(); j++)
+				result[j] ^= multiply(divisor[j], factor);
+		}
+		return result;
+	}
+
+	//data codewords split into blocks, error correction added and interleaved
+	std::vector<uint8_t> addErrorCorrection(const std::vector<uint8_t> & data, int version)
+	{
+		int blockCount = ErrorCorrectionBlocks[version];
+		int blockEcc = EccCodewordsPerBlock[version];
+		int rawCodewords = getRawDataModules(version) / 8;
+		int shortBlocks = blockCount - rawCodewords % blockCount;
+		int shortBlockLength = rawCodewords / blockCount;
+
+		std::vector<uint8_t> divisor = getReedSolomonDivisor(blockEcc);
+		std::vector<std::vector<uint8_t> > blocks;
+		std::size_t k = 0;
+		for (int i = 0; i < blockCount; i++)
+		{
+			std::size_t length = shortBlockLength - blockEcc + (i < shortBlocks ? 0 : 1);
+			std::vector<uint8_t> block(data.begin() + k, data.begin() + k + length);
+			k += length;
+			std::vector<uint8_t> ecc = getReedSolomonRemainder(block, divisor);
+			if (i < shortBlocks)
+				block.push_back(0);
+			block.insert(block.end(), ecc.begin(), ecc.end());
+			blocks.push_back(block);
+		}
+
+		std::vector<uint8_t> result;
+		for (std::size_t i = 0; i < blocks[0].size(); i++)
+		{
+			for (int j = 0; j < blockCount; j++)
+			{
+				//the padding byte of short blocks is skipped
+				if (i != static_cast<std::size_t>(shortBlockLength - blockEcc) || j >= shortBlocks)
+					result.push_back(blocks[j][i]);
+			}
+		}
+		return result;
+	}
+
+	class ModuleGrid
+	{
+	public:
+		ModuleGrid(int version) : size(version * 4 + 17), modules(size * size, false), function(size * size, false)
+		{
+		}
+
+		void setFunction(int x, int y, bool dark)
+		{
+			modules[y * size + x] = dark;
+			function[y * size + x] = true;
+		}
+
+		void drawFinder(int x, int y)
+		{
+			for (int dy = -4; dy <= 4; dy++)
+			{
+				for (int dx = -4; dx <= 4; dx++)
+				{
+					int distance = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+					if (x + dx >= 0 && x + dx < size && y + dy >= 0 && y + dy < size)
+						setFunction(x + dx, y + dy, distance != 2 && distance != 4);
+				}
+			}
+		}
+
+		void drawAlignment(int x, int y)
+		{
+			for (int dy = -2; dy <= 2; dy++)
+			{
+				for (int dx = -2; dx <= 2; dx++)
+					setFunction(x + dx, y + dy, (abs(dx) > abs(dy) ? abs(dx) : abs(dy)) != 1);
+			}
+		}
+
+		void drawFormatBits(int mask)
+		{
+			int data = FormatLevelBits << 3 | mask;
+			int remainder = data;
+			for (int i = 0; i < 10; i++)
+				remainder = (remainder << 1) ^ ((remainder >> 9) * 0x537);
+			int bits = (data << 10 | remainder) ^ 0x5412;
+
+			for (int i = 0; i <= 5; i++)
+				setFunction(8, i, ((bits >> i) & 1) != 0);
+			setFunction(8, 7, ((bits >> 6) & 1) != 0);
+			setFunction(8, 8, ((bits >> 7) & 1) != 0);
+			setFunction(7, 8, ((bits >> 8) & 1) != 0);
+			for (int i = 9; i < 15; i++)
+				setFunction(14 - i, 8, ((bits >> i) & 1) != 0);
+
+			for (int i = 0; i < 8; i++)
+				setFunction(size - 1 - i, 8, ((bits >> i) & 1) != 0);
+			for (int i = 8; i < 15; i++)
+				setFunction(8, size - 15 + i, ((bits >> i) & 1) != 0);
+			setFunction(8, size - 8, true);
+		}
+
+		void drawFunctionPatterns(int version)
+		{
+			for (int i = 0; i < size; i++)
+			{
+				setFunction(6, i, i % 2 == 0);
+				setFunction(i, 6, i % 2 == 0);
+			}
+
+			drawFinder(3, 3);
+			drawFinder(size - 4, 3);
+			drawFinder(3, size - 4);
+
+			//versions 2 to 6 have a single alignment pattern
+			if (version >= 2)
+				drawAlignment(size - 7, size - 7);
+
+			drawFormatBits(0); //reserves the modules
+		}
+
+		void drawCodewords(const std::vector<uint8_t> & codewords)
+		{
+			std::size_t i = 0;
+			for (int right = size - 1; right >= 1; right -= 2)
+			{
+				if (right == 6)
+					right = 5;
+				for (int vertical = 0; vertical < size; vertical++)
+				{
+					for (int j = 0; j < 2; j++)
+					{
+						int x = right - j;
+						bool upward = ((right + 1) & 2) == 0;
+						int y = upward ? size - 1 - vertical : vertical;
+						if (!function[y * size + x] && i < codewords.size() * 8)
+						{
+							modules[y * size + x] = ((codewords[i >> 3] >> (7 - (i & 7))) & 1) != 0;
+							i++;
+						}
+					}
+				}
+			}
+		}
+
+		void applyMask(int mask)
+		{
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					bool invert = false;
+					switch (mask)
+					{
+					case 0: invert = (x + y) % 2 == 0; break;
+					case 1: invert = y % 2 == 0; break;
+					case 2: invert = x % 3 == 0; break;
+					case 3: invert = (x + y) % 3 == 0; break;
+					case 4: invert = (x / 3 + y / 2) % 2 == 0; break;
+					case 5: invert = x * y % 2 + x * y % 3 == 0; break;
+					case 6: invert = (x * y % 2 + x * y % 3) % 2 == 0; break;
+					default: invert = ((x + y) % 2 + x * y % 3) % 2 == 0; break;
+					}
+					if (invert && !function[y * size + x])
+						modules[y * size + x] = !modules[y * size + x];
+				}
+			}
+		}
+
+		bool get(int x, int y) const
+		{
+			return modules[y * size + x];
+		}
+
+		//the four penalty rules of the standard
+		int getPenalty() const
+		{
+			const bool finderLike[11] = { true, false, true, true, true, false, true, false, false, false, false };
+			int penalty = 0;
+			int dark = 0;
+			for (int line = 0; line < size; line++)
+			{
+				for (int direction = 0; direction < 2; direction++)
+				{
+					int run = 0;
+					bool previous = false;
+					for (int i = 0; i < size; i++)
+					{
+						bool module = direction == 0 ? get(i, line) : get(line, i);
+						if (i > 0 && module == previous)
+						{
+							run++;
+							if (run == 5)
+								penalty += 3;
+							else if (run > 5)
+								penalty++;
+						}
+						else
+							run = 1;
+						previous = module;
+
+						//1:1:3:1:1 with four light modules on one side
+						if (i + 11 <= size)
+						{
+							bool forward = true;
+							bool backward = true;
+							for (int k = 0; k < 11; k++)
+							{
+								bool value = direction == 0 ? get(i + k, line) : get(line, i + k);
+								forward = forward && value == finderLike[k];
+								backward = backward && value == finderLike[10 - k];
+							}
+							penalty += (forward ? 40 : 0) + (backward ? 40 : 0);
+						}
+					}
+				}
+			}
+
+			for (int y = 0; y < size; y++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					dark += get(x, y) ? 1 : 0;
+					if (x + 1 < size && y + 1 < size && get(x, y) == get(x + 1, y) && get(x, y) == get(x, y + 1) && get(x, y) == get(x + 1, y + 1))
+						penalty += 3;
+				}
+			}
+
+			int total = size * size;
+			int deviation = abs(dark * 20 - total * 10);
+			penalty += ((deviation + total - 1) / total - 1) * 10;
+			return penalty;
+		}
+
+		int size;
+		std::vector<bool> modules;
+		std::vector<bool> function;
+	};
+}
+
+bool encodeQRCode(const std::string & text, QRCodeModules & code)
+{
+	int version = 1;
+	while (version <= MaxVersion && 4 + 8 + static_cast<int>(text.size()) * 8 > getDataCodewords(version) * 8)
+		version++;
+	if (version > MaxVersion)
+		return false;
+
+	//byte mode, 8 bit length, terminator and pad bytes
+	int capacityBits = getDataCodewords(version) * 8;
+	std::vector<bool> bits;
+	int header = 0x4 << 8 | static_cast<int>(text.size());
+	for (int i = 11; i >= 0; i--)
+		bits.push_back(((header >> i) & 1) != 0);
+	for (std::size_t c = 0; c < text.size(); c++)
+	{
+		for (int i = 7; i >= 0; i--)
+			bits.push_back(((static_cast<uint8_t>(text[c]) >> i) & 1) != 0);
+	}
+	for (int i = 0; i < 4 && static_cast<int>(bits.size()) < capacityBits; i++)
+		bits.push_back(false);
+	while (bits.size() % 8 != 0)
+		bits.push_back(false);
+
+	std::vector<uint8_t> data(bits.size() / 8, 0);
+	for (std::size_t i = 0; i < bits.size(); i++)
+		data[i >> 3] |= (bits[i] ? 1 : 0) << (7 - (i & 7));
+	for (uint8_t pad = 0xEC; static_cast<int>(data.size()) < getDataCodewords(version); pad ^= 0xEC ^ 0x11)
+		data.push_back(pad);
+
+	std::vector<uint8_t> codewords = addErrorCorrection(data, version);
+
+	ModuleGrid best(version);
+	int bestPenalty = -1;
+	for (int mask = 0; mask < 8; mask++)
+	{
+		ModuleGrid grid(version);
+		grid.drawFunctionPatterns(version);
+		grid.drawCodewords(codewords);
+		grid.applyMask(mask);
+		grid.drawFormatBits(mask);
+
+		int penalty = grid.getPenalty();
+		if (bestPenalty < 0 || penalty < bestPenalty)
+		{
+			best = grid;
+			bestPenalty = penalty;
+		}
+	}
+
+	code.size = best.size;
+	code.modules = best.modules;
+	return true;
+}
+
+namespace
+{
+	void fillRect(SyntheticSlide & slide, int left, int top, int width, int height, uint8_t b, uint8_t g, uint8_t r)
+	{
+		int right = left + width < slide.view.width ? left + width : slide.view.width;
+		int bottom = top + height < slide.view.height ? top + height : slide.view.height;
+		for (int y = top > 0 ? top : 0; y < bottom; y++)
+		{
+			uint8_t * row = slide.view.planes[0] + static_cast<std::size_t>(y) * slide.view.linesizes[0];
+			for (int x = left > 0 ? left : 0; x < right; x++)
+			{
+				row[x * 3 + 0] = b;
+				row[x * 3 + 1] = g;
+				row[x * 3 + 2] = r;
+			}
+		}
+	}
+}
+
+void renderSlide(SyntheticSlide & slide, int width, int height, const std::vector<SlideMarker> & markers, unsigned int seed)
+{
+	slide.data.assign(static_cast<std::size_t>(width) * height * 3, 0);
+	slide.view = FrameView();
+	slide.view.format = FRAME_FORMAT_BGR24;
+	slide.view.orientation = FRAME_TOP_DOWN;
+	slide.view.width = width;
+	slide.view.height = height;
+	slide.view.linesizes[0] = width * 3;
+	slide.view.planes[0] = slide.data.data();
+
+	//background, title bar and lines of "text"
+	srand(seed);
+	fillRect(slide, 0, 0, width, height, 245, 245, 245);
+	fillRect(slide, 0, 0, width, height / 8, 211, 178, 103);
+	int lineHeight = height / 40 > 2 ? height / 40 : 2;
+	for (int y = height / 5; y + lineHeight < height - height / 10; y += lineHeight * 2)
+	{
+		int x = width / 12;
+		while (x < width - width / 12)
+		{
+			int word = width / 60 + rand() % (width / 25 + 1);
+			fillRect(slide, x, y, word, lineHeight, 40, 40, 40);
+			x += word + lineHeight;
+		}
+	}
+
+	for (std::size_t m = 0; m < markers.size(); m++)
+	{
+		QRCodeModules code;
+		if (!encodeQRCode(markers[m].text, code))
+			continue;
+
+		int pixels = markers[m].modulePixels;
+		int left = static_cast<int>(markers[m].x * width);
+		int top = static_cast<int>(markers[m].y * height);
+		fillRect(slide, left, top, (code.size + 8) * pixels, (code.size + 8) * pixels, 255, 255, 255);
+		for (int y = 0; y < code.size; y++)
+		{
+			for (int x = 0; x < code.size; x++)
+			{
+				if (code.get(x, y))
+					fillRect(slide, left + (x + 4) * pixels, top + (y + 4) * pixels, pixels, pixels, 0, 0, 0);
+			}
+		}
+	}
+}
+
+void blurSlide(SyntheticSlide & slide, int radius)
+{
+	if (radius <= 0)
+		return;
+
+	int width = slide.view.width;
+	int height = slide.view.height;
+	int stride = slide.view.linesizes[0];
+	std::vector<int> line(std::max(width, height));
+	for (int pass = 0; pass < 4; pass++)
+	{
+		//even passes run along the rows, odd ones along the columns
+		bool rows = pass % 2 == 0;
+		int lines = rows ? height : width;
+		int length = rows ? width : height;
+		int step = rows ? 3 : stride;
+		for (int l = 0; l < lines; l++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uint8_t * p = slide.data.data() + (rows ? l * stride : l * 3) + c;
+				for (int i = 0; i < length; i++)
+					line[i] = p[i * step];
+
+				//running sum over the clamped window
+				int sum = 0;
+				for (int i = -radius; i <= radius; i++)
+					sum += line[std::min(std::max(i, 0), length - 1)];
+				for (int i = 0; i < length; i++)
+				{
+					p[i * step] = static_cast<uint8_t>((sum + radius) / (2 * radius + 1));
+					sum += line[std::min(i + radius + 1, length - 1)] - line[std::max(i - radius, 0)];
+				}
+			}
+		}
+	}
+}
+
+void compressSlide(SyntheticSlide & slide, int quality)
+{
+	if (quality <= 0 || quality >= 100)
+		return;
+
+	//quality scaling of the IJG library
+	int scale = quality < 50 ? 5000 / quality : 200 - 2 * quality;
+	float quantization[2][64];
+	for (int i = 0; i < 64; i++)
+	{
+		quantization[0][i] = static_cast<float>(std::min(255, std::max(1, (LumaQuantization[i] * scale + 50) / 100)));
+		quantization[1][i] = static_cast<float>(std::min(255, std::max(1, (ChromaQuantization[i] * scale + 50) / 100)));
+	}
+
+	float basis[8][8]; //[frequency][sample]
+	for (int u = 0; u < 8; u++)
+	{
+		for (int x = 0; x < 8; x++)
+			basis[u][x] = (u == 0 ? sqrtf(0.125f) : 0.5f) * cosf((2.f * x + 1.f) * u * 3.14159265f / 16.f);
+	}
+
+	int width = slide.view.width;
+	int height = slide.view.height;
+	int stride = slide.view.linesizes[0];
+	float block[3][8][8];
+	float temp[8][8];
+	for (int by = 0; by < height; by += 8)
+	{
+		for (int bx = 0; bx < width; bx += 8)
+		{
+			//to YCbCr, edge blocks repeat the last pixels
+			for (int y = 0; y < 8; y++)
+			{
+				for (int x = 0; x < 8; x++)
+				{
+					const uint8_t * p = slide.data.data() + std::min(by + y, height - 1) * stride + std::min(bx + x, width - 1) * 3;
+					float r = p[2], g = p[1], b = p[0];
+					block[0][y][x] = 0.299f * r + 0.587f * g + 0.114f * b - 128.f;
+					block[1][y][x] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+					block[2][y][x] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+				}
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				const float * q = quantization[c == 0 ? 0 : 1];
+				float (*b)[8] = block[c];
+				//forward transform of the rows then the columns, quantize, and back
+				for (int y = 0; y < 8; y++)
+				{
+					for (int u = 0; u < 8; u++)
+					{
+						float sum = 0.f;
+						for (int x = 0; x < 8; x++)
+							sum += basis[u][x] * b[y][x];
+						temp[y][u] = sum;
+					}
+				}
+				for (int u = 0; u < 8; u++)
+				{
+					for (int v = 0; v < 8; v++)
+					{
+						float sum = 0.f;
+						for (int y = 0; y < 8; y++)
+							sum += basis[v][y] * temp[y][u];
+						b[v][u] = floorf(sum / q[v * 8 + u] + 0.5f) * q[v * 8 + u];
+					}
+				}
+				for (int u = 0; u < 8; u++)
+				{
+					for (int y = 0; y < 8; y++)
+					{
+						float sum = 0.f;
+						for (int v = 0; v < 8; v++)
+							sum += basis[v][y] * b[v][u];
+						temp[y][u] = sum;
+					}
+				}
+				for (int y = 0; y < 8; y++)
+				{
+					for (int x = 0; x < 8; x++)
+					{
+						float sum = 0.f;
+						for (int u = 0; u < 8; u++)
+							sum += basis[u][x] * temp[y][u];
+						b[y][x] = sum;
+					}
+				}
+			}
+
+			for (int y = 0; y < 8 && by + y < height; y++)
+			{
+				for (int x = 0; x < 8 && bx + x < width; x++)
+				{
+					float luma = block[0][y][x] + 128.f;
+					float cb = block[1][y][x];
+					float cr = block[2][y][x];
+					float bgr[3] = { luma + 1.772f * cb, luma - 0.344136f * cb - 0.714136f * cr, luma + 1.402f * cr };
+					uint8_t * p = slide.data.data() + (by + y) * stride + (bx + x) * 3;
+					for (int c = 0; c < 3; c++)
+						p[c] = static_cast<uint8_t>(std::min(255.f, std::max(0.f, bgr[c] + 0.5f)));
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef __SYNTHETIC_SLIDE_
+#define __SYNTHETIC_SLIDE_
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <CaptureFrame.hpp>
+
+//QR code modules, true is dark
+struct QRCodeModules
+{
+	int size;
+	std::vector<bool> modules; //row by row
+
+	bool get(int x, int y) const
+	{
+		return modules[y * size + x];
+	}
+};
+
+//Minimal QR encoder for the benchmark markers: byte mode, error correction level M,
+//versions 1 to 6 (up to 106 bytes), the mask with the lowest penalty is used.
+bool encodeQRCode(const std::string & text, QRCodeModules & code);
+
+//A marker placed on a slide, position of the top left corner relative to the slide size
+struct SlideMarker
+{
+	std::string text;
+	float x;
+	float y;
+	int modulePixels; //size of a module in pixels
+};
+
+//BGR24 slide in memory, top down
+struct SyntheticSlide
+{
+	std::vector<uint8_t> data;
+	FrameView view;
+};
+
+//Renders a light slide with some dark text-like bars and the markers (with their quiet zone)
+void renderSlide(SyntheticSlide & slide, int width, int height, const std::vector<SlideMarker> & markers, unsigned int seed);
+
+//Box blur of the given radius run twice, close to a gaussian like a slightly defocused capture
+void blurSlide(SyntheticSlide & slide, int radius);
+
+//JPEG artifacts without a codec: 8x8 DCT blocks of YCbCr quantized with the baseline tables at quality 1-100
+void compressSlide(SyntheticSlide & slide, int quality);
+
+#endif
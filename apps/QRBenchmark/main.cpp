@@ -0,0 +1,419 @@
+/*
+*  Copyright 2016-2017 Erik Sundn
+*
+* All rights reserved.
+*
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+* 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+* 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+* 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived from this software without specific prior written permission.
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+* IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+//Headless benchmark of the QR code detection on synthetic slides.
+//Compares scanning the whole frame with scanning regions (corners, bottom strip)
+//and with tracking the codes found last, and shows which markers each of them finds.
+//The pyramid configurations start at a downsampled frame which fits the marker module size.
+//"full unchanged" shows the cost of an unchanged frame, which is hashed instead of decoded.
+//The corpus varies marker scale, position, blur, JPEG artifacts and resolution (720p to 4K) and reports
+//the latency percentiles and recall of every binarizer and try harder configuration of the QR interpreter.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <FrameLuminanceSource.h>
+#include <QRRegionScanner.hpp>
+#include "SyntheticSlide.hpp"
+
+template<typename Function>
+double measure(int iterations, Function function)
+{
+	function(); //warm up
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < iterations; i++)
+		function();
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() / static_cast<double>(iterations);
+}
+
+struct ScanConfiguration
+{
+	const char * name;
+	std::vector<std::string> regions;
+	bool tracking;
+	bool pyramid; //with the module size of the markers
+	bool gated; //unchanged frames reuse the last codes, the benchmark repeats one frame
+};
+
+struct SlideLayout
+{
+	const char * name;
+	std::vector<SlideMarker> markers;
+};
+
+SlideMarker makeMarker(const char * text, float x, float y, int modulePixels)
+{
+	SlideMarker marker;
+	marker.text = text;
+	marker.x = x;
+	marker.y = y;
+	marker.modulePixels = modulePixels;
+	return marker;
+}
+
+std::string joinTexts(const std::vector<std::string> & texts)
+{
+	std::string joined;
+	for (std::size_t i = 0; i < texts.size(); i++)
+		joined += (i > 0 ? ", " : "") + texts[i];
+	return joined.empty() ? "-" : joined;
+}
+
+void printLevels(const QRRegionScanner & scanner)
+{
+	for (int level = scanner.getCoarsestLevel(); level >= 0; level--)
+	{
+		if (scanner.getNumberOfLevelScans(level) == 0)
+			continue;
+		fprintf(stdout, "  %16s %dx: %u of %u tries decoded, %.3f ms per try\n", "", 1 << level,
+			static_cast<unsigned int>(scanner.getNumberOfLevelHits(level)), static_cast<unsigned int>(scanner.getNumberOfLevelScans(level)),
+			scanner.getAverageLevelScanTime(level) * 1000.0);
+	}
+}
+
+void benchmarkRegions(const SlideLayout & layout, const std::vector<ScanConfiguration> & configurations, int width, int height, int iterations, std::size_t sweepInterval, float moduleSize)
+{
+	SyntheticSlide slide;
+	renderSlide(slide, width, height, layout.markers, 1);
+
+	fprintf(stdout, "\nSlide with %s %dx%d, %d iterations\n", layout.name, width, height, iterations);
+
+	double fullTime = 0.0;
+	for (std::size_t c = 0; c < configurations.size(); c++)
+	{
+		//interval 0 only sweeps the first frame, the warm up, so the region scans are measured
+		QRRegionScanner scanner;
+		for (std::size_t r = 0; r < configurations[c].regions.size(); r++)
+			scanner.addRegions(configurations[c].regions[r]);
+		scanner.setTracking(configurations[c].tracking);
+		scanner.setFullSweepInterval(0);
+		scanner.setModuleSize(configurations[c].pyramid ? moduleSize : 0.f);
+		scanner.setRescanInterval(configurations[c].gated ? 30 : 0);
+
+		//the slide is read in place, the luma buffer is reused like the detection worker does
+		zxing::Ref<FrameLuminanceSource::LumaBuffer> lumaBuffer(new FrameLuminanceSource::LumaBuffer());
+		QRRegionScanner::Scan scan;
+		double time = measure(iterations, [&]() {
+			scan = scanner.scan(FrameLuminanceSource::create(slide.view, lumaBuffer));
+		});
+
+		if (c == 0)
+		{
+			fullTime = time;
+			fprintf(stdout, "  %-16s %8.3f ms  100%% of the pixels           found: %s\n", configurations[c].name, time, joinTexts(scan.texts).c_str());
+		}
+		else if (scanner.isScanningFullFrames())
+		{
+			fprintf(stdout, "  %-16s %8.3f ms  %3.0f%% of the pixels  %5.2fx  found: %s\n", configurations[c].name, time,
+				100.0 * static_cast<double>(scan.scannedPixels) / (static_cast<double>(width) * height), fullTime / time, joinTexts(scan.texts).c_str());
+		}
+		else
+		{
+			//a full sweep every sweepInterval frames on top of the region scans
+			double amortized = (fullTime + time * static_cast<double>(sweepInterval)) / static_cast<double>(sweepInterval + 1);
+			fprintf(stdout, "  %-16s %8.3f ms  %3.0f%% of the pixels  %5.2fx  found: %s (%.3f ms with a sweep every %u frames)\n", configurations[c].name, time,
+				100.0 * static_cast<double>(scan.scannedPixels) / (static_cast<double>(width) * height), fullTime > 0.0 ? fullTime / time : 0.0,
+				joinTexts(scan.texts).c_str(), amortized, static_cast<unsigned int>(sweepInterval));
+		}
+
+		if (configurations[c].pyramid)
+			printLevels(scanner);
+	}
+}
+
+struct Degradation
+{
+	const char * name;
+	int blurRadius;
+	int jpegQuality; //0 = none
+};
+
+struct CorpusSlide
+{
+	int height;
+	int scale; //index of the module size
+	int position; //index of the position, -1 without a marker
+	int degradation;
+	std::string text;
+};
+
+//a decoder configuration and what it did on every slide of the corpus
+struct CorpusResult
+{
+	std::string name;
+	QRDecoderSelector decoder;
+	std::vector<double> times; //ms, one per slide
+	std::vector<bool> found;
+	std::size_t falsePositives;
+};
+
+double percentile(std::vector<double> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	return values[std::min(values.size() - 1, static_cast<std::size_t>(p * values.size()))];
+}
+
+//recall of every configuration for each value of key, slides without a marker don't count
+template<typename Key>
+void printRecall(const char * title, const std::vector<std::string> & names, const std::vector<CorpusSlide> & slides, std::vector<CorpusResult> & results, Key key)
+{
+	fprintf(stdout, "\nRecall per %s\n  %-16s", title, "");
+	for (std::size_t n = 0; n < names.size(); n++)
+		fprintf(stdout, " %12s", names[n].c_str());
+	fprintf(stdout, "\n");
+
+	for (std::size_t r = 0; r < results.size(); r++)
+	{
+		fprintf(stdout, "  %-16s", results[r].name.c_str());
+		for (int n = 0; n < static_cast<int>(names.size()); n++)
+		{
+			std::size_t markers = 0;
+			std::size_t found = 0;
+			for (std::size_t s = 0; s < slides.size(); s++)
+			{
+				if (slides[s].position < 0 || key(slides[s]) != n)
+					continue;
+				markers++;
+				found += results[r].found[s] ? 1 : 0;
+			}
+			if (markers > 0)
+				fprintf(stdout, " %11.1f%%", 100.0 * static_cast<double>(found) / static_cast<double>(markers));
+			else
+				fprintf(stdout, " %12s", "-");
+		}
+		fprintf(stdout, "\n");
+	}
+}
+
+void benchmarkCorpus(const std::vector<int> & heights)
+{
+	const char * texts[] = { "FrontCapture;SetActive", "AllCaptures;Clear", "Plane1;SetActive" };
+	const char * positionNames[] = { "corner", "bottom", "center" };
+	//module pixels are height / divisor, so markers cover the same share of the slide at every resolution
+	const int scaleDivisors[] = { 360, 240, 180, 120 };
+	const Degradation degradations[] = { { "clean", 0, 0 }, { "blur 1", 1, 0 }, { "blur 2", 2, 0 }, { "jpeg 75", 0, 75 }, { "jpeg 40", 0, 40 }, { "blur 1+jpeg 60", 1, 60 } };
+	const int positionCount = sizeof(positionNames) / sizeof(positionNames[0]);
+	const int scaleCount = sizeof(scaleDivisors) / sizeof(int);
+	const int degradationCount = sizeof(degradations) / sizeof(Degradation);
+
+	//every marker at every scale, position and degradation, plus a slide without a marker per degradation
+	std::vector<CorpusSlide> slides;
+	for (std::size_t h = 0; h < heights.size(); h++)
+	{
+		for (int d = 0; d < degradationCount; d++)
+		{
+			CorpusSlide empty = { heights[h], 0, -1, d, "" };
+			slides.push_back(empty);
+			for (int s = 0; s < scaleCount; s++)
+			{
+				for (int p = 0; p < positionCount; p++)
+				{
+					CorpusSlide slide = { heights[h], s, p, d, texts[slides.size() % 3] };
+					slides.push_back(slide);
+				}
+			}
+		}
+	}
+
+	std::vector<CorpusResult> results(QRDecoderSelector::ConfigCount + 1);
+	for (int c = 0; c < QRDecoderSelector::ConfigCount; c++)
+	{
+		results[c].name = QRDecoderSelector::getConfigName(c);
+		results[c].decoder.setConfig(c);
+	}
+	for (std::size_t r = 0; r < results.size(); r++)
+		results[r].falsePositives = 0;
+	results.back().name = "adaptive";
+	results.back().decoder.setAdaptive(true);
+
+	fprintf(stdout, "\nCorpus of %u slides, scanning each once per configuration\n", static_cast<unsigned int>(slides.size()));
+
+	SyntheticSlide slide;
+	zxing::Ref<FrameLuminanceSource::LumaBuffer> lumaBuffer(new FrameLuminanceSource::LumaBuffer());
+	for (std::size_t s = 0; s < slides.size(); s++)
+	{
+		int height = slides[s].height;
+		int width = height * 16 / 9;
+		std::vector<SlideMarker> markers;
+		if (slides[s].position >= 0)
+		{
+			QRCodeModules code;
+			encodeQRCode(slides[s].text, code);
+			int modulePixels = std::max(1, height / scaleDivisors[slides[s].scale]);
+			int size = (code.size + 8) * modulePixels;
+			int margin = height / 50;
+			int lefts[] = { width - size - margin, (width - size) / 2, (width - size) / 2 };
+			int tops[] = { margin, height - size - margin, (height - size) / 2 };
+			markers.push_back(makeMarker(slides[s].text.c_str(), static_cast<float>(lefts[slides[s].position]) / width,
+				static_cast<float>(tops[slides[s].position]) / height, modulePixels));
+		}
+		renderSlide(slide, width, height, markers, static_cast<unsigned int>(s));
+		blurSlide(slide, degradations[slides[s].degradation].blurRadius);
+		compressSlide(slide, degradations[slides[s].degradation].jpegQuality);
+
+		for (std::size_t r = 0; r < results.size(); r++)
+		{
+			//the luminance conversion is part of the latency, as in the detection worker
+			std::vector<QRCodeDetection> detections;
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			detections = results[r].decoder.detect(FrameLuminanceSource::create(slide.view, lumaBuffer));
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+			bool found = false;
+			for (std::size_t d = 0; d < detections.size(); d++)
+			{
+				if (detections[d].text == slides[s].text)
+					found = true;
+				else
+					results[r].falsePositives++;
+			}
+			results[r].times.push_back(elapsed.count());
+			results[r].found.push_back(found);
+		}
+	}
+
+	std::size_t markerSlides = 0;
+	for (std::size_t s = 0; s < slides.size(); s++)
+		markerSlides += slides[s].position >= 0 ? 1 : 0;
+
+	fprintf(stdout, "\n  %-16s %9s %9s %9s %9s %8s %6s\n", "configuration", "p50 ms", "p90 ms", "p99 ms", "max ms", "recall", "wrong");
+	for (std::size_t r = 0; r < results.size(); r++)
+	{
+		std::size_t found = std::count(results[r].found.begin(), results[r].found.end(), true);
+		fprintf(stdout, "  %-16s %9.2f %9.2f %9.2f %9.2f %7.1f%% %6u\n", results[r].name.c_str(),
+			percentile(results[r].times, 0.5), percentile(results[r].times, 0.9), percentile(results[r].times, 0.99), percentile(results[r].times, 1.0),
+			100.0 * static_cast<double>(found) / static_cast<double>(std::max<std::size_t>(1, markerSlides)), static_cast<unsigned int>(results[r].falsePositives));
+	}
+	fprintf(stdout, "  adaptive ended with %s after %u explorations\n", QRDecoderSelector::getConfigName(results.back().decoder.getSelectedConfig()),
+		static_cast<unsigned int>(results.back().decoder.getNumberOfExplorations()));
+
+	std::vector<std::string> names;
+	for (int d = 0; d < degradationCount; d++)
+		names.push_back(degradations[d].name);
+	printRecall("degradation", names, slides, results, [](const CorpusSlide & slide) { return slide.degradation; });
+
+	names.clear();
+	for (int s = 0; s < scaleCount; s++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "height/%d", scaleDivisors[s]);
+		names.push_back(name);
+	}
+	printRecall("module size", names, slides, results, [](const CorpusSlide & slide) { return slide.scale; });
+
+	names.assign(positionNames, positionNames + positionCount);
+	printRecall("position", names, slides, results, [](const CorpusSlide & slide) { return slide.position; });
+
+	names.clear();
+	for (std::size_t h = 0; h < heights.size(); h++)
+		names.push_back(std::to_string(heights[h]) + "p");
+	printRecall("resolution", names, slides, results, [&heights](const CorpusSlide & slide) {
+		return static_cast<int>(std::find(heights.begin(), heights.end(), slide.height) - heights.begin()); });
+}
+
+int main( int argc, char* argv[] )
+{
+	int width = 1920;
+	int height = 1080;
+	int iterations = 30;
+	std::size_t sweepInterval = 30;
+	bool runRegions = true;
+	bool runCorpus = true;
+	std::vector<int> corpusHeights;
+
+	//arguments:
+	// -width <regions benchmark width>
+	// -height <regions benchmark height>
+	// -iterations <scans per configuration in the regions benchmark>
+	// -qrsweep <frames between full frame scans>
+	// -mode <regions|corpus|all>
+	// -corpusheight <slide height of the corpus, 720 to 2160> (repeatable, default 720, 1080, 1440 and 2160)
+	for (int i = 0; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-width") == 0 && argc > (i + 1))
+			width = std::max(64, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-height") == 0 && argc > (i + 1))
+			height = std::max(64, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-iterations") == 0 && argc > (i + 1))
+			iterations = std::max(1, atoi(argv[i + 1]));
+		else if (strcmp(argv[i], "-qrsweep") == 0 && argc > (i + 1))
+			sweepInterval = static_cast<std::size_t>(std::max(1, atoi(argv[i + 1])));
+		else if (strcmp(argv[i], "-mode") == 0 && argc > (i + 1))
+		{
+			runRegions = strcmp(argv[i + 1], "corpus") != 0;
+			runCorpus = strcmp(argv[i + 1], "regions") != 0;
+		}
+		else if (strcmp(argv[i], "-corpusheight") == 0 && argc > (i + 1))
+			corpusHeights.push_back(std::min(2160, std::max(720, atoi(argv[i + 1]))));
+	}
+
+	if (corpusHeights.empty())
+	{
+		int heights[] = { 720, 1080, 1440, 2160 };
+		corpusHeights.assign(heights, heights + 4);
+	}
+
+	//the full frame scan goes first, the others are compared with it
+	std::vector<ScanConfiguration> configurations(8);
+	for (std::size_t c = 0; c < configurations.size(); c++)
+	{
+		configurations[c].tracking = false;
+		configurations[c].pyramid = false;
+		configurations[c].gated = false;
+	}
+	configurations[0].name = "full frame";
+	configurations[1].name = "full pyramid";
+	configurations[1].pyramid = true;
+	configurations[2].name = "corners";
+	configurations[2].regions.push_back("corners");
+	configurations[3].name = "bottom";
+	configurations[3].regions.push_back("bottom");
+	configurations[4].name = "corners+bottom";
+	configurations[4].regions.push_back("corners");
+	configurations[4].regions.push_back("bottom");
+	configurations[5].name = "tracking";
+	configurations[5].tracking = true;
+	configurations[6].name = "tracking pyramid";
+	configurations[6].tracking = true;
+	configurations[6].pyramid = true;
+	configurations[7].name = "full unchanged";
+	configurations[7].gated = true;
+
+	//markers about the size they have on projected slides
+	int modulePixels = std::max(2, height / 180);
+	std::vector<SlideLayout> layouts(4);
+	layouts[0].name = "no marker";
+	layouts[1].name = "a corner marker";
+	layouts[1].markers.push_back(makeMarker("Plane1;SetActive", 0.85f, 0.05f, modulePixels));
+	layouts[2].name = "a bottom marker";
+	layouts[2].markers.push_back(makeMarker("AllCaptures;Clear", 0.45f, 0.75f, modulePixels));
+	layouts[3].name = "a centered marker";
+	layouts[3].markers.push_back(makeMarker("Plane2;SetActive", 0.45f, 0.4f, modulePixels));
+
+	for (std::size_t l = 0; runRegions && l < layouts.size(); l++)
+		benchmarkRegions(layouts[l], configurations, width, height, iterations, sweepInterval, static_cast<float>(modulePixels));
+
+	if (runCorpus)
+		benchmarkCorpus(corpusHeights);
+
+	return EXIT_SUCCESS;
+}
@@ -1,41 +0,0 @@
-#ifndef _BGR24_LUMINANCE_SOURCE_H_
-#define _BGR24_LUMINANCE_SOURCE_H_
-/*
- *  Copyright 2017 Erik Sundn
- *
- *  Based on ImageReaderSource
- *  Copyright 2010-2011 ZXing authors
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *      http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include <zxing/LuminanceSource.h>
-
-class BGR24LuminanceSource : public zxing::LuminanceSource {
-public:
-  BGR24LuminanceSource(zxing::ArrayRef<char> image, int width, int height);
-
-  static zxing::Ref<LuminanceSource> create(uint8_t** data, int width, int height, bool flipped = false);
-
-  zxing::ArrayRef<char> getRow(int y, zxing::ArrayRef<char> row) const;
-  zxing::ArrayRef<char> getMatrix() const;
-
-private:
-	typedef LuminanceSource Super;
-
-	const zxing::ArrayRef<char> image;
-
-	char convertPixel(const char* pixel) const;
-};
-
-#endif /* _BGR24_LUMINANCE_SOURCE_H_ */
@@ -0,0 +1,127 @@
+#ifndef __BOUNDED_QUEUE_
+#define __BOUNDED_QUEUE_
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+//Fixed capacity single producer/single consumer queue.
+//When full the oldest entry is handed back to the producer (drop-oldest),
+//so a slow consumer never stalls the stage feeding it.
+template <typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(std::size_t capacity = 4)
+		: mItems(capacity > 0 ? capacity : 1)
+		, mHead(0)
+		, mCount(0)
+		, mDropped(0)
+		, mClosed(false)
+	{
+	}
+
+	//Only valid while the queue is empty (i.e. before the stages are started)
+	void setCapacity(std::size_t capacity)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mItems.assign(capacity > 0 ? capacity : 1, T());
+		mHead = 0;
+		mCount = 0;
+	}
+
+	//Returns true if the oldest item was evicted to make room, it is then returned in dropped
+	bool push(const T & item, T & dropped)
+	{
+		bool didDrop = false;
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mCount == mItems.size())
+			{
+				dropped = mItems[mHead];
+				mHead = (mHead + 1) % mItems.size();
+				mCount--;
+				mDropped++;
+				didDrop = true;
+			}
+			mItems[(mHead + mCount) % mItems.size()] = item;
+			mCount++;
+		}
+		mCondition.notify_one();
+		return didDrop;
+	}
+
+	//Waits up to timeout seconds for an item, returns false on timeout or if the queue is closed
+	bool pop(T & item, double timeout)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		if (!mCondition.wait_for(lock, std::chrono::duration<double>(timeout), [this] { return mCount > 0 || mClosed; }))
+			return false;
+		return popLocked(item);
+	}
+
+	bool tryPop(T & item)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return popLocked(item);
+	}
+
+	//Wakes up any waiting consumer, remaining items can still be drained with tryPop
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mClosed = true;
+		}
+		mCondition.notify_all();
+	}
+
+	void reopen()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mClosed = false;
+	}
+
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mCount;
+	}
+
+	std::size_t capacity() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mItems.size();
+	}
+
+	std::size_t getNumberOfDropped() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mDropped;
+	}
+
+private:
+	bool popLocked(T & item)
+	{
+		if (mCount == 0)
+			return false;
+
+		item = mItems[mHead];
+		mItems[mHead] = T();
+		mHead = (mHead + 1) % mItems.size();
+		mCount--;
+		return true;
+	}
+
+	std::vector<T> mItems;
+	std::size_t mHead;
+	std::size_t mCount;
+	std::size_t mDropped;
+	bool mClosed;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mCondition;
+};
+
+#endif
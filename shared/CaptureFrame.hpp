@@ -0,0 +1,187 @@
+#ifndef __CAPTURE_FRAME_
+#define __CAPTURE_FRAME_
+
+#include <stdint.h>
+#include <string.h>
+#include <cstddef>
+#include <memory>
+
+//Row order of a frame in memory.
+//Frames are uploaded as is and the orientation travels with them,
+//shaders flip in UV space and luminance sources in row order.
+enum FrameOrientation
+{
+	FRAME_TOP_DOWN = 0, //first row in memory is the top of the image (ffmpeg)
+	FRAME_BOTTOM_UP //first row in memory is the bottom of the image (DIBs, OpenGL textures)
+};
+
+inline FrameOrientation flipOrientation(FrameOrientation orientation)
+{
+	return orientation == FRAME_TOP_DOWN ? FRAME_BOTTOM_UP : FRAME_TOP_DOWN;
+}
+
+//A texture whose first row is the top of the image has to be sampled with flipped v
+inline bool needsVerticalFlip(FrameOrientation orientation)
+{
+	return orientation == FRAME_TOP_DOWN;
+}
+
+//Pixel layouts delivered by the capture classes
+enum FramePixelFormat
+{
+	FRAME_FORMAT_UNKNOWN = 0,
+	FRAME_FORMAT_BGR24,
+	FRAME_FORMAT_RGB24,
+	FRAME_FORMAT_BGRA,
+	FRAME_FORMAT_GREY,
+	FRAME_FORMAT_RGB565,
+	FRAME_FORMAT_YUYV422,
+	FRAME_FORMAT_UYVY422,
+	FRAME_FORMAT_NV12, //Y plane + interleaved UV plane
+	FRAME_FORMAT_YUV420P //Y, U and V planes
+};
+
+inline const char * getFramePixelFormatName(FramePixelFormat format)
+{
+	switch (format)
+	{
+	case FRAME_FORMAT_BGR24: return "bgr24";
+	case FRAME_FORMAT_RGB24: return "rgb24";
+	case FRAME_FORMAT_BGRA: return "bgra";
+	case FRAME_FORMAT_GREY: return "gray";
+	case FRAME_FORMAT_RGB565: return "rgb565";
+	case FRAME_FORMAT_YUYV422: return "yuyv422";
+	case FRAME_FORMAT_UYVY422: return "uyvy422";
+	case FRAME_FORMAT_NV12: return "nv12";
+	case FRAME_FORMAT_YUV420P: return "yuv420p";
+	default: return "unknown";
+	}
+}
+
+inline int getFramePlaneCount(FramePixelFormat format)
+{
+	switch (format)
+	{
+	case FRAME_FORMAT_UNKNOWN: return 0;
+	case FRAME_FORMAT_NV12: return 2;
+	case FRAME_FORMAT_YUV420P: return 3;
+	default: return 1;
+	}
+}
+
+//bytes of pixel data in one row of a plane, without padding
+inline int getFramePlaneRowBytes(FramePixelFormat format, int plane, int width)
+{
+	switch (format)
+	{
+	case FRAME_FORMAT_BGR24:
+	case FRAME_FORMAT_RGB24: return plane == 0 ? width * 3 : 0;
+	case FRAME_FORMAT_BGRA: return plane == 0 ? width * 4 : 0;
+	case FRAME_FORMAT_GREY: return plane == 0 ? width : 0;
+	case FRAME_FORMAT_RGB565:
+	case FRAME_FORMAT_YUYV422:
+	case FRAME_FORMAT_UYVY422: return plane == 0 ? width * 2 : 0;
+	case FRAME_FORMAT_NV12: return plane == 0 ? width : (plane == 1 ? ((width + 1) & ~1) : 0);
+	case FRAME_FORMAT_YUV420P: return plane == 0 ? width : (plane < 3 ? (width + 1) / 2 : 0);
+	default: return 0;
+	}
+}
+
+inline int getFramePlaneHeight(FramePixelFormat format, int plane, int height)
+{
+	if (plane >= getFramePlaneCount(format))
+		return 0;
+	//4:2:0 chroma planes have half the rows
+	return plane > 0 ? (height + 1) / 2 : height;
+}
+
+//size of a frame with unpadded rows
+inline std::size_t getFrameDataSize(FramePixelFormat format, int width, int height)
+{
+	std::size_t size = 0;
+	for (int p = 0; p < getFramePlaneCount(format); p++)
+		size += static_cast<std::size_t>(getFramePlaneRowBytes(format, p, width)) * getFramePlaneHeight(format, p, height);
+	return size;
+}
+
+//Description of a captured frame, shared by all capture classes and upload functions.
+//Planes may be padded (linesizes). A view with an owner keeps the memory alive
+//as long as a copy of it exists, views without one are only valid during the callback.
+struct FrameView
+{
+	FrameView() : width(0), height(0), format(FRAME_FORMAT_UNKNOWN), orientation(FRAME_TOP_DOWN),
+		timestamp(0.0), pts(INT64_MIN), sequence(0), texture(0)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			planes[i] = nullptr;
+			linesizes[i] = 0;
+		}
+	}
+
+	bool isOwned() const
+	{
+		return owner != nullptr;
+	}
+
+	int getPlaneCount() const
+	{
+		return getFramePlaneCount(format);
+	}
+
+	//true if the rows of a plane follow each other without padding
+	bool isPacked(int plane) const
+	{
+		return linesizes[plane] == getFramePlaneRowBytes(format, plane, width);
+	}
+
+	std::size_t getDataSize() const
+	{
+		return getFrameDataSize(format, width, height);
+	}
+
+	//Copies all planes unpadded into dst (getDataSize() bytes), one memcpy per packed plane
+	void copyTo(uint8_t * dst) const
+	{
+		for (int p = 0; p < getPlaneCount(); p++)
+		{
+			int rowBytes = getFramePlaneRowBytes(format, p, width);
+			int rows = getFramePlaneHeight(format, p, height);
+			if (isPacked(p))
+			{
+				memcpy(dst, planes[p], static_cast<std::size_t>(rowBytes) * rows);
+			}
+			else
+			{
+				for (int y = 0; y < rows; y++)
+					memcpy(dst + static_cast<std::size_t>(y) * rowBytes, planes[p] + static_cast<std::ptrdiff_t>(y) * linesizes[p], rowBytes);
+			}
+			dst += static_cast<std::size_t>(rowBytes) * rows;
+		}
+	}
+
+	//Points the planes at an unpadded layout starting at data
+	void setPackedPlanes(uint8_t * data)
+	{
+		for (int p = 0; p < 4; p++)
+		{
+			planes[p] = p < getPlaneCount() ? data : nullptr;
+			linesizes[p] = getFramePlaneRowBytes(format, p, width);
+			data += static_cast<std::size_t>(linesizes[p]) * getFramePlaneHeight(format, p, height);
+		}
+	}
+
+	uint8_t * planes[4];
+	int linesizes[4];
+	int width;
+	int height;
+	FramePixelFormat format;
+	FrameOrientation orientation;
+	double timestamp; //capture time in seconds (engine clock)
+	int64_t pts; //source time stamp, INT64_MIN if unknown
+	uint64_t sequence; //increases by one for every frame delivered by a capture
+	unsigned int texture; //GL texture if the frame is on the GPU, the planes are empty then
+	std::shared_ptr<const void> owner; //keeps the planes alive
+};
+
+#endif
@@ -0,0 +1,676 @@
+#include "CaptureTextureRing.hpp"
+#include <string.h>
+
+namespace
+{
+	const int TileSize = 64;
+	//above this share of changed tiles the whole frame is uploaded in one call
+	const double FullUploadTileRatio = 0.5;
+}
+
+CaptureTextureRing::CaptureTextureRing()
+{
+	mWidth = 0;
+	mHeight = 0;
+	mFormat = FRAME_FORMAT_UNKNOWN;
+	mTileUpload = false;
+	mRetainSlots = 0;
+	mTilesX = 0;
+	mTilesY = 0;
+
+	mLatestSlot = -1;
+	mReadingSlot = -1;
+	mWritingSlot = -1;
+	mHoldBack = false;
+	mAcquiredOrientation = FRAME_BOTTOM_UP;
+
+	mInited = false;
+	mUploadedFrames = 0;
+	mLastDirtyTiles = 0;
+	mLastUploadBytes = 0;
+	mAverageUploadBytes = 0.0;
+	mFenceWaits = 0;
+	mFenceWaitTime = 0.0;
+}
+
+CaptureTextureRing::~CaptureTextureRing()
+{
+}
+
+bool CaptureTextureRing::init(int width, int height, FramePixelFormat format, std::size_t slotCount, std::function<GLuint()> allocateTexture)
+{
+	//a rebuilt ring releases the textures, buffers and conversion pass of the previous one,
+	//retained textures are freed as well so they have to be released before
+	cleanup();
+
+	if (width * height <= 0)
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Invalid capture ring size (%dx%d)!\n", width, height);
+		return false;
+	}
+
+	GLenum glFormat, glType;
+	bool convertOnGPU = YUVConversionPass::isSupported(format, width);
+	if (!convertOnGPU && !PersistentUploadBuffer::getTextureFormat(format, glFormat, glType))
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Capture ring can't upload %s frames!\n", getFramePixelFormatName(format));
+		return false;
+	}
+
+	//one slot shown, one latest and at least one to write into
+	if (slotCount < 3)
+		slotCount = 3;
+
+	mWidth = width;
+	mHeight = height;
+	mFormat = format;
+
+	if (convertOnGPU && !mYUVPass.init(width, height, format))
+		return false;
+
+	if (!mUploadBuffer.init(getFrameDataSize(format, width, height), slotCount))
+	{
+		mYUVPass.cleanup();
+		return false;
+	}
+
+	//retained slots are never written, the upload memory is only for the others
+	mSlots.resize(slotCount + mRetainSlots);
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		mSlots[i].texture = allocateTexture();
+		mSlots[i].orientation = FRAME_BOTTOM_UP;
+		mSlots[i].uploadFence = 0;
+		mSlots[i].readFence = 0;
+		mSlots[i].tileSignatures.clear();
+		mSlots[i].sequence = 0;
+		mSlots[i].pending = false;
+		mSlots[i].retained = 0;
+	}
+	FrameSignature::getTileCount(width, height, TileSize, mTilesX, mTilesY);
+
+	mLatestSlot = -1;
+	mReadingSlot = -1;
+	mWritingSlot = -1;
+	mUploadedFrames = 0;
+	mLastDirtyTiles = 0;
+	mLastUploadBytes = 0;
+	mAverageUploadBytes = 0.0;
+	mFenceWaits = 0;
+	mFenceWaitTime = 0.0;
+	mInited = true;
+
+	sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Capture ring with %u slots, %u for frozen frames (%dx%d)%s\n", static_cast<unsigned int>(mSlots.size()),
+		static_cast<unsigned int>(mRetainSlots), width, height, mTileUpload && !convertOnGPU ? ", tile upload" : "");
+
+	return true;
+}
+
+void CaptureTextureRing::cleanup()
+{
+	mInited = false;
+
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		deleteFence(mSlots[i].uploadFence);
+		deleteFence(mSlots[i].readFence);
+
+		if (mSlots[i].texture)
+			glDeleteTextures(1, &mSlots[i].texture);
+	}
+	mSlots.clear();
+	mUploadBuffer.cleanup();
+	mYUVPass.cleanup();
+
+	mLatestSlot = -1;
+	mReadingSlot = -1;
+	mWritingSlot = -1;
+}
+
+bool CaptureTextureRing::isInited() const
+{
+	return mInited;
+}
+
+void CaptureTextureRing::setTileUpload(bool enabled)
+{
+	mTileUpload = enabled;
+}
+
+bool CaptureTextureRing::isTileUploadEnabled() const
+{
+	return mTileUpload;
+}
+
+bool CaptureTextureRing::isTileUploadActive() const
+{
+	return mTileUpload && !mYUVPass.isInited() && getFramePlaneCount(mFormat) == 1;
+}
+
+void CaptureTextureRing::setRetainSlots(std::size_t count)
+{
+	mRetainSlots = count;
+}
+
+bool CaptureTextureRing::write(const FrameView & frame)
+{
+	if (frame.width != mWidth || frame.height != mHeight || frame.format != mFormat)
+		return false;
+
+	//the gpu conversion needs all planes
+	if (mTileUpload && !mYUVPass.isInited() && frame.getPlaneCount() == 1)
+		return writeTiles(frame);
+
+	unsigned char * ptr = acquireWriteSlot();
+	if (!ptr)
+		return false;
+
+	//single copy per plane unless the source rows are padded
+	frame.copyTo(ptr);
+	endWrite(frame);
+	return true;
+}
+
+bool CaptureTextureRing::writeTiles(const FrameView & frame)
+{
+	//signatures are taken before waiting for a slot
+	if (!FrameSignature::computeTiles(frame, TileSize, mFrameTiles, FrameConverter::getBestLevel()))
+		return false;
+
+	unsigned char * ptr = acquireWriteSlot();
+	if (!ptr)
+		return false;
+
+	Slot & slot = mSlots[mWritingSlot];
+	slot.orientation = frame.orientation;
+
+	//changed tiles are packed one rectangle after the other
+	std::size_t dirtyTiles = collectDirtyRects(slot);
+	int bytesPerPixel = getFramePlaneRowBytes(mFormat, 0, mWidth) / mWidth;
+	std::size_t uploadBytes = 0;
+	for (std::size_t i = 0; i < mDirtyRects.size(); i++)
+	{
+		TileRect & rect = mDirtyRects[i];
+		rect.offset = uploadBytes;
+		int rowBytes = rect.width * bytesPerPixel;
+		for (int y = 0; y < rect.height; y++)
+		{
+			const uint8_t * src = frame.planes[0] + static_cast<std::ptrdiff_t>(rect.y + y) * frame.linesizes[0] + rect.x * bytesPerPixel;
+			memcpy(ptr + uploadBytes, src, rowBytes);
+			uploadBytes += rowBytes;
+		}
+	}
+
+	GLenum format, type;
+	PersistentUploadBuffer::getTextureFormat(mFormat, format, type);
+	mUploadBuffer.upload([&](const unsigned char * data) {
+		if (mDirtyRects.empty())
+			return;
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, slot.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (std::size_t i = 0; i < mDirtyRects.size(); i++)
+		{
+			const TileRect & rect = mDirtyRects[i];
+			glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.width, rect.height, format, type, data + rect.offset);
+		}
+	});
+
+	slot.tileSignatures = mFrameTiles;
+	mLastDirtyTiles = dirtyTiles;
+	publishWrittenSlot(frame.sequence, uploadBytes);
+	return true;
+}
+
+std::size_t CaptureTextureRing::collectDirtyRects(const Slot & slot)
+{
+	mDirtyRects.clear();
+
+	std::size_t tileCount = mFrameTiles.size();
+	std::size_t dirtyTiles = tileCount;
+	if (slot.tileSignatures.size() == tileCount)
+	{
+		dirtyTiles = 0;
+		for (std::size_t i = 0; i < tileCount; i++)
+		{
+			if (slot.tileSignatures[i] != mFrameTiles[i])
+				dirtyTiles++;
+		}
+	}
+
+	//many small uploads cost more than one large one
+	if (dirtyTiles > FullUploadTileRatio * tileCount)
+	{
+		TileRect rect = { 0, 0, mWidth, mHeight, 0 };
+		mDirtyRects.push_back(rect);
+		return dirtyTiles;
+	}
+
+	//runs of changed tiles in a tile row, extended downwards while the next row has the same run
+	//(rectangles are in tiles until the end)
+	std::size_t firstOpen = 0;
+	for (int ty = 0; ty < mTilesY; ty++)
+	{
+		std::size_t rowStart = mDirtyRects.size();
+		int tx = 0;
+		while (tx < mTilesX)
+		{
+			if (slot.tileSignatures[ty * mTilesX + tx] == mFrameTiles[ty * mTilesX + tx])
+			{
+				tx++;
+				continue;
+			}
+
+			int runStart = tx;
+			while (tx < mTilesX && slot.tileSignatures[ty * mTilesX + tx] != mFrameTiles[ty * mTilesX + tx])
+				tx++;
+
+			bool extended = false;
+			for (std::size_t i = firstOpen; i < rowStart && !extended; i++)
+			{
+				TileRect & open = mDirtyRects[i];
+				if (open.x == runStart && open.width == tx - runStart && open.y + open.height == ty)
+				{
+					open.height++;
+					extended = true;
+				}
+			}
+
+			if (!extended)
+			{
+				TileRect rect = { runStart, ty, tx - runStart, 1, 0 };
+				mDirtyRects.push_back(rect);
+			}
+		}
+
+		//only rectangles reaching this row can grow further
+		while (firstOpen < mDirtyRects.size() && mDirtyRects[firstOpen].y + mDirtyRects[firstOpen].height < ty + 1)
+			firstOpen++;
+	}
+
+	for (std::size_t i = 0; i < mDirtyRects.size(); i++)
+	{
+		TileRect & rect = mDirtyRects[i];
+		int right = (rect.x + rect.width) * TileSize < mWidth ? (rect.x + rect.width) * TileSize : mWidth;
+		int bottom = (rect.y + rect.height) * TileSize < mHeight ? (rect.y + rect.height) * TileSize : mHeight;
+		rect.x *= TileSize;
+		rect.y *= TileSize;
+		rect.width = right - rect.x;
+		rect.height = bottom - rect.y;
+	}
+
+	return dirtyTiles;
+}
+
+bool CaptureTextureRing::beginWrite(FrameView & destination)
+{
+	if (destination.width != mWidth || destination.height != mHeight || destination.format != mFormat)
+		return false;
+
+	unsigned char * ptr = acquireWriteSlot();
+	if (!ptr)
+		return false;
+
+	destination.setPackedPlanes(ptr);
+	return true;
+}
+
+unsigned char * CaptureTextureRing::acquireWriteSlot()
+{
+	if (!mInited)
+		return nullptr;
+
+	GLsync readFence = 0;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		//pick the next slot which is neither shown nor the latest,
+		//pending slots are kept as their frames may still be published and retained ones as they are frozen
+		int slotCount = static_cast<int>(mSlots.size());
+		int slot = -1;
+		for (int i = 1; i <= slotCount; i++)
+		{
+			int candidate = (mWritingSlot + i + slotCount) % slotCount;
+			if (candidate != mLatestSlot && candidate != mReadingSlot && !mSlots[candidate].pending && mSlots[candidate].retained == 0)
+			{
+				slot = candidate;
+				break;
+			}
+		}
+
+		if (slot < 0)
+			return nullptr;
+
+		mWritingSlot = slot;
+		readFence = mSlots[slot].readFence;
+		mSlots[slot].readFence = 0;
+	}
+
+	//make sure the GPU is done drawing with the slot before we overwrite it
+	if (readFence)
+	{
+		GLenum status = glClientWaitSync(readFence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			double waitStart = sgct::Engine::getTime();
+			mFenceWaits++;
+			do
+			{
+				status = glClientWaitSync(readFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1 ms
+			} while (status == GL_TIMEOUT_EXPIRED && mInited);
+			mFenceWaitTime = mFenceWaitTime + (sgct::Engine::getTime() - waitStart);
+		}
+		glDeleteSync(readFence);
+	}
+
+	deleteFence(mSlots[mWritingSlot].uploadFence);
+
+	return mUploadBuffer.beginWrite();
+}
+
+void CaptureTextureRing::endWrite(const FrameView & frame)
+{
+	if (mWritingSlot < 0)
+		return;
+
+	Slot & slot = mSlots[mWritingSlot];
+	slot.orientation = frame.orientation;
+	//written without signatures
+	slot.tileSignatures.clear();
+
+	if (mYUVPass.isInited())
+	{
+		//planes first, then one draw into the slot
+		mUploadBuffer.upload([this](const unsigned char * data) {
+			mYUVPass.uploadPlanes(data);
+		});
+		mYUVPass.convert(slot.texture);
+	}
+	else
+	{
+		GLenum format, type;
+		PersistentUploadBuffer::getTextureFormat(mFormat, format, type);
+		mUploadBuffer.upload(slot.texture, mWidth, mHeight, format, type);
+	}
+
+	mLastDirtyTiles = getTileCount();
+	publishWrittenSlot(frame.sequence, getFrameDataSize(mFormat, mWidth, mHeight));
+}
+
+void CaptureTextureRing::publishWrittenSlot(uint64_t sequence, std::size_t uploadBytes)
+{
+	//other contexts only see the fence once it has been flushed
+	mSlots[mWritingSlot].uploadFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	std::size_t count = ++mUploadedFrames;
+	mLastUploadBytes = uploadBytes;
+	mAverageUploadBytes = mAverageUploadBytes + (static_cast<double>(uploadBytes) - mAverageUploadBytes) / static_cast<double>(count);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	Slot & slot = mSlots[mWritingSlot];
+	slot.sequence = sequence;
+	slot.pending = mHoldBack;
+	if (!mHoldBack)
+		mLatestSlot = mWritingSlot;
+}
+
+void CaptureTextureRing::cancelWrite()
+{
+	if (mWritingSlot < 0)
+		return;
+
+	//the slot is simply not published, the latest frame stays the same
+	mUploadBuffer.cancelWrite();
+}
+
+GLuint CaptureTextureRing::getLatestTexture()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mLatestSlot >= 0 ? mSlots[mLatestSlot].texture : 0;
+}
+
+FrameOrientation CaptureTextureRing::getLatestOrientation()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mLatestSlot >= 0 ? mSlots[mLatestSlot].orientation : FRAME_BOTTOM_UP;
+}
+
+GLuint CaptureTextureRing::acquireLatest()
+{
+	if (!mInited)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mLatestSlot < 0)
+		return 0;
+
+	mReadingSlot = mLatestSlot;
+
+	//server side wait, the render thread is not blocked
+	Slot & slot = mSlots[mReadingSlot];
+	mAcquiredOrientation = slot.orientation;
+	if (slot.uploadFence)
+		glWaitSync(slot.uploadFence, 0, GL_TIMEOUT_IGNORED);
+
+	return slot.texture;
+}
+
+FrameOrientation CaptureTextureRing::getAcquiredOrientation() const
+{
+	return mAcquiredOrientation;
+}
+
+void CaptureTextureRing::releaseRead()
+{
+	if (!mInited)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mReadingSlot < 0)
+		return;
+
+	Slot & slot = mSlots[mReadingSlot];
+	deleteFence(slot.readFence);
+	slot.readFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	mReadingSlot = -1;
+}
+
+GLuint CaptureTextureRing::retainLatest(FrameOrientation & orientation)
+{
+	if (!mInited)
+		return 0;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mLatestSlot < 0)
+		return 0;
+
+	//planes frozen at the same time share the slot
+	Slot & slot = mSlots[mLatestSlot];
+	if (slot.retained == 0 && countRetainedSlots() >= mRetainSlots)
+		return 0;
+
+	slot.retained++;
+	if (slot.uploadFence)
+		glWaitSync(slot.uploadFence, 0, GL_TIMEOUT_IGNORED);
+	orientation = slot.orientation;
+	return slot.texture;
+}
+
+void CaptureTextureRing::release(GLuint texture)
+{
+	if (!mInited || !texture)
+		return;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		Slot & slot = mSlots[i];
+		if (slot.texture != texture || slot.retained == 0)
+			continue;
+
+		//the frames drawn so far may still read the slot
+		if (--slot.retained == 0)
+		{
+			deleteFence(slot.readFence);
+			slot.readFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		return;
+	}
+}
+
+std::size_t CaptureTextureRing::countRetainedSlots() const
+{
+	std::size_t count = 0;
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		if (mSlots[i].retained > 0)
+			count++;
+	}
+	return count;
+}
+
+void CaptureTextureRing::setHoldBack(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mHoldBack && !enabled)
+	{
+		int newestPending = -1;
+		for (int i = 0; i < static_cast<int>(mSlots.size()); i++)
+		{
+			if (mSlots[i].pending && (newestPending < 0 || mSlots[i].sequence > mSlots[newestPending].sequence))
+				newestPending = i;
+			mSlots[i].pending = false;
+		}
+
+		if (newestPending >= 0)
+			mLatestSlot = newestPending;
+	}
+	mHoldBack = enabled;
+}
+
+bool CaptureTextureRing::isHoldingBack()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mHoldBack;
+}
+
+bool CaptureTextureRing::publish(uint64_t sequence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	int published = -1;
+	for (int i = 0; i < static_cast<int>(mSlots.size()); i++)
+	{
+		if (mSlots[i].pending && mSlots[i].sequence == sequence)
+			published = i;
+	}
+
+	//the slot was written over by a newer frame
+	if (published < 0)
+		return false;
+
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		if (mSlots[i].pending && mSlots[i].sequence <= sequence)
+			mSlots[i].pending = false;
+	}
+	mLatestSlot = published;
+	return true;
+}
+
+void CaptureTextureRing::dropPending(uint64_t sequence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		if (mSlots[i].pending && mSlots[i].sequence <= sequence)
+			mSlots[i].pending = false;
+	}
+}
+
+void CaptureTextureRing::discardPending(uint64_t sequence)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	for (std::size_t i = 0; i < mSlots.size(); i++)
+	{
+		if (mSlots[i].pending && mSlots[i].sequence == sequence)
+			mSlots[i].pending = false;
+	}
+}
+
+FramePixelFormat CaptureTextureRing::getFormat() const
+{
+	return mFormat;
+}
+
+std::size_t CaptureTextureRing::getSlotCount() const
+{
+	return mSlots.size();
+}
+
+std::size_t CaptureTextureRing::getRetainSlotCount() const
+{
+	return mRetainSlots;
+}
+
+std::size_t CaptureTextureRing::getNumberOfRetainedSlots()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return countRetainedSlots();
+}
+
+bool CaptureTextureRing::isPersistentlyMapped() const
+{
+	return mUploadBuffer.isPersistent();
+}
+
+bool CaptureTextureRing::isConvertingOnGPU() const
+{
+	return mYUVPass.isInited();
+}
+
+std::size_t CaptureTextureRing::getTileCount() const
+{
+	return static_cast<std::size_t>(mTilesX) * mTilesY;
+}
+
+std::size_t CaptureTextureRing::getLastDirtyTiles() const
+{
+	return mLastDirtyTiles;
+}
+
+std::size_t CaptureTextureRing::getLastUploadBytes() const
+{
+	return mLastUploadBytes;
+}
+
+double CaptureTextureRing::getAverageUploadBytes() const
+{
+	return mAverageUploadBytes;
+}
+
+std::size_t CaptureTextureRing::getNumberOfUploadedFrames() const
+{
+	return mUploadedFrames;
+}
+
+std::size_t CaptureTextureRing::getNumberOfFenceWaits() const
+{
+	return mFenceWaits + mUploadBuffer.getNumberOfFenceWaits();
+}
+
+double CaptureTextureRing::getFenceWaitTime() const
+{
+	return mFenceWaitTime + mUploadBuffer.getFenceWaitTime();
+}
+
+void CaptureTextureRing::deleteFence(GLsync & fence)
+{
+	if (fence)
+	{
+		glDeleteSync(fence);
+		fence = 0;
+	}
+}
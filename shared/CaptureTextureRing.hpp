@@ -0,0 +1,141 @@
+#ifndef __CAPTURE_TEXTURE_RING_
+#define __CAPTURE_TEXTURE_RING_
+
+#include <sgct.h>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include "PersistentUploadBuffer.hpp"
+#include "YUVConversionPass.hpp"
+#include "FrameSignature.hpp"
+#include "CaptureFrame.hpp"
+
+//N-deep ring of textures for capture uploads, fed from a persistent mapped upload buffer.
+//The capture thread writes into a slot that is neither shown nor the latest one,
+//the render thread binds the latest complete slot for the whole frame.
+//Uploads and reads are fenced, so no slot is written while the GPU still uses it.
+//YUV frames are uploaded as planes and converted into the rgb slot texture on the GPU.
+//With tile upload, write() only copies and uploads the 64x64 tiles that differ from what the slot holds.
+//With hold back, written slots stay pending until the render thread publishes or drops them by frame sequence
+//(used to show only frames a QR scan found clean, while the upload keeps running at full rate).
+//Frozen planes retain the latest slot instead of copying it, a retained slot is not written until it is released.
+//The retain slots are extra, so the upload keeps its slot count whatever is frozen.
+class CaptureTextureRing
+{
+public:
+	CaptureTextureRing();
+	~CaptureTextureRing();
+
+	//cleans up a previous ring first, release all retained textures before
+	bool init(int width, int height, FramePixelFormat format, std::size_t slotCount, std::function<GLuint()> allocateTexture);
+	void setTileUpload(bool enabled); //before init
+	void setRetainSlots(std::size_t count); //before init, how many distinct frames can be retained at once
+	bool isTileUploadEnabled() const;
+	bool isTileUploadActive() const; //enabled and used for the format of the ring (single plane, converted on the cpu)
+	void cleanup();
+	bool isInited() const;
+
+	//capture thread (with a context shared with the render context)
+	bool write(const FrameView & frame);
+	bool beginWrite(FrameView & destination); //points the planes of destination into the upload memory
+	void endWrite(const FrameView & frame);
+	void cancelWrite();
+	GLuint getLatestTexture();
+	FrameOrientation getLatestOrientation();
+
+	//render thread, once per frame
+	GLuint acquireLatest();
+	FrameOrientation getAcquiredOrientation() const;
+	void releaseRead();
+
+	//render thread, keeps the latest frame, 0 if there is none or all retain slots are in use.
+	//Each retain is released once, the texture stays valid and unchanged until then
+	GLuint retainLatest(FrameOrientation & orientation);
+	void release(GLuint texture);
+
+	//render thread, turning hold back off publishes the newest pending slot
+	void setHoldBack(bool enabled);
+	bool isHoldingBack();
+	//publishes the pending slot with this frame sequence, older pending slots are dropped
+	bool publish(uint64_t sequence);
+	//drops the pending slot with this frame sequence and all older ones
+	void dropPending(uint64_t sequence);
+	//any thread, drops only the pending slot with this frame sequence (a frame that will never be scanned)
+	void discardPending(uint64_t sequence);
+
+	FramePixelFormat getFormat() const;
+
+	std::size_t getSlotCount() const;
+	std::size_t getRetainSlotCount() const;
+	std::size_t getNumberOfRetainedSlots();
+	bool isPersistentlyMapped() const;
+	bool isConvertingOnGPU() const;
+	std::size_t getTileCount() const;
+	std::size_t getLastDirtyTiles() const;
+	std::size_t getLastUploadBytes() const;
+	double getAverageUploadBytes() const;
+	std::size_t getNumberOfUploadedFrames() const;
+	std::size_t getNumberOfFenceWaits() const;
+	double getFenceWaitTime() const;
+
+private:
+	struct Slot
+	{
+		GLuint texture;
+		FrameOrientation orientation;
+		GLsync uploadFence;
+		GLsync readFence;
+		std::vector<uint64_t> tileSignatures; //of the content, empty if unknown
+		uint64_t sequence; //of the frame in the slot
+		bool pending; //written but held back
+		int retained; //references of frozen planes
+	};
+
+	//pixel rectangle of coalesced tiles and where it is in the upload range
+	struct TileRect
+	{
+		int x;
+		int y;
+		int width;
+		int height;
+		std::size_t offset;
+	};
+
+	unsigned char * acquireWriteSlot();
+	bool writeTiles(const FrameView & frame);
+	std::size_t collectDirtyRects(const Slot & slot);
+	std::size_t countRetainedSlots() const; //with the mutex held
+	void publishWrittenSlot(uint64_t sequence, std::size_t uploadBytes);
+	void deleteFence(GLsync & fence);
+
+	std::vector<Slot> mSlots;
+	PersistentUploadBuffer mUploadBuffer;
+	bool mTileUpload;
+	std::size_t mRetainSlots;
+	int mTilesX;
+	int mTilesY;
+	std::vector<uint64_t> mFrameTiles;
+	std::vector<TileRect> mDirtyRects;
+	YUVConversionPass mYUVPass;
+	int mWidth;
+	int mHeight;
+	FramePixelFormat mFormat;
+
+	int mLatestSlot;
+	int mReadingSlot;
+	int mWritingSlot;
+	bool mHoldBack;
+	FrameOrientation mAcquiredOrientation;
+	std::mutex mMutex;
+
+	std::atomic<bool> mInited;
+	std::atomic<std::size_t> mUploadedFrames;
+	std::atomic<std::size_t> mLastDirtyTiles;
+	std::atomic<std::size_t> mLastUploadBytes;
+	std::atomic<double> mAverageUploadBytes;
+	std::atomic<std::size_t> mFenceWaits;
+	std::atomic<double> mFenceWaitTime;
+};
+
+#endif
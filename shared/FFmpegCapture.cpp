@@ -8,6 +8,7 @@ extern "C"
 #endif
 #include <libavdevice/avdevice.h>
 #include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
 }
 
 #define USE_REF_COUNTER 1
@@ -19,6 +20,14 @@ extern "C"
 	AV_ERROR_MAX_STRING_SIZE, errnum)
 #endif
 
+namespace
+{
+	//a failing device is retried less and less often, up to this wait in seconds
+	const double MaxReadRetryDelay = 0.25;
+	//read errors are logged at most this often in seconds
+	const double ReadErrorLogInterval = 10.0;
+}
+
 FFmpegCapture::FFmpegCapture()
 {
 	mOptions = nullptr;
@@ -27,19 +36,52 @@ FFmpegCapture::FFmpegCapture()
     mVideoDevice = "";
 	mVideoStream = nullptr;
 	mVideoCodecContext = nullptr;
-	mVideoScaleContext = nullptr;
-	mFrame = nullptr;
-	mTempFrame = nullptr;
-	mVideoDecoderCallback = nullptr;
+	mConvertedFramePool = nullptr;
+	mVideoFrameCallback = nullptr;
+	mVideoDestinationCallback = nullptr;
+	mVideoWrittenCallback = nullptr;
 
 	mWidth = 0;
 	mHeight = 0;
 	mVideo_stream_idx = -1;
 	mDecodedVideoFrames = 0;
+	mFrameSequence = 0;
+
+	mQueueDepth = 4;
+	mPacketQueue.setCapacity(mQueueDepth);
+	mFrameQueue.setCapacity(mQueueDepth);
+	mDemuxThread = nullptr;
+	mDecodeThread = nullptr;
+	mPipelineRunning = false;
+	mAbortRequested = false;
+
+	mTargetRate = 0.0;
+	mNextDeliveryTime = 0.0;
+	mPacedFrames = 0;
+	mDeliveredFrames = 0;
+	mLastDeliveryLatency = 0.0;
+	mAverageDeliveryLatency = 0.0;
+	mMaxDeliveryLatency = 0.0;
 
 	mDstPixFmt = AV_PIX_FMT_BGR24;
+	mDstPixFmtForced = false;
+	mForceSwscale = false;
+	mConversionLevel = FrameConverter::getBestLevel();
+	mConversionThreads = 1;
+	mLastConversionTime = 0.0;
+	mAverageConversionTime = 0.0;
+	mConvertedFrames = 0;
 	mInited = false;
 
+	mSkipUnchanged = true;
+	mUnchangedRefreshInterval = 1.0;
+	mLastSignature = 0;
+	mHasLastSignature = false;
+	mLastSignatureTime = 0.0;
+	mSignedFrames = 0;
+	mUnchangedFrames = 0;
+	mAverageSignatureTime = 0.0;
+
 	mFormatYUVY422 = false;
 	mFormatBGR24 = false;
 }
@@ -64,6 +106,17 @@ int FFmpegCapture::getHeight() const
 	return mHeight;
 }
 
+FrameOrientation FFmpegCapture::getOrientation() const
+{
+	//decoded frames are always top-down
+	return FRAME_TOP_DOWN;
+}
+
+FramePixelFormat FFmpegCapture::getFramePixelFormat() const
+{
+	return SliceConverter::toFramePixelFormat(mDstPixFmt);
+}
+
 const char * FFmpegCapture::getFormat() const
 {
 	return mVideoDstFormat.c_str();
@@ -79,11 +132,121 @@ int FFmpegCapture::isFormatBGR24() const
 	return mFormatBGR24;
 }
 
+const char * FFmpegCapture::getConversionName() const
+{
+	return mConverter.isInited() ? mConverter.getName() : "none";
+}
+
+std::size_t FFmpegCapture::getConversionThreads() const
+{
+	return mConverter.isInited() ? mConverter.getThreadCount() : 0;
+}
+
+double FFmpegCapture::getLastConversionTime() const
+{
+	return mLastConversionTime;
+}
+
+double FFmpegCapture::getAverageConversionTime() const
+{
+	return mAverageConversionTime;
+}
+
 std::size_t FFmpegCapture::getNumberOfDecodedFrames() const
 {
 	return mDecodedVideoFrames;
 }
 
+void FFmpegCapture::setSkipUnchangedFrames(bool skip)
+{
+	mSkipUnchanged = skip;
+	mHasLastSignature = false;
+}
+
+bool FFmpegCapture::isSkippingUnchangedFrames() const
+{
+	return mSkipUnchanged;
+}
+
+std::size_t FFmpegCapture::getNumberOfUnchangedFrames() const
+{
+	return mUnchangedFrames;
+}
+
+double FFmpegCapture::getAverageSignatureTime() const
+{
+	return mAverageSignatureTime;
+}
+
+void FFmpegCapture::setQueueDepth(std::size_t depth)
+{
+	if (mPipelineRunning)
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Capture queue depth can't be changed while capturing!\n");
+		return;
+	}
+
+	mQueueDepth = depth > 0 ? depth : 1;
+	mPacketQueue.setCapacity(mQueueDepth);
+	mFrameQueue.setCapacity(mQueueDepth);
+}
+
+std::size_t FFmpegCapture::getQueueDepth() const
+{
+	return mQueueDepth;
+}
+
+std::size_t FFmpegCapture::getPacketQueueSize() const
+{
+	return mPacketQueue.size();
+}
+
+std::size_t FFmpegCapture::getFrameQueueSize() const
+{
+	return mFrameQueue.size();
+}
+
+std::size_t FFmpegCapture::getNumberOfDroppedPackets() const
+{
+	return mPacketQueue.getNumberOfDropped();
+}
+
+std::size_t FFmpegCapture::getNumberOfDroppedFrames() const
+{
+	return mFrameQueue.getNumberOfDropped();
+}
+
+void FFmpegCapture::setTargetRate(double fps)
+{
+	mTargetRate = fps > 0.0 ? fps : 0.0;
+	mNextDeliveryTime = 0.0;
+}
+
+double FFmpegCapture::getTargetRate() const
+{
+	return mTargetRate;
+}
+
+std::size_t FFmpegCapture::getNumberOfPacedFrames() const
+{
+	return mPacedFrames;
+}
+
+double FFmpegCapture::getLastDeliveryLatency() const
+{
+	return mLastDeliveryLatency;
+}
+
+double FFmpegCapture::getAverageDeliveryLatency() const
+{
+	return mAverageDeliveryLatency;
+}
+
+double FFmpegCapture::getMaxDeliveryLatency() const
+{
+	return mMaxDeliveryLatency;
+}
+
 bool FFmpegCapture::init()
 {
 	if (mVideoDevice.empty())
@@ -113,6 +276,17 @@ bool FFmpegCapture::init()
 	inputName = mVideoDevice;
 #endif
 
+	//allocate the context ourselves so that a blocking read can be interrupted on shutdown
+	mFMTContext = avformat_alloc_context();
+	if (!mFMTContext)
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate capture context!\n");
+		cleanup();
+		return false;
+	}
+	mFMTContext->interrupt_callback.callback = interruptCallback;
+	mFMTContext->interrupt_callback.opaque = this;
+
 	if (avformat_open_input(&mFMTContext, inputName.c_str(), iformat, &mOptions) < 0)
 	{
 		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not open capture input!\n");
@@ -146,13 +320,12 @@ bool FFmpegCapture::init()
 		}
 	}
 
-	/* initialize packet, set data to nullptr, let the demuxer fill it */
-	av_init_packet(&mPkt);
-	mPkt.data = nullptr;
-	mPkt.size = 0;
-
 	//success
 	mInited = true;
+	mHasLastSignature = false;
+	mUnchangedFrames = 0;
+
+	startPipeline();
 
     sgct::MessageHandler::instance()->print("Capture init complete\n");
 
@@ -169,59 +342,323 @@ void FFmpegCapture::setVideoDevice(std::string videoDeviceName)
 	mVideoDevice = videoDeviceName;
 }
 
-void FFmpegCapture::setVideoDecoderCallback(std::function<void(uint8_t ** data, int width, int height)> cb)
+void FFmpegCapture::setVideoFrameCallback(std::function<void(const FrameView & frame)> cb)
 {
-	mVideoDecoderCallback = cb;
+	mVideoFrameCallback = cb;
+}
+
+void FFmpegCapture::setVideoDestinationCallbacks(std::function<bool(FrameView & destination)> acquire, std::function<void(const FrameView & frame, bool success)> written)
+{
+	mVideoDestinationCallback = acquire;
+	mVideoWrittenCallback = written;
 }
 
 void FFmpegCapture::addOption(std::pair<std::string, std::string> option)
 {
+	//options handled by the capture pipeline itself, not passed on to ffmpeg
+	if (option.first.compare("capture_queue_depth") == 0) {
+		setQueueDepth(static_cast<std::size_t>(atoi(option.second.c_str())));
+		return;
+	}
+	else if (option.first.compare("capture_target_rate") == 0) {
+		setTargetRate(atof(option.second.c_str()));
+		return;
+	}
+	else if (option.first.compare("capture_output_format") == 0) {
+		//format handed to the application, independent of what the device delivers
+		AVPixelFormat fmt = av_get_pix_fmt(option.second.c_str());
+		if (SliceConverter::toFramePixelFormat(fmt) == FRAME_FORMAT_UNKNOWN) {
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Unsupported capture output format %s!\n", option.second.c_str());
+			return;
+		}
+		mDstPixFmt = fmt;
+		mDstPixFmtForced = true;
+		return;
+	}
+	else if (option.first.compare("capture_conversion") == 0) {
+		//auto, avx2, sse4, scalar or swscale
+		mForceSwscale = option.second.compare("swscale") == 0;
+		if (!mForceSwscale && !FrameConverter::parseLevel(option.second, mConversionLevel))
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Unknown capture conversion %s!\n", option.second.c_str());
+		if (mConversionLevel > FrameConverter::getBestLevel()) {
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Conversion %s is not supported by this cpu, using %s!\n",
+				option.second.c_str(), FrameConverter::getLevelName(FrameConverter::getBestLevel()));
+			mConversionLevel = FrameConverter::getBestLevel();
+		}
+		return;
+	}
+	else if (option.first.compare("capture_skip_unchanged") == 0) {
+		setSkipUnchangedFrames(atoi(option.second.c_str()) != 0);
+		return;
+	}
+	else if (option.first.compare("capture_unchanged_refresh") == 0) {
+		//seconds, 0 = unchanged frames are never delivered
+		mUnchangedRefreshInterval = atof(option.second.c_str());
+		return;
+	}
+	else if (option.first.compare("capture_conversion_threads") == 0) {
+		//0 = up to 4 depending on the number of cores
+		int threads = atoi(option.second.c_str());
+		mConversionThreads = threads > 0 ? static_cast<std::size_t>(threads) : 0;
+		return;
+	}
+
 	mUserOptions.push_back(option);
 	if (option.first.compare("pixel_format") == 0) {
 		if (option.second.compare("yuyv422") == 0) {
-			mDstPixFmt = AV_PIX_FMT_YUYV422;
+			if (!mDstPixFmtForced)
+				mDstPixFmt = AV_PIX_FMT_YUYV422;
 			mFormatYUVY422 = true;
 		}
 		else if (option.second.compare("bgr24") == 0) {
-			mDstPixFmt = AV_PIX_FMT_BGR24;
+			if (!mDstPixFmtForced)
+				mDstPixFmt = AV_PIX_FMT_BGR24;
 			mFormatBGR24 = true;
 		}
 	}
 }
 
-bool FFmpegCapture::poll()
+bool FFmpegCapture::poll(double timeout)
 {
 	if (!mInited)
 		return false;
-	
-	int ret;
-	int gotVideoFrame;
+
+	//pace delivery to the target rate, frames arriving in between are skipped
+	if (mTargetRate > 0.0)
+	{
+		double waitTime = mNextDeliveryTime - sgct::Engine::getTime();
+		if (waitTime > 0.0)
+			sgct::Engine::sleep(waitTime);
+	}
+
+	//with a timeout we block until the decoder has a frame ready, so the caller is paced by the device
+	TimedFrame item = { nullptr, 0.0 };
+	bool gotFrame = timeout > 0.0 ? mFrameQueue.pop(item, timeout) : mFrameQueue.tryPop(item);
+	if (!gotFrame)
+		return true; //nothing decoded yet
+
+	if (mTargetRate > 0.0)
+	{
+		//only the latest frame is delivered
+		TimedFrame newer = { nullptr, 0.0 };
+		while (mFrameQueue.tryPop(newer))
+		{
+			av_frame_free(&item.frame);
+			item = newer;
+			mPacedFrames++;
+		}
+	}
 
 	bool all_ok = true;
+	if (convertFrame(item.frame, item.readTime) < 0)
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to convert frame!\n");
+		all_ok = false;
+	}
+
+	av_frame_free(&item.frame);
 
-	if (av_read_frame(mFMTContext, &mPkt) >= 0)
+	double now = sgct::Engine::getTime();
+	updateDeliveryStats(now - item.readTime);
+
+	if (mTargetRate > 0.0)
 	{
-		AVPacket orig_pkt = mPkt;
+		double period = 1.0 / mTargetRate;
+		mNextDeliveryTime = (now - mNextDeliveryTime) > period ? now + period : mNextDeliveryTime + period;
+	}
+
+	return all_ok;
+}
+
+void FFmpegCapture::updateDeliveryStats(double latency)
+{
+	//only written from the polling thread
+	std::size_t count = ++mDeliveredFrames;
+	mLastDeliveryLatency = latency;
+	mAverageDeliveryLatency = mAverageDeliveryLatency + (latency - mAverageDeliveryLatency) / static_cast<double>(count);
+	if (latency > mMaxDeliveryLatency)
+		mMaxDeliveryLatency = latency;
+}
+
+void FFmpegCapture::startPipeline()
+{
+	mAbortRequested = false;
+	mPacketQueue.reopen();
+	mFrameQueue.reopen();
+
+	mDeliveredFrames = 0;
+	mPacedFrames = 0;
+	mLastDeliveryLatency = 0.0;
+	mAverageDeliveryLatency = 0.0;
+	mMaxDeliveryLatency = 0.0;
+	mNextDeliveryTime = 0.0;
+
+	mPipelineRunning = true;
+	mDemuxThread = new (std::nothrow) std::thread(&FFmpegCapture::demuxLoop, this);
+	mDecodeThread = new (std::nothrow) std::thread(&FFmpegCapture::decodeLoop, this);
+}
+
+void FFmpegCapture::stopPipeline()
+{
+	//abort any blocking read and wake up waiting stages
+	mPipelineRunning = false;
+	mAbortRequested = true;
+	mPacketQueue.close();
+	mFrameQueue.close();
+
+	if (mDemuxThread)
+	{
+		mDemuxThread->join();
+		delete mDemuxThread;
+		mDemuxThread = nullptr;
+	}
+
+	if (mDecodeThread)
+	{
+		mDecodeThread->join();
+		delete mDecodeThread;
+		mDecodeThread = nullptr;
+	}
+
+	//free what is left in the queues
+	TimedPacket pkt = { nullptr, 0.0 };
+	while (mPacketQueue.tryPop(pkt))
+		av_packet_free(&pkt.packet);
+
+	TimedFrame frame = { nullptr, 0.0 };
+	while (mFrameQueue.tryPop(frame))
+		av_frame_free(&frame.frame);
 
-		do
+	mAbortRequested = false;
+}
+
+int FFmpegCapture::interruptCallback(void * opaque)
+{
+	FFmpegCapture * capture = reinterpret_cast<FFmpegCapture*>(opaque);
+	return capture->mAbortRequested ? 1 : 0;
+}
+
+void FFmpegCapture::demuxLoop()
+{
+	double retryDelay = 0.001;
+	double lastErrorLogTime = -ReadErrorLogInterval;
+	unsigned int readErrors = 0;
+
+	while (mPipelineRunning)
+	{
+		AVPacket * pkt = av_packet_alloc();
+		if (!pkt)
 		{
-			ret = decodePacket(&gotVideoFrame);
-			if (ret < 0)
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate packet!\n");
+			break;
+		}
+
+		//blocks until the device delivers the next packet
+		int ret = av_read_frame(mFMTContext, pkt);
+		double readTime = sgct::Engine::getTime();
+		if (ret < 0)
+		{
+			av_packet_free(&pkt);
+
+			//nothing more will come from the device
+			if (ret == AVERROR_EOF)
 			{
-				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to decode package!\n");
-				all_ok = false;
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Capture stream ended, no more packets are read.\n");
 				break;
 			}
 
-			mPkt.data += ret;
-			mPkt.size -= ret;
+			double delay = 0.001;
+			if (ret != AVERROR(EAGAIN) && ret != AVERROR_EXIT)
+			{
+				//a lost device fails every read, back off and keep the log readable
+				readErrors++;
+				if (readTime - lastErrorLogTime >= ReadErrorLogInterval)
+				{
+					sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to read packet: %s (%u failed reads)!\n", av_err2str(ret), readErrors);
+					lastErrorLogTime = readTime;
+				}
+				delay = retryDelay;
+				retryDelay = retryDelay * 2.0 < MaxReadRetryDelay ? retryDelay * 2.0 : MaxReadRetryDelay;
+			}
+			if (mPipelineRunning)
+				sgct::Engine::sleep(delay);
+			continue;
+		}
+
+		retryDelay = 0.001;
+		readErrors = 0;
 
-		} while (mPkt.size > 0);
+		if (pkt->stream_index != mVideo_stream_idx)
+		{
+			av_packet_free(&pkt);
+			continue;
+		}
 
-		av_free_packet(&orig_pkt);
+		//Capture devices deliver raw or intra-only (mjpeg) packets,
+		//so dropping the oldest one never breaks decoding of the following ones
+		TimedPacket item = { pkt, readTime };
+		TimedPacket dropped = { nullptr, 0.0 };
+		if (mPacketQueue.push(item, dropped))
+			av_packet_free(&dropped.packet);
 	}
+}
 
-	return all_ok;
+void FFmpegCapture::decodeLoop()
+{
+	while (mPipelineRunning)
+	{
+		TimedPacket item = { nullptr, 0.0 };
+		if (!mPacketQueue.pop(item, 0.1))
+			continue;
+
+		int ret = avcodec_send_packet(mVideoCodecContext, item.packet);
+		if (ret == AVERROR(EAGAIN))
+		{
+			//decoder is full, empty it and resend
+			receiveFrames(item.readTime);
+			ret = avcodec_send_packet(mVideoCodecContext, item.packet);
+		}
+		av_packet_free(&item.packet);
+
+		if (ret < 0)
+		{
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Video decoding error: %s!\n", av_err2str(ret));
+			continue;
+		}
+
+		//capture codecs have no frame delay, so the frames belong to this packet
+		receiveFrames(item.readTime);
+	}
+}
+
+void FFmpegCapture::receiveFrames(double readTime)
+{
+	while (true)
+	{
+		AVFrame * frame = av_frame_alloc();
+		if (!frame)
+		{
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate frame data!\n");
+			return;
+		}
+
+		int ret = avcodec_receive_frame(mVideoCodecContext, frame);
+		if (ret < 0)
+		{
+			//AVERROR(EAGAIN) means that the decoder needs more input
+			if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+				sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Video decoding error: %s!\n", av_err2str(ret));
+			av_frame_free(&frame);
+			return;
+		}
+
+		mDecodedVideoFrames++;
+
+		TimedFrame item = { frame, readTime };
+		TimedFrame dropped = { nullptr, 0.0 };
+		if (mFrameQueue.push(item, dropped))
+			av_frame_free(&dropped.frame);
+	}
 }
 
 void FFmpegCapture::setupOptions()
@@ -321,8 +758,6 @@ int FFmpegCapture::openCodeContext(AVFormatContext *fmt_ctx, enum AVMediaType ty
 
 bool FFmpegCapture::allocateVideoDecoderData(AVPixelFormat pix_fmt)
 {
-	int ret = 0;
-
 	if (pix_fmt != mDstPixFmt)
 	{
 		char buf[256];
@@ -338,17 +773,15 @@ bool FFmpegCapture::allocateVideoDecoderData(AVPixelFormat pix_fmt)
 		if (found != std::string::npos)
 			mVideoDstFormat = mVideoDstFormat.substr(0, found); //delate inrelevant data
 
-		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Creating video scaling context (%s->%s)\n", mVideoStrFormat.c_str(), mVideoDstFormat.c_str());
-
-		//create context for frame convertion
-		mVideoScaleContext = sws_getContext(mWidth, mHeight, pix_fmt,
-			mWidth, mHeight, mDstPixFmt,
-			SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-		if (!mVideoScaleContext)
+		//create slices and contexts for frame convertion
+		if (!mConverter.init(mWidth, mHeight, pix_fmt, mDstPixFmt, mConversionThreads, !mForceSwscale, mConversionLevel))
 		{
 			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate frame convertion context!\n");
 			return false;
 		}
+
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Using %s frame conversion on %u threads (%s->%s)\n",
+			mConverter.getName(), static_cast<unsigned int>(mConverter.getThreadCount()), mVideoStrFormat.c_str(), mVideoDstFormat.c_str());
 	}
 	else {
 		char buf[256];
@@ -362,110 +795,191 @@ bool FFmpegCapture::allocateVideoDecoderData(AVPixelFormat pix_fmt)
 		mVideoDstFormat = mVideoStrFormat;
 	}
 
-	mTempFrame = av_frame_alloc();
-	if (!mTempFrame)
-	{
-		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate temp frame data!\n");
-		return false;
-	}
-
-	mTempFrame->width = mWidth;
-	mTempFrame->height = mHeight;
-	mTempFrame->format = mDstPixFmt;
-
-	ret = av_image_alloc(mTempFrame->data, mTempFrame->linesize, mWidth, mHeight, mDstPixFmt, 1);
-	if (ret < 0)
-	{
-		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate temp frame buffer!\n");
-		return false;
-	}
-
-	if (!mFrame)
-		mFrame = av_frame_alloc();
-
-	if (!mFrame)
+	if (SliceConverter::toFramePixelFormat(mDstPixFmt) == FRAME_FORMAT_UNKNOWN)
 	{
-		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate frame data!\n");
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Unsupported capture format %s!\n", mVideoDstFormat.c_str());
 		return false;
 	}
 
 	return true;
 }
 
-int FFmpegCapture::decodePacket(int * gotVideoPtr)
+int FFmpegCapture::convertFrame(AVFrame * frame, double readTime)
 {
 	int ret = 0;
-	int decoded = mPkt.size;
-	bool packageOk = false;
 
-	*gotVideoPtr = 0;
-	
-	if (mPkt.stream_index == mVideo_stream_idx && mVideoCodecContext)
-	{
-		/* decode video frame */
-		ret = avcodec_decode_video2(mVideoCodecContext, mFrame, gotVideoPtr, &mPkt);
-
-		if (ret < 0)
-		{
-			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Video decoding error: %s!\n", av_err2str(ret));
-			return ret;
-		}
+	//static content (slides) is neither converted, uploaded nor scanned again
+	if (isUnchangedFrame(frame))
+		return ret;
 
-		decoded = FFMIN(ret, mPkt.size);
-		if (*gotVideoPtr)
+	//write straight into the caller's destination if it wants this frame
+	if (mVideoDestinationCallback != nullptr)
+	{
+		FrameView destination;
+		describeFrame(destination, readTime);
+		destination.pts = frame->best_effort_timestamp != AV_NOPTS_VALUE ? frame->best_effort_timestamp : frame->pts;
+		if (mVideoDestinationCallback(destination))
 		{
-			packageOk = true;
-			
 			if (mVideoCodecContext->pix_fmt != mDstPixFmt)
 			{
-				//convert to destination pixel format
-				ret = sws_scale(mVideoScaleContext, mFrame->data, mFrame->linesize, 0, mHeight, mTempFrame->data, mTempFrame->linesize);
-				if (ret < 0)
+				if (!scaleFrame(frame, destination.planes, destination.linesizes))
 				{
 					sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to convert decoded frame to %s!\n", mVideoDstFormat.c_str());
-					return ret;
+					ret = AVERROR(EINVAL);
 				}
 			}
 			else
 			{
-				ret = av_frame_copy(mTempFrame, mFrame);
-				if (ret < 0)
-				{
-					sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to copy frame!\n");
-					return ret;
-				}
+				//single copy from the decoder output
+				av_image_copy(destination.planes, destination.linesizes, const_cast<const uint8_t **>(frame->data), frame->linesize, mDstPixFmt, mWidth, mHeight);
 			}
 
-			//store mTempFrame;
-			if (mVideoDecoderCallback != nullptr)
-				mVideoDecoderCallback(mTempFrame->data, mWidth, mHeight);
+			if (mVideoWrittenCallback != nullptr)
+				mVideoWrittenCallback(destination, ret >= 0);
 
-			mDecodedVideoFrames++;
-			//std::cout << "Decoded frames: " << mDecodedVideoFrames << std::endl;
+			return ret;
+		}
+	}
 
-			if (ret < 0)
-			{
-				return ret;
-			}
+	if (mVideoFrameCallback == nullptr)
+		return ret;
+
+	//hand over a reference to the frame, the consumer may keep it as long as it needs
+	AVFrame * outFrame = nullptr;
+	if (mVideoCodecContext->pix_fmt == mDstPixFmt)
+		outFrame = av_frame_clone(frame); //new reference, no copy
+	else
+		outFrame = convertToPooledFrame(frame);
+
+	if (!outFrame)
+		return AVERROR(ENOMEM);
+
+	FrameView view;
+	describeFrame(view, readTime);
+	for (int i = 0; i < 4; i++)
+	{
+		view.planes[i] = outFrame->data[i];
+		view.linesizes[i] = outFrame->linesize[i];
+	}
+	view.pts = outFrame->best_effort_timestamp != AV_NOPTS_VALUE ? outFrame->best_effort_timestamp : outFrame->pts;
+	//the frame owns the buffer references
+	view.owner = std::shared_ptr<AVFrame>(outFrame, [](AVFrame * f) { av_frame_free(&f); });
+
+	mVideoFrameCallback(view);
+	return ret;
+}
+
+bool FFmpegCapture::isUnchangedFrame(AVFrame * frame)
+{
+	if (!mSkipUnchanged)
+		return false;
+
+	AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(frame->format);
+	const AVPixFmtDescriptor * desc = av_pix_fmt_desc_get(pix_fmt);
+	int rowBytes[4] = { 0, 0, 0, 0 };
+	if (!desc || av_image_fill_linesizes(rowBytes, pix_fmt, frame->width) < 0)
+		return false;
+
+	//decoded frames of any format, chroma planes have fewer rows
+	int planeCount = av_pix_fmt_count_planes(pix_fmt);
+	int rows[4];
+	for (int p = 0; p < planeCount; p++)
+		rows[p] = (p == 1 || p == 2) ? AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+
+	double start = sgct::Engine::getTime();
+	uint64_t signature = FrameSignature::compute(frame->data, frame->linesize, rowBytes, rows, planeCount, mConversionLevel);
+	double now = sgct::Engine::getTime();
+
+	//only called from the polling thread
+	std::size_t count = ++mSignedFrames;
+	mAverageSignatureTime = mAverageSignatureTime + ((now - start) - mAverageSignatureTime) / static_cast<double>(count);
+
+	//a frame lost on the way (e.g. a full upload ring) is replaced within the refresh interval
+	bool refresh = mUnchangedRefreshInterval > 0.0 && (now - mLastSignatureTime) >= mUnchangedRefreshInterval;
+	if (mHasLastSignature && signature == mLastSignature && !refresh)
+	{
+		mUnchangedFrames++;
+		return true;
+	}
+
+	mLastSignature = signature;
+	mHasLastSignature = true;
+	mLastSignatureTime = now;
+	return false;
+}
+
+void FFmpegCapture::describeFrame(FrameView & view, double readTime)
+{
+	view.width = mWidth;
+	view.height = mHeight;
+	view.format = SliceConverter::toFramePixelFormat(mDstPixFmt);
+	view.orientation = getOrientation();
+	view.timestamp = readTime;
+	view.sequence = mFrameSequence++;
+}
+
+AVFrame * FFmpegCapture::convertToPooledFrame(AVFrame * frame)
+{
+	if (!mConvertedFramePool)
+	{
+		int size = av_image_get_buffer_size(mDstPixFmt, mWidth, mHeight, 1);
+		mConvertedFramePool = av_buffer_pool_init(size, nullptr);
+		if (!mConvertedFramePool)
+		{
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Could not allocate frame pool!\n");
+			return nullptr;
 		}
 	}
 
-#if USE_REF_COUNTER
-	/* If we use the new API with reference counting, we own the data and need
-	* to de-reference it when we don't use it anymore */
-	if (packageOk)
+	AVFrame * dstFrame = av_frame_alloc();
+	if (!dstFrame)
+		return nullptr;
+
+	//buffers return to the pool when the last handle is released
+	dstFrame->buf[0] = av_buffer_pool_get(mConvertedFramePool);
+	if (!dstFrame->buf[0])
 	{
-		av_frame_unref(mFrame);
+		av_frame_free(&dstFrame);
+		return nullptr;
 	}
-#endif
 
-	return decoded;
+	av_image_fill_arrays(dstFrame->data, dstFrame->linesize, dstFrame->buf[0]->data, mDstPixFmt, mWidth, mHeight, 1);
+	dstFrame->width = mWidth;
+	dstFrame->height = mHeight;
+	dstFrame->format = mDstPixFmt;
+	av_frame_copy_props(dstFrame, frame);
+
+	if (!scaleFrame(frame, dstFrame->data, dstFrame->linesize))
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to convert decoded frame to %s!\n", mVideoDstFormat.c_str());
+		av_frame_free(&dstFrame);
+		return nullptr;
+	}
+
+	return dstFrame;
+}
+
+bool FFmpegCapture::scaleFrame(AVFrame * frame, uint8_t * const dstData[], const int dstLinesize[])
+{
+	double start = sgct::Engine::getTime();
+	bool ok = mConverter.convert(frame->data, frame->linesize, dstData, dstLinesize);
+	double time = sgct::Engine::getTime() - start;
+
+	//only called from the polling thread
+	std::size_t count = ++mConvertedFrames;
+	mLastConversionTime = time;
+	mAverageConversionTime = mAverageConversionTime + (time - mAverageConversionTime) / static_cast<double>(count);
+	return ok;
 }
 
 void FFmpegCapture::cleanup()
 {
+	stopPipeline();
+
 	mInited = false;
-	mVideoDecoderCallback = nullptr;
+	mVideoFrameCallback = nullptr;
+	mVideoDestinationCallback = nullptr;
+	mVideoWrittenCallback = nullptr;
 
 	if (mVideoCodecContext)
 	{
@@ -479,23 +993,11 @@ void FFmpegCapture::cleanup()
 		mFMTContext = nullptr;
 	}
 
-	if (mFrame)
-	{
-		av_frame_free(&mFrame);
-		mFrame = nullptr;
-	}
+	//the pool is freed once the last handed out frame is released
+	if (mConvertedFramePool)
+		av_buffer_pool_uninit(&mConvertedFramePool);
 
-	if (mTempFrame)
-	{
-		av_frame_free(&mTempFrame);
-		mTempFrame = nullptr;
-	}
-
-	if (mVideoScaleContext)
-	{
-		sws_freeContext(mVideoScaleContext);
-		mVideoScaleContext = nullptr;
-	}
+	mConverter.cleanup();
 
 	mVideoStream = nullptr;
 
@@ -15,50 +15,145 @@ extern "C"
 #include <string>
 #include <vector>
 #include <functional>
+#include <thread>
+#include <atomic>
+#include "BoundedQueue.hpp"
+#include "CaptureFrame.hpp"
+#include "SliceConverter.hpp"
+#include "FrameSignature.hpp"
 
 class FFmpegCapture
 {
+	//queue entries carry the time the packet was read from the device
+	struct TimedPacket
+	{
+		AVPacket * packet;
+		double readTime;
+	};
+
+	struct TimedFrame
+	{
+		AVFrame * frame;
+		double readTime;
+	};
+
 public:
 	FFmpegCapture();
 	~FFmpegCapture();
 	bool init();
     void setVideoHost(std::string hostAdress);
 	void setVideoDevice(std::string videoDeviceName);
-	void setVideoDecoderCallback(std::function<void(uint8_t ** data, int width, int height)> cb);
+	void setVideoFrameCallback(std::function<void(const FrameView & frame)> cb);
+	void setVideoDestinationCallbacks(std::function<bool(FrameView & destination)> acquire, std::function<void(const FrameView & frame, bool success)> written);
 	void addOption(std::pair<std::string, std::string> option);
-	bool poll();
+	bool poll(double timeout = 0.0);
 
     std::string getVideoHost() const;
 	int getWidth() const;
 	int getHeight() const;
+	FrameOrientation getOrientation() const;
+	FramePixelFormat getFramePixelFormat() const;
 	const char * getFormat() const;
 	int isFormatYUYV422() const;
 	int isFormatBGR24() const;
+	const char * getConversionName() const;
+	std::size_t getConversionThreads() const;
+	double getLastConversionTime() const;
+	double getAverageConversionTime() const;
 	std::size_t getNumberOfDecodedFrames() const;
 
+	//frames equal to the last delivered one are dropped before conversion
+	void setSkipUnchangedFrames(bool skip);
+	bool isSkippingUnchangedFrames() const;
+	std::size_t getNumberOfUnchangedFrames() const;
+	double getAverageSignatureTime() const;
+
+	//pipeline queues (demux -> decode -> convert)
+	void setQueueDepth(std::size_t depth);
+	std::size_t getQueueDepth() const;
+	std::size_t getPacketQueueSize() const;
+	std::size_t getFrameQueueSize() const;
+	std::size_t getNumberOfDroppedPackets() const;
+	std::size_t getNumberOfDroppedFrames() const;
+
+	//delivery pacing and latency (packet read -> callback done)
+	void setTargetRate(double fps);
+	double getTargetRate() const;
+	std::size_t getNumberOfPacedFrames() const;
+	double getLastDeliveryLatency() const;
+	double getAverageDeliveryLatency() const;
+	double getMaxDeliveryLatency() const;
+
 private:
 	void initFFmpeg();
 	bool initVideoStream();
 	int openCodeContext(AVFormatContext *fmt_ctx, enum AVMediaType type, int & streamIndex);
 	bool allocateVideoDecoderData(AVPixelFormat pix_fmt);
-	int decodePacket(int * gotVideoPtr);
+	int convertFrame(AVFrame * frame, double readTime);
+	bool isUnchangedFrame(AVFrame * frame);
+	AVFrame * convertToPooledFrame(AVFrame * frame);
+	bool scaleFrame(AVFrame * frame, uint8_t * const dstData[], const int dstLinesize[]);
+	void describeFrame(FrameView & view, double readTime);
 	void setupOptions();
 	void cleanup();
 
+	void startPipeline();
+	void stopPipeline();
+	void demuxLoop();
+	void decodeLoop();
+	void receiveFrames(double readTime);
+	void updateDeliveryStats(double latency);
+	static int interruptCallback(void * opaque);
+
 	AVDictionary		* mOptions;
 	AVFormatContext		* mFMTContext;
 	AVStream			* mVideoStream;
 	AVCodecContext		* mVideoCodecContext;
-	SwsContext			* mVideoScaleContext;
-	AVFrame				* mFrame; //holds src format frame
-	AVFrame				* mTempFrame; //holds dst format frame
+	AVBufferPool		* mConvertedFramePool; //dst format buffers handed out with the frames
 
 	AVPixelFormat mDstPixFmt;
-	AVPacket mPkt;
+	bool mDstPixFmtForced; //set by capture_output_format, not by the device pixel format
+
+	//yuv frames are converted by our own kernels when possible, otherwise by swscale,
+	//in slices over mConversionThreads threads
+	SliceConverter mConverter;
+	bool mForceSwscale;
+	ConversionLevel mConversionLevel;
+	std::size_t mConversionThreads;
+	std::size_t mConvertedFrames;
+	std::atomic<double> mLastConversionTime;
+	std::atomic<double> mAverageConversionTime;
+
+	//signature of the last delivered frame, a frame is still delivered every mUnchangedRefreshInterval
+	bool mSkipUnchanged;
+	double mUnchangedRefreshInterval;
+	uint64_t mLastSignature;
+	bool mHasLastSignature;
+	double mLastSignatureTime;
+	std::size_t mSignedFrames;
+	std::atomic<std::size_t> mUnchangedFrames;
+	std::atomic<double> mAverageSignatureTime;
 
-	std::size_t mDecodedVideoFrames;
+	std::atomic<std::size_t> mDecodedVideoFrames;
+	uint64_t mFrameSequence;
 	bool mInited;
 
+	std::size_t mQueueDepth;
+	BoundedQueue<TimedPacket> mPacketQueue;
+	BoundedQueue<TimedFrame> mFrameQueue;
+	std::thread * mDemuxThread;
+	std::thread * mDecodeThread;
+	std::atomic<bool> mPipelineRunning;
+	std::atomic<bool> mAbortRequested;
+
+	double mTargetRate;
+	double mNextDeliveryTime;
+	std::atomic<std::size_t> mPacedFrames;
+	std::atomic<std::size_t> mDeliveredFrames;
+	std::atomic<double> mLastDeliveryLatency;
+	std::atomic<double> mAverageDeliveryLatency;
+	std::atomic<double> mMaxDeliveryLatency;
+
 	int mWidth;
 	int mHeight;
 	int mVideo_stream_idx;
@@ -72,8 +167,11 @@ private:
 	bool mFormatYUVY422;
 	bool mFormatBGR24;
 
-	//callback function pointer
-	std::function<void(uint8_t ** data, int width, int height)> mVideoDecoderCallback;
+	//owned frames, shares the decoder buffer when no conversion is needed
+	std::function<void(const FrameView & frame)> mVideoFrameCallback;
+	//optional caller provided destination (e.g. mapped upload memory), frames are converted straight into it
+	std::function<bool(FrameView & destination)> mVideoDestinationCallback;
+	std::function<void(const FrameView & frame, bool success)> mVideoWrittenCallback;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,435 @@
+#include "FrameConverter.hpp"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRAME_CONVERTER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//gcc and clang only emit sse4/avx2 code in functions marked for it,
+//msvc accepts the intrinsics anywhere
+#if defined(FRAME_CONVERTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE4
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	typedef void(*PackedRowFunction)(const uint8_t * src, uint8_t * dst, int width);
+	typedef void(*SemiPlanarRowFunction)(const uint8_t * srcY, const uint8_t * srcUV, uint8_t * dst, int width);
+
+	//Fixed point BT.601 (limited range) with 6 bit coefficients:
+	//  c = 75 * (y - 16), d = u - 128, e = v - 128
+	//  b = (c + 129 * d + 32) >> 6
+	//  g = (c - 25 * d - 52 * e + 32) >> 6
+	//  r = (c + 102 * e + 32) >> 6
+	//All terms fit in 16 bits except c + 129 * d for bright blue, where the
+	//simd paths saturate, which gives 255 just like the clamp here.
+	inline uint8_t clampToByte(int value)
+	{
+		return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+	}
+
+	template<int Bpp>
+	inline void yuvToPixel(int y, int u, int v, uint8_t * dst)
+	{
+		int c = 75 * (y - 16);
+		int d = u - 128;
+		int e = v - 128;
+		dst[0] = clampToByte((c + 129 * d + 32) >> 6);
+		dst[1] = clampToByte((c - 25 * d - 52 * e + 32) >> 6);
+		dst[2] = clampToByte((c + 102 * e + 32) >> 6);
+		if (Bpp == 4)
+			dst[3] = 255;
+	}
+
+	//pixels x to width of a row,
+	//packed 4:2:2 with the byte offsets of y0, u and v in a pixel pair (y1 follows y0 by two)
+	template<int Bpp, int YOffset, int UOffset, int VOffset>
+	void packedPixelsScalar(const uint8_t * src, uint8_t * dst, int x, int width)
+	{
+		for (; x < width; x++)
+		{
+			const uint8_t * pair = src + (x >> 1) * 4;
+			yuvToPixel<Bpp>(pair[YOffset + (x & 1) * 2], pair[UOffset], pair[VOffset], dst + x * Bpp);
+		}
+	}
+
+	template<int Bpp>
+	void semiPlanarPixelsScalar(const uint8_t * srcY, const uint8_t * srcUV, uint8_t * dst, int x, int width)
+	{
+		for (; x < width; x++)
+		{
+			const uint8_t * uv = srcUV + (x & ~1);
+			yuvToPixel<Bpp>(srcY[x], uv[0], uv[1], dst + x * Bpp);
+		}
+	}
+
+	template<int Bpp, int YOffset, int UOffset, int VOffset>
+	void packedRowScalar(const uint8_t * src, uint8_t * dst, int width)
+	{
+		packedPixelsScalar<Bpp, YOffset, UOffset, VOffset>(src, dst, 0, width);
+	}
+
+	template<int Bpp>
+	void semiPlanarRowScalar(const uint8_t * srcY, const uint8_t * srcUV, uint8_t * dst, int width)
+	{
+		semiPlanarPixelsScalar<Bpp>(srcY, srcUV, dst, 0, width);
+	}
+
+#ifdef FRAME_CONVERTER_X86
+	// ---------------- SSE4, 8 pixels per step ----------------
+
+	//16 bit y, u and v of 8 pixels to two registers of 4 bgra pixels
+	TARGET_SSE4 inline void yuvToBgra8(__m128i y, __m128i u, __m128i v, __m128i & lo, __m128i & hi)
+	{
+		const __m128i round = _mm_set1_epi16(32);
+		__m128i c = _mm_mullo_epi16(_mm_sub_epi16(y, _mm_set1_epi16(16)), _mm_set1_epi16(75));
+		__m128i d = _mm_sub_epi16(u, _mm_set1_epi16(128));
+		__m128i e = _mm_sub_epi16(v, _mm_set1_epi16(128));
+
+		__m128i b = _mm_adds_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(d, _mm_set1_epi16(129))), round);
+		__m128i g = _mm_adds_epi16(_mm_subs_epi16(_mm_subs_epi16(c, _mm_mullo_epi16(d, _mm_set1_epi16(25))), _mm_mullo_epi16(e, _mm_set1_epi16(52))), round);
+		__m128i r = _mm_adds_epi16(_mm_adds_epi16(c, _mm_mullo_epi16(e, _mm_set1_epi16(102))), round);
+
+		//the unsigned pack clamps to 0-255
+		b = _mm_packus_epi16(_mm_srai_epi16(b, 6), _mm_setzero_si128());
+		g = _mm_packus_epi16(_mm_srai_epi16(g, 6), _mm_setzero_si128());
+		r = _mm_packus_epi16(_mm_srai_epi16(r, 6), _mm_setzero_si128());
+
+		__m128i bg = _mm_unpacklo_epi8(b, g);
+		__m128i ra = _mm_unpacklo_epi8(r, _mm_set1_epi8(-1));
+		lo = _mm_unpacklo_epi16(bg, ra);
+		hi = _mm_unpackhi_epi16(bg, ra);
+	}
+
+	template<int Bpp>
+	TARGET_SSE4 inline void store8(uint8_t * dst, __m128i lo, __m128i hi)
+	{
+		if (Bpp == 4)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 16), hi);
+		}
+		else
+		{
+			//drop alpha, 4 pixels become 12 bytes
+			const __m128i pack = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -128, -128, -128, -128);
+			lo = _mm_shuffle_epi8(lo, pack);
+			hi = _mm_shuffle_epi8(hi, pack);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_or_si128(lo, _mm_slli_si128(hi, 12)));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + 16), _mm_srli_si128(hi, 4));
+		}
+	}
+
+	template<int Bpp, int YOffset, int UOffset, int VOffset>
+	TARGET_SSE4 void packedRowSSE4(const uint8_t * src, uint8_t * dst, int width)
+	{
+		const __m128i yMask = _mm_setr_epi8(YOffset, -128, YOffset + 2, -128, YOffset + 4, -128, YOffset + 6, -128,
+			YOffset + 8, -128, YOffset + 10, -128, YOffset + 12, -128, YOffset + 14, -128);
+		const __m128i uMask = _mm_setr_epi8(UOffset, -128, UOffset, -128, UOffset + 4, -128, UOffset + 4, -128,
+			UOffset + 8, -128, UOffset + 8, -128, UOffset + 12, -128, UOffset + 12, -128);
+		const __m128i vMask = _mm_setr_epi8(VOffset, -128, VOffset, -128, VOffset + 4, -128, VOffset + 4, -128,
+			VOffset + 8, -128, VOffset + 8, -128, VOffset + 12, -128, VOffset + 12, -128);
+
+		int x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+			__m128i lo, hi;
+			yuvToBgra8(_mm_shuffle_epi8(pixels, yMask), _mm_shuffle_epi8(pixels, uMask), _mm_shuffle_epi8(pixels, vMask), lo, hi);
+			store8<Bpp>(dst + x * Bpp, lo, hi);
+		}
+		packedPixelsScalar<Bpp, YOffset, UOffset, VOffset>(src, dst, x, width);
+	}
+
+	template<int Bpp>
+	TARGET_SSE4 void semiPlanarRowSSE4(const uint8_t * srcY, const uint8_t * srcUV, uint8_t * dst, int width)
+	{
+		const __m128i uMask = _mm_setr_epi8(0, -128, 0, -128, 2, -128, 2, -128, 4, -128, 4, -128, 6, -128, 6, -128);
+		const __m128i vMask = _mm_setr_epi8(1, -128, 1, -128, 3, -128, 3, -128, 5, -128, 5, -128, 7, -128, 7, -128);
+
+		int x = 0;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i y = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(srcY + x)));
+			__m128i uv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(srcUV + x));
+			__m128i lo, hi;
+			yuvToBgra8(y, _mm_shuffle_epi8(uv, uMask), _mm_shuffle_epi8(uv, vMask), lo, hi);
+			store8<Bpp>(dst + x * Bpp, lo, hi);
+		}
+		semiPlanarPixelsScalar<Bpp>(srcY, srcUV, dst, x, width);
+	}
+
+	// ---------------- AVX2, 16 pixels per step ----------------
+
+	//same as yuvToBgra8 on both 128 bit lanes (pixels 0-7 and 8-15),
+	//returns pixels 0-7 in first and 8-15 in second
+	TARGET_AVX2 inline void yuvToBgra16(__m256i y, __m256i u, __m256i v, __m256i & first, __m256i & second)
+	{
+		const __m256i round = _mm256_set1_epi16(32);
+		__m256i c = _mm256_mullo_epi16(_mm256_sub_epi16(y, _mm256_set1_epi16(16)), _mm256_set1_epi16(75));
+		__m256i d = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+		__m256i e = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+
+		__m256i b = _mm256_adds_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(d, _mm256_set1_epi16(129))), round);
+		__m256i g = _mm256_adds_epi16(_mm256_subs_epi16(_mm256_subs_epi16(c, _mm256_mullo_epi16(d, _mm256_set1_epi16(25))), _mm256_mullo_epi16(e, _mm256_set1_epi16(52))), round);
+		__m256i r = _mm256_adds_epi16(_mm256_adds_epi16(c, _mm256_mullo_epi16(e, _mm256_set1_epi16(102))), round);
+
+		b = _mm256_packus_epi16(_mm256_srai_epi16(b, 6), _mm256_setzero_si256());
+		g = _mm256_packus_epi16(_mm256_srai_epi16(g, 6), _mm256_setzero_si256());
+		r = _mm256_packus_epi16(_mm256_srai_epi16(r, 6), _mm256_setzero_si256());
+
+		__m256i bg = _mm256_unpacklo_epi8(b, g);
+		__m256i ra = _mm256_unpacklo_epi8(r, _mm256_set1_epi8(-1));
+		__m256i lo = _mm256_unpacklo_epi16(bg, ra); //pixels 0-3 | 8-11
+		__m256i hi = _mm256_unpackhi_epi16(bg, ra); //pixels 4-7 | 12-15
+		first = _mm256_permute2x128_si256(lo, hi, 0x20);
+		second = _mm256_permute2x128_si256(lo, hi, 0x31);
+	}
+
+	template<int Bpp>
+	TARGET_AVX2 inline void store16(uint8_t * dst, __m256i first, __m256i second)
+	{
+		if (Bpp == 4)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), first);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 32), second);
+		}
+		else
+		{
+			store8<Bpp>(dst, _mm256_castsi256_si128(first), _mm256_extracti128_si256(first, 1));
+			store8<Bpp>(dst + 8 * Bpp, _mm256_castsi256_si128(second), _mm256_extracti128_si256(second, 1));
+		}
+	}
+
+	template<int Bpp, int YOffset, int UOffset, int VOffset>
+	TARGET_AVX2 void packedRowAVX2(const uint8_t * src, uint8_t * dst, int width)
+	{
+		//shuffles work within each lane, so the masks are repeated
+		const __m256i yMask = _mm256_setr_epi8(YOffset, -128, YOffset + 2, -128, YOffset + 4, -128, YOffset + 6, -128,
+			YOffset + 8, -128, YOffset + 10, -128, YOffset + 12, -128, YOffset + 14, -128,
+			YOffset, -128, YOffset + 2, -128, YOffset + 4, -128, YOffset + 6, -128,
+			YOffset + 8, -128, YOffset + 10, -128, YOffset + 12, -128, YOffset + 14, -128);
+		const __m256i uMask = _mm256_setr_epi8(UOffset, -128, UOffset, -128, UOffset + 4, -128, UOffset + 4, -128,
+			UOffset + 8, -128, UOffset + 8, -128, UOffset + 12, -128, UOffset + 12, -128,
+			UOffset, -128, UOffset, -128, UOffset + 4, -128, UOffset + 4, -128,
+			UOffset + 8, -128, UOffset + 8, -128, UOffset + 12, -128, UOffset + 12, -128);
+		const __m256i vMask = _mm256_setr_epi8(VOffset, -128, VOffset, -128, VOffset + 4, -128, VOffset + 4, -128,
+			VOffset + 8, -128, VOffset + 8, -128, VOffset + 12, -128, VOffset + 12, -128,
+			VOffset, -128, VOffset, -128, VOffset + 4, -128, VOffset + 4, -128,
+			VOffset + 8, -128, VOffset + 8, -128, VOffset + 12, -128, VOffset + 12, -128);
+
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 2));
+			__m256i first, second;
+			yuvToBgra16(_mm256_shuffle_epi8(pixels, yMask), _mm256_shuffle_epi8(pixels, uMask), _mm256_shuffle_epi8(pixels, vMask), first, second);
+			store16<Bpp>(dst + x * Bpp, first, second);
+		}
+		_mm256_zeroupper();
+		packedRowSSE4<Bpp, YOffset, UOffset, VOffset>(src + x * 2, dst + x * Bpp, width - x);
+	}
+
+	template<int Bpp>
+	TARGET_AVX2 void semiPlanarRowAVX2(const uint8_t * srcY, const uint8_t * srcUV, uint8_t * dst, int width)
+	{
+		//the 16 chroma bytes are in both lanes, the upper lane uses the second half
+		const __m256i uMask = _mm256_setr_epi8(0, -128, 0, -128, 2, -128, 2, -128, 4, -128, 4, -128, 6, -128, 6, -128,
+			8, -128, 8, -128, 10, -128, 10, -128, 12, -128, 12, -128, 14, -128, 14, -128);
+		const __m256i vMask = _mm256_setr_epi8(1, -128, 1, -128, 3, -128, 3, -128, 5, -128, 5, -128, 7, -128, 7, -128,
+			9, -128, 9, -128, 11, -128, 11, -128, 13, -128, 13, -128, 15, -128, 15, -128);
+
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m256i y = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(srcY + x)));
+			__m256i uv = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(srcUV + x)));
+			__m256i first, second;
+			yuvToBgra16(y, _mm256_shuffle_epi8(uv, uMask), _mm256_shuffle_epi8(uv, vMask), first, second);
+			store16<Bpp>(dst + x * Bpp, first, second);
+		}
+		_mm256_zeroupper();
+		semiPlanarRowSSE4<Bpp>(srcY + x, srcUV + x, dst + x * Bpp, width - x);
+	}
+
+	ConversionLevel detectLevel()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		bool ssse3 = (info[2] & (1 << 9)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		bool avx2 = false;
+		if (maxLeaf >= 7 && avx && osxsave && (_xgetbv(0) & 6) == 6) //ymm state saved by the os
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+
+		if (avx2)
+			return CONVERSION_AVX2;
+		if (sse41 && ssse3)
+			return CONVERSION_SSE4;
+#else
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return CONVERSION_AVX2;
+		if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3"))
+			return CONVERSION_SSE4;
+#endif
+		return CONVERSION_SCALAR;
+	}
+#else
+	ConversionLevel detectLevel()
+	{
+		return CONVERSION_SCALAR;
+	}
+#endif
+
+	int getBytesPerPixel(FramePixelFormat format)
+	{
+		switch (format)
+		{
+		case FRAME_FORMAT_BGR24: return 3;
+		case FRAME_FORMAT_BGRA: return 4;
+		default: return 0;
+		}
+	}
+
+	template<int Bpp>
+	PackedRowFunction getPackedRowFunction(FramePixelFormat srcFormat, ConversionLevel level)
+	{
+		bool uyvy = srcFormat == FRAME_FORMAT_UYVY422;
+#ifdef FRAME_CONVERTER_X86
+		if (level == CONVERSION_AVX2)
+			return uyvy ? packedRowAVX2<Bpp, 1, 0, 2> : packedRowAVX2<Bpp, 0, 1, 3>;
+		if (level == CONVERSION_SSE4)
+			return uyvy ? packedRowSSE4<Bpp, 1, 0, 2> : packedRowSSE4<Bpp, 0, 1, 3>;
+#endif
+		return uyvy ? packedRowScalar<Bpp, 1, 0, 2> : packedRowScalar<Bpp, 0, 1, 3>;
+	}
+
+	template<int Bpp>
+	SemiPlanarRowFunction getSemiPlanarRowFunction(ConversionLevel level)
+	{
+#ifdef FRAME_CONVERTER_X86
+		if (level == CONVERSION_AVX2)
+			return semiPlanarRowAVX2<Bpp>;
+		if (level == CONVERSION_SSE4)
+			return semiPlanarRowSSE4<Bpp>;
+#endif
+		return semiPlanarRowScalar<Bpp>;
+	}
+}
+
+bool FrameConverter::isSupported(FramePixelFormat srcFormat, FramePixelFormat dstFormat)
+{
+	if (getBytesPerPixel(dstFormat) == 0)
+		return false;
+
+	return srcFormat == FRAME_FORMAT_YUYV422 || srcFormat == FRAME_FORMAT_UYVY422 || srcFormat == FRAME_FORMAT_NV12;
+}
+
+bool FrameConverter::isSupported(const FrameView & src, FramePixelFormat dstFormat)
+{
+	if (!isSupported(src.format, dstFormat) || src.width <= 0 || src.height <= 0)
+		return false;
+
+	//packed 4:2:2 rows hold whole pixel pairs only
+	return src.format == FRAME_FORMAT_NV12 || (src.width & 1) == 0;
+}
+
+ConversionLevel FrameConverter::getBestLevel()
+{
+	static const ConversionLevel level = detectLevel();
+	return level;
+}
+
+const char * FrameConverter::getLevelName(ConversionLevel level)
+{
+	switch (level)
+	{
+	case CONVERSION_SSE4: return "sse4";
+	case CONVERSION_AVX2: return "avx2";
+	default: return "scalar";
+	}
+}
+
+bool FrameConverter::parseLevel(const std::string & name, ConversionLevel & level)
+{
+	if (name.compare("scalar") == 0)
+		level = CONVERSION_SCALAR;
+	else if (name.compare("sse4") == 0)
+		level = CONVERSION_SSE4;
+	else if (name.compare("avx2") == 0)
+		level = CONVERSION_AVX2;
+	else if (name.compare("auto") == 0)
+		level = getBestLevel();
+	else
+		return false;
+
+	return true;
+}
+
+bool FrameConverter::convert(const FrameView & src, FrameView & dst, ConversionLevel level)
+{
+	return convertRows(src, dst, 0, src.height, level);
+}
+
+bool FrameConverter::convert(const FrameView & src, FrameView & dst)
+{
+	return convertRows(src, dst, 0, src.height, getBestLevel());
+}
+
+bool FrameConverter::convertRows(const FrameView & src, FrameView & dst, int firstRow, int rowCount, ConversionLevel level)
+{
+	if (!isSupported(src, dst.format) || dst.width != src.width || dst.height != src.height || !dst.planes[0])
+		return false;
+
+	if (firstRow < 0 || rowCount <= 0 || firstRow + rowCount > src.height)
+		return false;
+
+	if (level > getBestLevel())
+		level = getBestLevel();
+
+	const int width = src.width;
+	const int bpp = getBytesPerPixel(dst.format);
+	const int lastRow = firstRow + rowCount;
+
+	if (src.format == FRAME_FORMAT_NV12)
+	{
+		SemiPlanarRowFunction rowFunction = bpp == 4 ? getSemiPlanarRowFunction<4>(level) : getSemiPlanarRowFunction<3>(level);
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			//two rows share a chroma row
+			rowFunction(src.planes[0] + static_cast<std::ptrdiff_t>(y) * src.linesizes[0],
+				src.planes[1] + static_cast<std::ptrdiff_t>(y >> 1) * src.linesizes[1],
+				dst.planes[0] + static_cast<std::ptrdiff_t>(y) * dst.linesizes[0], width);
+		}
+	}
+	else
+	{
+		PackedRowFunction rowFunction = bpp == 4 ? getPackedRowFunction<4>(src.format, level) : getPackedRowFunction<3>(src.format, level);
+		for (int y = firstRow; y < lastRow; y++)
+		{
+			rowFunction(src.planes[0] + static_cast<std::ptrdiff_t>(y) * src.linesizes[0],
+				dst.planes[0] + static_cast<std::ptrdiff_t>(y) * dst.linesizes[0], width);
+		}
+	}
+
+	dst.orientation = src.orientation;
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef __FRAME_CONVERTER_
+#define __FRAME_CONVERTER_
+
+#include <string>
+#include "CaptureFrame.hpp"
+
+//Instruction set used by the conversion kernels
+enum ConversionLevel
+{
+	CONVERSION_SCALAR = 0,
+	CONVERSION_SSE4,
+	CONVERSION_AVX2
+};
+
+//Hand-vectorized YUV to BGR(A) conversion for the formats delivered by capture devices
+//(YUYV422, UYVY422 and NV12 into BGR24 or BGRA), used instead of swscale when possible.
+//BT.601 limited range with 6 bit fixed point coefficients, so that every level gives the same bytes
+//and chroma is taken from the pixel pair (no interpolation).
+class FrameConverter
+{
+public:
+	static bool isSupported(FramePixelFormat srcFormat, FramePixelFormat dstFormat);
+	static bool isSupported(const FrameView & src, FramePixelFormat dstFormat);
+
+	//best level of this cpu, checked once
+	static ConversionLevel getBestLevel();
+	static const char * getLevelName(ConversionLevel level);
+	static bool parseLevel(const std::string & name, ConversionLevel & level);
+
+	//dst must have the same size as src, levels above getBestLevel() are lowered
+	static bool convert(const FrameView & src, FrameView & dst, ConversionLevel level);
+	static bool convert(const FrameView & src, FrameView & dst);
+	static bool convertRows(const FrameView & src, FrameView & dst, int firstRow, int rowCount, ConversionLevel level);
+};
+
+#endif
@@ -0,0 +1,189 @@
+/*
+*  Copyright 2017 Erik Sundn
+*
+*  Based on ImageReaderSource
+*  Copyright 2010-2011 ZXing authors
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*/
+
+#include "FrameLuminanceSource.h"
+#include "FrameSignature.hpp"
+#include <zxing/common/IllegalArgumentException.h>
+#include <string>
+#include <string.h>
+#include <algorithm>
+
+using zxing::Ref;
+using zxing::ArrayRef;
+using zxing::LuminanceSource;
+
+namespace {
+  //a row has at most 64 blocks, one bit each
+  const int MinBlockWidth = 64;
+}
+
+FrameLuminanceSource::LumaBuffer::LumaBuffer()
+    : width(0), height(0), blockWidth(MinBlockWidth), complete(false), usedScaled(0) {}
+
+void FrameLuminanceSource::LumaBuffer::reset(int width_, int height_) {
+  if (width_ != width || height_ != height || !luma) {
+    width = width_;
+    height = height_;
+    luma = ArrayRef<char>(std::max(1, width * height));
+    blockWidth = std::max(MinBlockWidth, (width + 63) / 64);
+  }
+  convertedBlocks.assign(height, 0);
+  complete = false;
+  usedScaled = 0;
+}
+
+Ref<FrameLuminanceSource::LumaBuffer> FrameLuminanceSource::LumaBuffer::takeScaled(int width_, int height_) {
+  if (usedScaled == scaled.size()) {
+    scaled.push_back(Ref<LumaBuffer>(new LumaBuffer()));
+  }
+  Ref<LumaBuffer> level = scaled[usedScaled++];
+  level->reset(width_, height_);
+  return level;
+}
+
+FrameLuminanceSource::FrameLuminanceSource(const uint8_t* pixels_, int stride_, int pixelStride_, LumaConverter::RowFunction rowFunction_, const std::shared_ptr<const void>& owner_,
+  int dataWidth_, int dataHeight_, bool flipped_, Ref<LumaBuffer> buffer_, int left_, int top_, int width, int height)
+    : Super(width, height), pixels(pixels_), stride(stride_), pixelStride(pixelStride_), rowFunction(rowFunction_), owner(owner_), dataWidth(dataWidth_), dataHeight(dataHeight_),
+    left(left_), top(top_), flipped(flipped_), buffer(buffer_) {}
+
+Ref<LuminanceSource> FrameLuminanceSource::create(const FrameView& frame) {
+  return create(frame, Ref<LumaBuffer>(new LumaBuffer()));
+}
+
+Ref<LuminanceSource> FrameLuminanceSource::create(const FrameView& frame, Ref<LumaBuffer> buffer) {
+  if (!buffer) {
+    buffer = Ref<LumaBuffer>(new LumaBuffer());
+  }
+  LumaConverter::RowFunction rowFunction = LumaConverter::getRowFunction(frame.format);
+  if (!rowFunction || !frame.planes[0]) {
+    throw zxing::IllegalArgumentException("Frame format has no luminance conversion.");
+  }
+  buffer->reset(frame.width, frame.height);
+  return Ref<LuminanceSource>(new FrameLuminanceSource(frame.planes[0], frame.linesizes[0], LumaConverter::getPixelStride(frame.format), rowFunction,
+    frame.owner, frame.width, frame.height, frame.orientation == FRAME_BOTTOM_UP, buffer, 0, 0, frame.width, frame.height));
+}
+
+const char* FrameLuminanceSource::getLumaRow(int row, int begin, int end) const {
+  LumaBuffer& lumaBuffer = *buffer;
+  char* lumaRow = &lumaBuffer.luma[0] + static_cast<size_t>(row) * dataWidth;
+  if (lumaBuffer.complete || begin >= end) {
+    return lumaRow;
+  }
+
+  const uint8_t* pixelRow = pixels + static_cast<ptrdiff_t>(flipped ? dataHeight - 1 - row : row) * stride;
+  uint64_t& converted = lumaBuffer.convertedBlocks[row];
+  for (int block = begin / lumaBuffer.blockWidth; block <= (end - 1) / lumaBuffer.blockWidth; block++) {
+    uint64_t bit = static_cast<uint64_t>(1) << block;
+    if (converted & bit) {
+      continue;
+    }
+    int blockBegin = block * lumaBuffer.blockWidth;
+    int blockEnd = std::min(dataWidth, blockBegin + lumaBuffer.blockWidth);
+    rowFunction(pixelRow + blockBegin * pixelStride, reinterpret_cast<uint8_t*>(lumaRow) + blockBegin, blockEnd - blockBegin);
+    converted |= bit;
+  }
+  return lumaRow;
+}
+
+zxing::ArrayRef<char> FrameLuminanceSource::getRow(int y, zxing::ArrayRef<char> row) const {
+  const char* lumaRow = getLumaRow(top + y, left, left + getWidth());
+  if (!row) {
+    row = zxing::ArrayRef<char>(getWidth());
+  }
+  memcpy(&row[0], lumaRow + left, getWidth());
+  return row;
+}
+
+zxing::ArrayRef<char> FrameLuminanceSource::getMatrix() const {
+  //the whole frame is the buffer itself, converted once for all passes
+  if (left == 0 && top == 0 && getWidth() == dataWidth && getHeight() == dataHeight) {
+    if (!buffer->complete) {
+      for (int y = 0; y < dataHeight; y++) {
+        getLumaRow(y, 0, dataWidth);
+      }
+      buffer->complete = true;
+    }
+    return buffer->luma;
+  }
+
+  if (!matrix) {
+    matrix = zxing::ArrayRef<char>(getWidth() * getHeight());
+    char* m = &matrix[0];
+    for (int y = 0; y < getHeight(); y++) {
+      memcpy(m, getLumaRow(top + y, left, left + getWidth()) + left, getWidth());
+      m += getWidth();
+    }
+  }
+  return matrix;
+}
+
+bool FrameLuminanceSource::isCropSupported() const {
+  return true;
+}
+
+Ref<LuminanceSource> FrameLuminanceSource::crop(int left_, int top_, int width, int height) const {
+  if (left_ < 0 || top_ < 0 || width <= 0 || height <= 0 || left_ + width > getWidth() || top_ + height > getHeight()) {
+    throw zxing::IllegalArgumentException("Crop rectangle does not fit within image data.");
+  }
+  return Ref<LuminanceSource>(new FrameLuminanceSource(pixels, stride, pixelStride, rowFunction, owner, dataWidth, dataHeight, flipped,
+    buffer, left + left_, top + top_, width, height));
+}
+
+Ref<LuminanceSource> FrameLuminanceSource::getScaled(int factor) const {
+  LumaConverter::DownsampleFunction downsample = LumaConverter::getDownsampleFunction(factor);
+  if (!downsample) {
+    throw zxing::IllegalArgumentException("Only 2x and 4x scaling is supported.");
+  }
+  Ref<LuminanceSource>& level = scaled[factor == 2 ? 0 : 1];
+  if (level) {
+    return level;
+  }
+
+  int width = getWidth() / factor;
+  int height = getHeight() / factor;
+  if (width <= 0 || height <= 0) {
+    throw zxing::IllegalArgumentException("Source is too small to scale.");
+  }
+
+  //the level is a complete grey luma buffer, so it is read like any other source but never converted
+  Ref<LumaBuffer> levelBuffer = buffer->takeScaled(width, height);
+  uint8_t* dst = reinterpret_cast<uint8_t*>(&levelBuffer->luma[0]);
+  const uint8_t* rows[4];
+  for (int y = 0; y < height; y++) {
+    for (int r = 0; r < factor; r++) {
+      rows[r] = reinterpret_cast<const uint8_t*>(getLumaRow(top + y * factor + r, left, left + width * factor)) + left;
+    }
+    downsample(rows, dst + static_cast<size_t>(y) * width, width);
+  }
+  levelBuffer->complete = true;
+
+  level = Ref<LuminanceSource>(new FrameLuminanceSource(dst, width, 1, LumaConverter::getRowFunction(FRAME_FORMAT_GREY), std::shared_ptr<const void>(),
+    width, height, false, levelBuffer, 0, 0, width, height));
+  return level;
+}
+
+uint64_t FrameLuminanceSource::getSignature() const {
+  //rows in the order they are stored, only equality matters
+  int firstRow = flipped ? dataHeight - top - getHeight() : top;
+  const uint8_t* planes[1] = { pixels + static_cast<ptrdiff_t>(firstRow) * stride + left * pixelStride };
+  int linesizes[1] = { stride };
+  int rowBytes[1] = { getWidth() * pixelStride };
+  int rows[1] = { getHeight() };
+  return FrameSignature::compute(planes, linesizes, rowBytes, rows, 1, FrameConverter::getBestLevel());
+}
@@ -0,0 +1,102 @@
+#ifndef _FRAME_LUMINANCE_SOURCE_H_
+#define _FRAME_LUMINANCE_SOURCE_H_
+/*
+ *  Copyright 2017 Erik Sundn
+ *
+ *  Based on ImageReaderSource
+ *  Copyright 2010-2011 ZXing authors
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <zxing/LuminanceSource.h>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "CaptureFrame.hpp"
+#include "LumaConverter.hpp"
+
+//Reads the pixels of a frame where they are (any row stride, top-down or bottom-up), nothing is copied.
+//Luminance is converted by the LumaConverter kernels on first use in blocks of a row and kept in a LumaBuffer shared with all crops,
+//so the binarizers of several passes and overlapping regions never convert a pixel twice.
+//getScaled() gives box filtered 2x and 4x levels of a source for the detection pyramid.
+class FrameLuminanceSource : public zxing::LuminanceSource {
+public:
+  //luminance of a whole frame, top-down. Pass the same buffer to create() for every frame to reuse the memory,
+  //it may only back the sources of one frame at a time
+  class LumaBuffer : public zxing::Counted {
+  public:
+    LumaBuffer();
+    void reset(int width, int height);
+
+  private:
+    friend class FrameLuminanceSource;
+
+    //a level buffer for getScaled(), reused from the previous frames when the size matches
+    zxing::Ref<LumaBuffer> takeScaled(int width, int height);
+
+    zxing::ArrayRef<char> luma;
+    std::vector<uint64_t> convertedBlocks; //a bit per block of a row
+    int width;
+    int height;
+    int blockWidth;
+    bool complete;
+    std::vector<zxing::Ref<LumaBuffer> > scaled;
+    std::size_t usedScaled; //by the sources of this frame
+  };
+
+  //frame has to be a LumaConverter format, its planes have to outlive the source unless frame.owner keeps them alive
+  static zxing::Ref<LuminanceSource> create(const FrameView& frame);
+  static zxing::Ref<LuminanceSource> create(const FrameView& frame, zxing::Ref<LumaBuffer> buffer);
+
+  zxing::ArrayRef<char> getRow(int y, zxing::ArrayRef<char> row) const;
+  //the whole frame returns the luma buffer itself, a crop copies its rows once
+  zxing::ArrayRef<char> getMatrix() const;
+
+  //a region of the same image, nothing is copied (coordinates as seen by getRow)
+  bool isCropSupported() const;
+  zxing::Ref<LuminanceSource> crop(int left, int top, int width, int height) const;
+
+  //this source scaled down by factor 2 or 4 (rounded average of factor x factor pixels, partial blocks at the edges are dropped).
+  //Rows are converted and filtered in the same pass, the level is kept and supports crops
+  zxing::Ref<LuminanceSource> getScaled(int factor) const;
+
+  //FrameSignature of the pixels of this region as stored in the frame, nothing is converted
+  uint64_t getSignature() const;
+
+private:
+	typedef LuminanceSource Super;
+
+	FrameLuminanceSource(const uint8_t* pixels, int stride, int pixelStride, LumaConverter::RowFunction rowFunction, const std::shared_ptr<const void>& owner,
+		int dataWidth, int dataHeight, bool flipped,
+		zxing::Ref<LumaBuffer> buffer, int left, int top, int width, int height);
+
+	const uint8_t* pixels;
+	const int stride;
+	const int pixelStride; //bytes per pixel in the first plane
+	const LumaConverter::RowFunction rowFunction;
+	const std::shared_ptr<const void> owner;
+	const int dataWidth; //size of the whole image
+	const int dataHeight;
+	const int left; //of this region in the image
+	const int top;
+	const bool flipped; //rows are stored bottom-up
+	const zxing::Ref<LumaBuffer> buffer;
+	mutable zxing::ArrayRef<char> matrix; //of a crop, once requested
+	mutable zxing::Ref<LuminanceSource> scaled[2]; //2x and 4x, once requested
+
+	//converts the missing blocks of columns [begin, end) of an image row, returns the start of the luma row
+	const char* getLumaRow(int row, int begin, int end) const;
+};
+
+#endif /* _FRAME_LUMINANCE_SOURCE_H_ */
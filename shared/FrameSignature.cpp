@@ -0,0 +1,234 @@
+#include "FrameSignature.hpp"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRAME_SIGNATURE_X86 1
+#include <immintrin.h>
+#endif
+
+//gcc and clang only emit sse4/avx2 code in functions marked for it,
+//msvc accepts the intrinsics anywhere
+#if defined(FRAME_SIGNATURE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE4
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	//Every 32 bit lane is updated with lane = rotl(lane + word * Prime2, 13) * Prime1,
+	//each step is invertible, so one changed word always gives another lane.
+	//Four independent groups of 8 lanes hide the latency of the multiplications.
+	const int LaneCount = 32;
+	const int BlockSize = LaneCount * 4;
+	const uint32_t Prime1 = 0x9E3779B1u;
+	const uint32_t Prime2 = 0x85EBCA77u;
+
+	typedef void(*BlockFunction)(uint32_t * lanes, const uint8_t * data, int blockCount);
+
+	inline uint32_t rotateLeft(uint32_t value, int bits)
+	{
+		return (value << bits) | (value >> (32 - bits));
+	}
+
+	void hashBlocksScalar(uint32_t * lanes, const uint8_t * data, int blockCount)
+	{
+		for (int b = 0; b < blockCount; b++, data += BlockSize)
+		{
+			for (int i = 0; i < LaneCount; i++)
+			{
+				uint32_t word;
+				memcpy(&word, data + i * 4, 4);
+				lanes[i] = rotateLeft(lanes[i] + word * Prime2, 13) * Prime1;
+			}
+		}
+	}
+
+#ifdef FRAME_SIGNATURE_X86
+	TARGET_SSE4 inline __m128i updateLanes(__m128i lanes, const uint8_t * data, __m128i prime1, __m128i prime2)
+	{
+		__m128i words = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+		lanes = _mm_add_epi32(lanes, _mm_mullo_epi32(words, prime2));
+		lanes = _mm_or_si128(_mm_slli_epi32(lanes, 13), _mm_srli_epi32(lanes, 19));
+		return _mm_mullo_epi32(lanes, prime1);
+	}
+
+	TARGET_SSE4 void hashBlocksSSE4(uint32_t * lanes, const uint8_t * data, int blockCount)
+	{
+		const __m128i prime1 = _mm_set1_epi32(static_cast<int>(Prime1));
+		const __m128i prime2 = _mm_set1_epi32(static_cast<int>(Prime2));
+		__m128i state[8];
+		for (int i = 0; i < 8; i++)
+			state[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes + i * 4));
+
+		for (int b = 0; b < blockCount; b++, data += BlockSize)
+		{
+			for (int i = 0; i < 8; i++)
+				state[i] = updateLanes(state[i], data + i * 16, prime1, prime2);
+		}
+
+		for (int i = 0; i < 8; i++)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + i * 4), state[i]);
+	}
+
+	TARGET_AVX2 inline __m256i updateLanes(__m256i lanes, const uint8_t * data, __m256i prime1, __m256i prime2)
+	{
+		__m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+		lanes = _mm256_add_epi32(lanes, _mm256_mullo_epi32(words, prime2));
+		lanes = _mm256_or_si256(_mm256_slli_epi32(lanes, 13), _mm256_srli_epi32(lanes, 19));
+		return _mm256_mullo_epi32(lanes, prime1);
+	}
+
+	TARGET_AVX2 void hashBlocksAVX2(uint32_t * lanes, const uint8_t * data, int blockCount)
+	{
+		const __m256i prime1 = _mm256_set1_epi32(static_cast<int>(Prime1));
+		const __m256i prime2 = _mm256_set1_epi32(static_cast<int>(Prime2));
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + 8));
+		__m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + 16));
+		__m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes + 24));
+
+		for (int i = 0; i < blockCount; i++, data += BlockSize)
+		{
+			a = updateLanes(a, data, prime1, prime2);
+			b = updateLanes(b, data + 32, prime1, prime2);
+			c = updateLanes(c, data + 64, prime1, prime2);
+			d = updateLanes(d, data + 96, prime1, prime2);
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), a);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 8), b);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 16), c);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes + 24), d);
+	}
+#endif
+
+	void initLanes(uint32_t * lanes)
+	{
+		for (int i = 0; i < LaneCount; i++)
+			lanes[i] = Prime1 * static_cast<uint32_t>(i + 1);
+	}
+
+	//one row, the end is hashed as a zero padded block
+	void hashRow(uint32_t * lanes, const uint8_t * row, int bytes, BlockFunction hashBlocks)
+	{
+		int blockCount = bytes / BlockSize;
+		int tailBytes = bytes - blockCount * BlockSize;
+		hashBlocks(lanes, row, blockCount);
+
+		if (tailBytes > 0)
+		{
+			uint8_t tail[BlockSize];
+			memset(tail, 0, BlockSize);
+			memcpy(tail, row + blockCount * BlockSize, tailBytes);
+			hashBlocks(lanes, tail, 1);
+		}
+	}
+
+	//every step is invertible for the lane it takes in
+	uint64_t foldLanes(const uint32_t * lanes, uint64_t seed)
+	{
+		uint64_t signature = seed;
+		for (int i = 0; i < LaneCount; i++)
+		{
+			signature ^= lanes[i];
+			signature *= 0x9E3779B97F4A7C15ull;
+			signature ^= signature >> 29;
+		}
+		return signature;
+	}
+
+	BlockFunction getBlockFunction(ConversionLevel level)
+	{
+		level = level < FrameConverter::getBestLevel() ? level : FrameConverter::getBestLevel();
+#ifdef FRAME_SIGNATURE_X86
+		if (level == CONVERSION_AVX2)
+			return hashBlocksAVX2;
+		if (level == CONVERSION_SSE4)
+			return hashBlocksSSE4;
+#endif
+		return hashBlocksScalar;
+	}
+}
+
+uint64_t FrameSignature::compute(const FrameView & frame, ConversionLevel level)
+{
+	int rowBytes[4];
+	int rows[4];
+	int planeCount = frame.getPlaneCount();
+	for (int p = 0; p < planeCount; p++)
+	{
+		rowBytes[p] = getFramePlaneRowBytes(frame.format, p, frame.width);
+		rows[p] = getFramePlaneHeight(frame.format, p, frame.height);
+	}
+	return compute(frame.planes, frame.linesizes, rowBytes, rows, planeCount, level);
+}
+
+uint64_t FrameSignature::compute(const FrameView & frame)
+{
+	return compute(frame, FrameConverter::getBestLevel());
+}
+
+uint64_t FrameSignature::compute(const uint8_t * const planes[], const int linesizes[], const int rowBytes[], const int rows[], int planeCount, ConversionLevel level)
+{
+	BlockFunction hashBlocks = getBlockFunction(level);
+
+	uint32_t lanes[LaneCount];
+	initLanes(lanes);
+
+	for (int p = 0; p < planeCount; p++)
+	{
+		if (!planes[p])
+			continue;
+
+		for (int y = 0; y < rows[p]; y++)
+			hashRow(lanes, planes[p] + static_cast<std::ptrdiff_t>(y) * linesizes[p], rowBytes[p], hashBlocks);
+	}
+
+	return foldLanes(lanes, static_cast<uint64_t>(planeCount));
+}
+
+bool FrameSignature::computeTiles(const FrameView & frame, int tileSize, std::vector<uint64_t> & signatures, ConversionLevel level)
+{
+	if (frame.getPlaneCount() != 1 || !frame.planes[0] || tileSize <= 0 || frame.width <= 0)
+		return false;
+
+	BlockFunction hashBlocks = getBlockFunction(level);
+	int bytesPerPixel = getFramePlaneRowBytes(frame.format, 0, frame.width) / frame.width;
+	int tilesX, tilesY;
+	getTileCount(frame.width, frame.height, tileSize, tilesX, tilesY);
+	signatures.resize(static_cast<std::size_t>(tilesX) * tilesY);
+
+	//a row of tiles is hashed row by row, so memory is read in order
+	std::vector<uint32_t> lanes(static_cast<std::size_t>(tilesX) * LaneCount);
+	for (int ty = 0; ty < tilesY; ty++)
+	{
+		for (int tx = 0; tx < tilesX; tx++)
+			initLanes(&lanes[tx * LaneCount]);
+
+		int lastRow = (ty + 1) * tileSize < frame.height ? (ty + 1) * tileSize : frame.height;
+		for (int y = ty * tileSize; y < lastRow; y++)
+		{
+			const uint8_t * row = frame.planes[0] + static_cast<std::ptrdiff_t>(y) * frame.linesizes[0];
+			for (int tx = 0; tx < tilesX; tx++)
+			{
+				int x = tx * tileSize;
+				int width = x + tileSize < frame.width ? tileSize : frame.width - x;
+				hashRow(&lanes[tx * LaneCount], row + x * bytesPerPixel, width * bytesPerPixel, hashBlocks);
+			}
+		}
+
+		for (int tx = 0; tx < tilesX; tx++)
+			signatures[ty * tilesX + tx] = foldLanes(&lanes[tx * LaneCount], 1);
+	}
+
+	return true;
+}
+
+void FrameSignature::getTileCount(int width, int height, int tileSize, int & tilesX, int & tilesY)
+{
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+}
@@ -0,0 +1,25 @@
+#ifndef __FRAME_SIGNATURE_
+#define __FRAME_SIGNATURE_
+
+#include <vector>
+#include "CaptureFrame.hpp"
+#include "FrameConverter.hpp"
+
+//64 bit signature of the pixels of a frame, used to find frames that are equal to the previous one.
+//Every byte is hashed (nothing is sampled), so a change of a single pixel always changes the signature.
+//Rows are hashed in 128 byte blocks over 32 lanes, every level gives the same signature.
+class FrameSignature
+{
+public:
+	static uint64_t compute(const FrameView & frame, ConversionLevel level);
+	static uint64_t compute(const FrameView & frame);
+	//planes described by their bytes per row and number of rows, for formats without a FramePixelFormat
+	static uint64_t compute(const uint8_t * const planes[], const int linesizes[], const int rowBytes[], const int rows[], int planeCount, ConversionLevel level);
+
+	//one signature per tile of tileSize x tileSize pixels (row by row, edge tiles are smaller),
+	//only for single plane formats
+	static bool computeTiles(const FrameView & frame, int tileSize, std::vector<uint64_t> & signatures, ConversionLevel level);
+	static void getTileCount(int width, int height, int tileSize, int & tilesX, int & tilesY);
+};
+
+#endif
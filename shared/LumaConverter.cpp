@@ -0,0 +1,383 @@
+#include "LumaConverter.hpp"
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LUMA_CONVERTER_X86 1
+#include <immintrin.h>
+#endif
+
+//gcc and clang only emit sse4/avx2 code in functions marked for it,
+//msvc accepts the intrinsics anywhere
+#if defined(LUMA_CONVERTER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE4 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE4
+#define TARGET_AVX2
+#endif
+
+namespace
+{
+	//b, g, r (and a) bytes of a pixel, the weights sum to 1024
+	template<int Bpp>
+	void rgbRowScalar(const uint8_t * src, uint8_t * dst, int width)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const uint8_t * pixel = src + x * Bpp;
+			dst[x] = static_cast<uint8_t>((306 * pixel[2] + 601 * pixel[1] + 117 * pixel[0] + 0x200) >> 10);
+		}
+	}
+
+	//packed 4:2:2, y of every pixel at 2 * x + YOffset
+	template<int YOffset>
+	void packedYRowScalar(const uint8_t * src, uint8_t * dst, int width)
+	{
+		for (int x = 0; x < width; x++)
+			dst[x] = src[x * 2 + YOffset];
+	}
+
+	//grey and the y plane of nv12 already are the luminance
+	void planarYRow(const uint8_t * src, uint8_t * dst, int width)
+	{
+		memcpy(dst, src, width);
+	}
+
+	template<int Factor>
+	void downsampleRowScalar(const uint8_t * const * rows, uint8_t * dst, int x, int dstWidth)
+	{
+		for (; x < dstWidth; x++)
+		{
+			int sum = 0;
+			for (int r = 0; r < Factor; r++)
+			{
+				for (int c = 0; c < Factor; c++)
+					sum += rows[r][x * Factor + c];
+			}
+			dst[x] = static_cast<uint8_t>((sum + Factor * Factor / 2) / (Factor * Factor));
+		}
+	}
+
+	template<int Factor>
+	void downsampleRowScalar(const uint8_t * const * rows, uint8_t * dst, int dstWidth)
+	{
+		downsampleRowScalar<Factor>(rows, dst, 0, dstWidth);
+	}
+
+#ifdef LUMA_CONVERTER_X86
+	// ---------------- SSE4, 16 pixels per step ----------------
+
+	//two registers of two pixels with 16 bit b, g, r, a to the 32 bit luminance of the four pixels.
+	//madd gives 117 b + 601 g and 306 r per pixel, hadd adds them up
+	TARGET_SSE4 inline __m128i luma4(__m128i first, __m128i second)
+	{
+		const __m128i weights = _mm_setr_epi16(117, 601, 306, 0, 117, 601, 306, 0);
+		__m128i sums = _mm_hadd_epi32(_mm_madd_epi16(first, weights), _mm_madd_epi16(second, weights));
+		return _mm_srli_epi32(_mm_add_epi32(sums, _mm_set1_epi32(0x200)), 10);
+	}
+
+	TARGET_SSE4 inline void store16(uint8_t * dst, __m128i l0, __m128i l1, __m128i l2, __m128i l3)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(_mm_packs_epi32(l0, l1), _mm_packs_epi32(l2, l3)));
+	}
+
+	//four pixels out of a 16 byte load of which 12 are used, shuffled straight to 16 bit
+	TARGET_SSE4 inline __m128i bgrLuma4(const uint8_t * src)
+	{
+		const __m128i firstMask = _mm_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1);
+		const __m128i secondMask = _mm_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1);
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		return luma4(_mm_shuffle_epi8(pixels, firstMask), _mm_shuffle_epi8(pixels, secondMask));
+	}
+
+	TARGET_SSE4 inline __m128i bgraLuma4(const uint8_t * src)
+	{
+		__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		return luma4(_mm_unpacklo_epi8(pixels, _mm_setzero_si128()), _mm_unpackhi_epi8(pixels, _mm_setzero_si128()));
+	}
+
+	TARGET_SSE4 void bgrRowSSE4(const uint8_t * src, uint8_t * dst, int width)
+	{
+		int x = 0;
+		//the last load reads 4 bytes past the 16 pixels
+		for (; x + 18 <= width; x += 16)
+		{
+			const uint8_t * s = src + x * 3;
+			store16(dst + x, bgrLuma4(s), bgrLuma4(s + 12), bgrLuma4(s + 24), bgrLuma4(s + 36));
+		}
+		rgbRowScalar<3>(src + x * 3, dst + x, width - x);
+	}
+
+	TARGET_SSE4 void bgraRowSSE4(const uint8_t * src, uint8_t * dst, int width)
+	{
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const uint8_t * s = src + x * 4;
+			store16(dst + x, bgraLuma4(s), bgraLuma4(s + 16), bgraLuma4(s + 32), bgraLuma4(s + 48));
+		}
+		rgbRowScalar<4>(src + x * 4, dst + x, width - x);
+	}
+
+	template<int YOffset>
+	TARGET_SSE4 inline __m128i packedY8(const uint8_t * src)
+	{
+		__m128i pairs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		return YOffset == 0 ? _mm_and_si128(pairs, _mm_set1_epi16(0xFF)) : _mm_srli_epi16(pairs, 8);
+	}
+
+	template<int YOffset>
+	TARGET_SSE4 void packedYRowSSE4(const uint8_t * src, uint8_t * dst, int width)
+	{
+		int x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			const uint8_t * s = src + x * 2;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(packedY8<YOffset>(s), packedY8<YOffset>(s + 16)));
+		}
+		packedYRowScalar<YOffset>(src + x * 2, dst + x, width - x);
+	}
+
+	//maddubs with ones adds neighbouring pixels to 16 bit, 16 x 255 still fits
+	TARGET_SSE4 void downsampleRow2SSE4(const uint8_t * const * rows, uint8_t * dst, int dstWidth)
+	{
+		const __m128i ones = _mm_set1_epi8(1);
+		int x = 0;
+		for (; x + 16 <= dstWidth; x += 16)
+		{
+			__m128i first = _mm_setzero_si128();
+			__m128i second = _mm_setzero_si128();
+			for (int r = 0; r < 2; r++)
+			{
+				const uint8_t * s = rows[r] + x * 2;
+				first = _mm_add_epi16(first, _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), ones));
+				second = _mm_add_epi16(second, _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16)), ones));
+			}
+			first = _mm_srli_epi16(_mm_add_epi16(first, _mm_set1_epi16(2)), 2);
+			second = _mm_srli_epi16(_mm_add_epi16(second, _mm_set1_epi16(2)), 2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(first, second));
+		}
+		downsampleRowScalar<2>(rows, dst, x, dstWidth);
+	}
+
+	//pairs as above, hadd adds the pairs to groups of four
+	TARGET_SSE4 void downsampleRow4SSE4(const uint8_t * const * rows, uint8_t * dst, int dstWidth)
+	{
+		const __m128i ones = _mm_set1_epi8(1);
+		int x = 0;
+		for (; x + 16 <= dstWidth; x += 16)
+		{
+			__m128i first = _mm_setzero_si128();
+			__m128i second = _mm_setzero_si128();
+			for (int r = 0; r < 4; r++)
+			{
+				const uint8_t * s = rows[r] + x * 4;
+				__m128i p0 = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)), ones);
+				__m128i p1 = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16)), ones);
+				__m128i p2 = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32)), ones);
+				__m128i p3 = _mm_maddubs_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48)), ones);
+				first = _mm_add_epi16(first, _mm_hadd_epi16(p0, p1));
+				second = _mm_add_epi16(second, _mm_hadd_epi16(p2, p3));
+			}
+			first = _mm_srli_epi16(_mm_add_epi16(first, _mm_set1_epi16(8)), 4);
+			second = _mm_srli_epi16(_mm_add_epi16(second, _mm_set1_epi16(8)), 4);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(first, second));
+		}
+		downsampleRowScalar<4>(rows, dst, x, dstWidth);
+	}
+
+	// ---------------- AVX2, 32 pixels per step ----------------
+
+	//as luma4, the pixels of the low lane come first
+	TARGET_AVX2 inline __m256i luma8(__m256i first, __m256i second)
+	{
+		const __m256i weights = _mm256_setr_epi16(117, 601, 306, 0, 117, 601, 306, 0, 117, 601, 306, 0, 117, 601, 306, 0);
+		__m256i sums = _mm256_hadd_epi32(_mm256_madd_epi16(first, weights), _mm256_madd_epi16(second, weights));
+		return _mm256_srli_epi32(_mm256_add_epi32(sums, _mm256_set1_epi32(0x200)), 10);
+	}
+
+	//the packs work per lane, the permute puts the groups of 4 pixels back in order
+	TARGET_AVX2 inline void store32(uint8_t * dst, __m256i l0, __m256i l1, __m256i l2, __m256i l3)
+	{
+		__m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(l0, l1), _mm256_packs_epi32(l2, l3));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+	}
+
+	TARGET_AVX2 inline __m256i bgrLuma8(const uint8_t * src)
+	{
+		const __m256i firstMask = _mm256_setr_epi8(0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1,
+			0, -1, 1, -1, 2, -1, -1, -1, 3, -1, 4, -1, 5, -1, -1, -1);
+		const __m256i secondMask = _mm256_setr_epi8(6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1,
+			6, -1, 7, -1, 8, -1, -1, -1, 9, -1, 10, -1, 11, -1, -1, -1);
+		__m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))),
+			_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12)), 1);
+		return luma8(_mm256_shuffle_epi8(pixels, firstMask), _mm256_shuffle_epi8(pixels, secondMask));
+	}
+
+	TARGET_AVX2 inline __m256i bgraLuma8(const uint8_t * src)
+	{
+		__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		return luma8(_mm256_unpacklo_epi8(pixels, _mm256_setzero_si256()), _mm256_unpackhi_epi8(pixels, _mm256_setzero_si256()));
+	}
+
+	TARGET_AVX2 void bgrRowAVX2(const uint8_t * src, uint8_t * dst, int width)
+	{
+		int x = 0;
+		//the last load reads 4 bytes past the 32 pixels
+		for (; x + 34 <= width; x += 32)
+		{
+			const uint8_t * s = src + x * 3;
+			store32(dst + x, bgrLuma8(s), bgrLuma8(s + 24), bgrLuma8(s + 48), bgrLuma8(s + 72));
+		}
+		_mm256_zeroupper();
+		bgrRowSSE4(src + x * 3, dst + x, width - x);
+	}
+
+	TARGET_AVX2 void bgraRowAVX2(const uint8_t * src, uint8_t * dst, int width)
+	{
+		int x = 0;
+		for (; x + 32 <= width; x += 32)
+		{
+			const uint8_t * s = src + x * 4;
+			store32(dst + x, bgraLuma8(s), bgraLuma8(s + 32), bgraLuma8(s + 64), bgraLuma8(s + 96));
+		}
+		_mm256_zeroupper();
+		bgraRowSSE4(src + x * 4, dst + x, width - x);
+	}
+
+	template<int YOffset>
+	TARGET_AVX2 inline __m256i packedY16(const uint8_t * src)
+	{
+		__m256i pairs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		return YOffset == 0 ? _mm256_and_si256(pairs, _mm256_set1_epi16(0xFF)) : _mm256_srli_epi16(pairs, 8);
+	}
+
+	template<int YOffset>
+	TARGET_AVX2 void packedYRowAVX2(const uint8_t * src, uint8_t * dst, int width)
+	{
+		int x = 0;
+		for (; x + 32 <= width; x += 32)
+		{
+			const uint8_t * s = src + x * 2;
+			__m256i packed = _mm256_packus_epi16(packedY16<YOffset>(s), packedY16<YOffset>(s + 32));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), _mm256_permute4x64_epi64(packed, 0xD8));
+		}
+		_mm256_zeroupper();
+		packedYRowSSE4<YOffset>(src + x * 2, dst + x, width - x);
+	}
+#endif
+}
+
+bool LumaConverter::isSupported(FramePixelFormat format)
+{
+	return getPixelStride(format) > 0;
+}
+
+int LumaConverter::getPixelStride(FramePixelFormat format)
+{
+	switch (format)
+	{
+	case FRAME_FORMAT_BGR24: return 3;
+	case FRAME_FORMAT_BGRA: return 4;
+	case FRAME_FORMAT_YUYV422: return 2;
+	case FRAME_FORMAT_UYVY422: return 2;
+	case FRAME_FORMAT_NV12: return 1;
+	case FRAME_FORMAT_GREY: return 1;
+	default: return 0;
+	}
+}
+
+LumaConverter::RowFunction LumaConverter::getRowFunction(FramePixelFormat format, ConversionLevel level)
+{
+	if (level > FrameConverter::getBestLevel())
+		level = FrameConverter::getBestLevel();
+
+	switch (format)
+	{
+	case FRAME_FORMAT_BGR24:
+#ifdef LUMA_CONVERTER_X86
+		if (level == CONVERSION_AVX2)
+			return bgrRowAVX2;
+		if (level == CONVERSION_SSE4)
+			return bgrRowSSE4;
+#endif
+		return rgbRowScalar<3>;
+	case FRAME_FORMAT_BGRA:
+#ifdef LUMA_CONVERTER_X86
+		if (level == CONVERSION_AVX2)
+			return bgraRowAVX2;
+		if (level == CONVERSION_SSE4)
+			return bgraRowSSE4;
+#endif
+		return rgbRowScalar<4>;
+	case FRAME_FORMAT_YUYV422:
+#ifdef LUMA_CONVERTER_X86
+		if (level == CONVERSION_AVX2)
+			return packedYRowAVX2<0>;
+		if (level == CONVERSION_SSE4)
+			return packedYRowSSE4<0>;
+#endif
+		return packedYRowScalar<0>;
+	case FRAME_FORMAT_UYVY422:
+#ifdef LUMA_CONVERTER_X86
+		if (level == CONVERSION_AVX2)
+			return packedYRowAVX2<1>;
+		if (level == CONVERSION_SSE4)
+			return packedYRowSSE4<1>;
+#endif
+		return packedYRowScalar<1>;
+	case FRAME_FORMAT_NV12:
+	case FRAME_FORMAT_GREY:
+		return planarYRow;
+	default:
+		return nullptr;
+	}
+}
+
+LumaConverter::RowFunction LumaConverter::getRowFunction(FramePixelFormat format)
+{
+	return getRowFunction(format, FrameConverter::getBestLevel());
+}
+
+LumaConverter::DownsampleFunction LumaConverter::getDownsampleFunction(int factor, ConversionLevel level)
+{
+	if (level > FrameConverter::getBestLevel())
+		level = FrameConverter::getBestLevel();
+
+	switch (factor)
+	{
+	case 2:
+#ifdef LUMA_CONVERTER_X86
+		if (level >= CONVERSION_SSE4)
+			return downsampleRow2SSE4;
+#endif
+		return downsampleRowScalar<2>;
+	case 4:
+#ifdef LUMA_CONVERTER_X86
+		if (level >= CONVERSION_SSE4)
+			return downsampleRow4SSE4;
+#endif
+		return downsampleRowScalar<4>;
+	default:
+		return nullptr;
+	}
+}
+
+LumaConverter::DownsampleFunction LumaConverter::getDownsampleFunction(int factor)
+{
+	return getDownsampleFunction(factor, FrameConverter::getBestLevel());
+}
+
+bool LumaConverter::convert(const FrameView & src, uint8_t * dst, ConversionLevel level)
+{
+	RowFunction rowFunction = getRowFunction(src.format, level);
+	if (!rowFunction || !src.planes[0] || src.width <= 0 || src.height <= 0)
+		return false;
+
+	for (int y = 0; y < src.height; y++)
+	{
+		int row = src.orientation == FRAME_TOP_DOWN ? y : src.height - 1 - y;
+		rowFunction(src.planes[0] + static_cast<std::ptrdiff_t>(row) * src.linesizes[0], dst + static_cast<std::size_t>(y) * src.width, src.width);
+	}
+	return true;
+}
@@ -0,0 +1,34 @@
+#ifndef __LUMA_CONVERTER_
+#define __LUMA_CONVERTER_
+
+#include "CaptureFrame.hpp"
+#include "FrameConverter.hpp"
+
+//Luminance rows for the QR detection, hand-vectorized like the FrameConverter kernels.
+//BGR24 and BGRA use the zxing weights (306 * r + 601 * g + 117 * b + 512) >> 10 on every level,
+//YUYV422, UYVY422, NV12 and grey frames give their Y samples without arithmetic.
+//Luminance rows are scaled down 2x or 4x with a box filter for the detection pyramid.
+class LumaConverter
+{
+public:
+	typedef void(*RowFunction)(const uint8_t * src, uint8_t * dst, int width);
+	//factor rows of at least dstWidth * factor pixels into one row, rounded average of factor x factor pixels
+	typedef void(*DownsampleFunction)(const uint8_t * const * rows, uint8_t * dst, int dstWidth);
+
+	static bool isSupported(FramePixelFormat format);
+	//bytes from one pixel to the next in the first plane, 0 if not supported
+	static int getPixelStride(FramePixelFormat format);
+
+	//levels above FrameConverter::getBestLevel() are lowered, nullptr if the format is not supported
+	static RowFunction getRowFunction(FramePixelFormat format, ConversionLevel level);
+	static RowFunction getRowFunction(FramePixelFormat format);
+
+	//factor 2 or 4, nullptr otherwise. There is no avx2 version, it uses sse4
+	static DownsampleFunction getDownsampleFunction(int factor, ConversionLevel level);
+	static DownsampleFunction getDownsampleFunction(int factor);
+
+	//whole frame into width * height bytes, top-down whatever the orientation of src
+	static bool convert(const FrameView & src, uint8_t * dst, ConversionLevel level);
+};
+
+#endif
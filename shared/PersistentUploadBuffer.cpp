@@ -0,0 +1,278 @@
+#include "PersistentUploadBuffer.hpp"
+#include <string.h>
+
+PersistentUploadBuffer::PersistentUploadBuffer()
+{
+	mBuffer = 0;
+	mMappedPtr = nullptr;
+	mPersistent = false;
+	mRangeSize = 0;
+	mCurrentRange = -1;
+	mWriting = false;
+
+	mInited = false;
+	mFenceWaits = 0;
+	mFenceWaitTime = 0.0;
+}
+
+PersistentUploadBuffer::~PersistentUploadBuffer()
+{
+}
+
+bool PersistentUploadBuffer::init(std::size_t rangeSize, std::size_t rangeCount, bool usePersistentMapping)
+{
+	cleanup();
+
+	if (rangeSize == 0 || rangeCount == 0)
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Invalid upload buffer size!\n");
+		return false;
+	}
+
+	//keep every range start aligned for fast transfers
+	mRangeSize = (rangeSize + 255) & ~static_cast<std::size_t>(255);
+	mFences.assign(rangeCount, static_cast<GLsync>(0));
+	mCurrentRange = -1;
+	mWriting = false;
+
+	GLsizeiptr bufferSize = static_cast<GLsizeiptr>(mRangeSize * rangeCount);
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+
+	mPersistent = usePersistentMapping && isBufferStorageSupported();
+	if (mPersistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bufferSize, 0, flags);
+		mMappedPtr = reinterpret_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bufferSize, flags));
+		if (!mMappedPtr)
+		{
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_WARNING, "Persistent mapping of upload buffer failed, mapping per frame instead.\n");
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &mBuffer);
+			glGenBuffers(1, &mBuffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+			mPersistent = false;
+		}
+	}
+
+	if (!mPersistent)
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, bufferSize, 0, GL_STREAM_DRAW);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	mFenceWaits = 0;
+	mFenceWaitTime = 0.0;
+	mInited = true;
+
+	sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "Upload buffer with %u ranges of %u bytes (%s)\n",
+		static_cast<unsigned int>(rangeCount), static_cast<unsigned int>(mRangeSize), mPersistent ? "persistent" : "mapped per frame");
+
+	return true;
+}
+
+void PersistentUploadBuffer::cleanup()
+{
+	if (!mInited)
+		return;
+
+	mInited = false;
+
+	for (std::size_t i = 0; i < mFences.size(); i++)
+	{
+		if (mFences[i])
+			glDeleteSync(mFences[i]);
+	}
+	mFences.clear();
+
+	if (mBuffer)
+	{
+		if (mMappedPtr || mWriting)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &mBuffer);
+		mBuffer = 0;
+	}
+
+	mMappedPtr = nullptr;
+	mWriting = false;
+}
+
+bool PersistentUploadBuffer::isInited() const
+{
+	return mInited;
+}
+
+bool PersistentUploadBuffer::isPersistent() const
+{
+	return mPersistent;
+}
+
+unsigned char * PersistentUploadBuffer::beginWrite()
+{
+	if (!mInited)
+		return nullptr;
+
+	mCurrentRange = (mCurrentRange + 1) % static_cast<int>(mFences.size());
+
+	//wait until the GPU has copied the previous content of this range
+	GLsync & fence = mFences[mCurrentRange];
+	if (fence)
+	{
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status == GL_TIMEOUT_EXPIRED)
+		{
+			double waitStart = sgct::Engine::getTime();
+			mFenceWaits++;
+			do
+			{
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); //1 ms
+			} while (status == GL_TIMEOUT_EXPIRED);
+			mFenceWaitTime = mFenceWaitTime + (sgct::Engine::getTime() - waitStart);
+		}
+		glDeleteSync(fence);
+		fence = 0;
+	}
+
+	GLintptr offset = static_cast<GLintptr>(mRangeSize * mCurrentRange);
+	unsigned char * ptr = nullptr;
+	if (mPersistent)
+	{
+		ptr = mMappedPtr + offset;
+	}
+	else
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+		ptr = reinterpret_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, static_cast<GLsizeiptr>(mRangeSize),
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		if (!ptr)
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Failed to map upload buffer!\n");
+	}
+
+	mWriting = (ptr != nullptr);
+	return ptr;
+}
+
+void PersistentUploadBuffer::upload(GLuint texture, int width, int height, GLenum format, GLenum type)
+{
+	upload([&](const unsigned char * data) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, format, type, data);
+	});
+}
+
+void PersistentUploadBuffer::upload(const std::function<void(const unsigned char * data)> & uploadFunction)
+{
+	if (!mWriting)
+		return;
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+	if (!mPersistent)
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	mWriting = false;
+
+	uploadFunction(reinterpret_cast<const unsigned char*>(mRangeSize * mCurrentRange));
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	//the range may be reused when the copy into the texture is done
+	mFences[mCurrentRange] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void PersistentUploadBuffer::cancelWrite()
+{
+	if (!mWriting)
+		return;
+
+	if (!mPersistent)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	mWriting = false;
+}
+
+bool PersistentUploadBuffer::write(GLuint texture, const FrameView & frame)
+{
+	GLenum format, type;
+	if (!getTextureFormat(frame.format, format, type) || frame.getDataSize() > mRangeSize)
+		return false;
+
+	unsigned char * ptr = beginWrite();
+	if (!ptr)
+		return false;
+
+	frame.copyTo(ptr);
+	upload(texture, frame.width, frame.height, format, type);
+	return true;
+}
+
+std::size_t PersistentUploadBuffer::getRangeSize() const
+{
+	return mRangeSize;
+}
+
+std::size_t PersistentUploadBuffer::getNumberOfFenceWaits() const
+{
+	return mFenceWaits;
+}
+
+double PersistentUploadBuffer::getFenceWaitTime() const
+{
+	return mFenceWaitTime;
+}
+
+bool PersistentUploadBuffer::isBufferStorageSupported()
+{
+	GLint major = 0;
+	GLint minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return true;
+
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++)
+	{
+		const char * extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+		if (extension && strcmp(extension, "GL_ARB_buffer_storage") == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool PersistentUploadBuffer::getTextureFormat(FramePixelFormat format, GLenum & glFormat, GLenum & glType)
+{
+	glType = GL_UNSIGNED_BYTE;
+	switch (format)
+	{
+	case FRAME_FORMAT_BGR24:
+		glFormat = GL_BGR;
+		return true;
+	case FRAME_FORMAT_RGB24:
+		glFormat = GL_RGB;
+		return true;
+	case FRAME_FORMAT_BGRA:
+		glFormat = GL_BGRA;
+		return true;
+	case FRAME_FORMAT_GREY:
+		glFormat = GL_RED;
+		return true;
+	case FRAME_FORMAT_RGB565:
+		glFormat = GL_RGB;
+		glType = GL_UNSIGNED_SHORT_5_6_5;
+		return true;
+	default:
+		glFormat = GL_NONE;
+		return false;
+	}
+}
@@ -0,0 +1,55 @@
+#ifndef __PERSISTENT_UPLOAD_BUFFER_
+#define __PERSISTENT_UPLOAD_BUFFER_
+
+#include <sgct.h>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include "CaptureFrame.hpp"
+
+//Pixel upload buffer split into fenced ranges.
+//With glBufferStorage the buffer is mapped once (persistent and coherent),
+//so a frame is written straight into memory the GPU reads from without any per frame map calls.
+//Without it each range is mapped unsynchronized, which is safe as the ranges are fenced.
+class PersistentUploadBuffer
+{
+public:
+	PersistentUploadBuffer();
+	~PersistentUploadBuffer();
+
+	bool init(std::size_t rangeSize, std::size_t rangeCount, bool usePersistentMapping = true);
+	void cleanup();
+	bool isInited() const;
+	bool isPersistent() const;
+
+	//write a frame into the next free range and upload it to the texture (same thread and context)
+	unsigned char * beginWrite();
+	void upload(GLuint texture, int width, int height, GLenum format, GLenum type);
+	//calls uploadFunction with the range as offset into the bound pixel unpack buffer
+	void upload(const std::function<void(const unsigned char * data)> & uploadFunction);
+	void cancelWrite();
+	bool write(GLuint texture, const FrameView & frame);
+
+	std::size_t getRangeSize() const;
+	std::size_t getNumberOfFenceWaits() const;
+	double getFenceWaitTime() const;
+
+	static bool isBufferStorageSupported();
+	//pixel transfer format of a single plane frame, false if it can't be uploaded as is, YUV frames go through YUVConversionPass
+	static bool getTextureFormat(FramePixelFormat format, GLenum & glFormat, GLenum & glType);
+
+private:
+	GLuint mBuffer;
+	unsigned char * mMappedPtr;
+	bool mPersistent;
+	std::size_t mRangeSize;
+	std::vector<GLsync> mFences;
+	int mCurrentRange;
+	bool mWriting;
+
+	std::atomic<bool> mInited;
+	std::atomic<std::size_t> mFenceWaits;
+	std::atomic<double> mFenceWaitTime;
+};
+
+#endif
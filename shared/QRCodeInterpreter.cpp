@@ -20,6 +20,8 @@
 #include "QRCodeInterpreter.h"
 #include <string>
 #include <sstream>
+#include <chrono>
+#include <algorithm>
 #include <sgct.h>
 #include <zxing/Binarizer.h>
 #include <zxing/Result.h>
@@ -27,6 +29,7 @@
 #include <zxing/common/GlobalHistogramBinarizer.h>
 #include <zxing/common/HybridBinarizer.h>
 #include <zxing/DecodeHints.h>
+#include <zxing/ResultPointCallback.h>
 #include <exception>
 #include <zxing/Exception.h>
 #include <zxing/common/IllegalArgumentException.h>
@@ -37,6 +40,38 @@ using namespace zxing;
 using namespace zxing::qrcode;
 using namespace zxing::multi;
 
+namespace {
+	//counts the possible finder (and alignment) pattern centers found while detecting
+	class PatternCounter : public ResultPointCallback {
+	public:
+		PatternCounter() : count(0) {}
+		void foundPossibleResultPoint(ResultPoint const&) {
+			count++;
+		}
+
+		int count;
+	};
+
+	//a code needs its three finder patterns
+	const int FinderPatternsPerCode = 3;
+
+	std::size_t countUniqueTexts(const std::vector<QRCodeDetection> & first, const std::vector<QRCodeDetection> & second) {
+		std::vector<std::string> texts;
+		for (size_t i = 0; i < first.size(); i++) {
+			texts.push_back(first[i].text);
+		}
+		for (size_t i = 0; i < second.size(); i++) {
+			texts.push_back(second[i].text);
+		}
+		std::sort(texts.begin(), texts.end());
+		return std::unique(texts.begin(), texts.end()) - texts.begin();
+	}
+
+	std::size_t countUniqueTexts(const std::vector<QRCodeDetection> & detections) {
+		return countUniqueTexts(detections, std::vector<QRCodeDetection>());
+	}
+}
+
 std::string QRCodeInterpreter::decodeImage(Ref<LuminanceSource> source, bool print_exceptions, bool hybrid, bool tryhard) {
 	try {
 		Ref<Binarizer> binarizer;
@@ -80,6 +115,16 @@ std::string QRCodeInterpreter::decodeImage(Ref<LuminanceSource> source, bool pri
 
 std::vector<std::string> QRCodeInterpreter::decodeImageMulti(Ref<LuminanceSource> source, bool print_exceptions, bool hybrid, bool tryhard) {
 	std::vector<std::string> textResults;
+	std::vector<QRCodeDetection> detections = detectImageMulti(source, print_exceptions, hybrid, tryhard);
+	for (size_t i = 0; i < detections.size(); i++) {
+		textResults.push_back(detections[i].text);
+	}
+	return textResults;
+}
+
+std::vector<QRCodeDetection> QRCodeInterpreter::detectImageMulti(Ref<LuminanceSource> source, bool print_exceptions, bool hybrid, bool tryhard, int * finder_patterns) {
+	std::vector<QRCodeDetection> detections;
+	Ref<PatternCounter> patternCounter(new PatternCounter);
 	try {
 		Ref<Binarizer> binarizer;
 		if (hybrid) {
@@ -91,6 +136,9 @@ std::vector<std::string> QRCodeInterpreter::decodeImageMulti(Ref<LuminanceSource
 
 		DecodeHints hints(DecodeHints::QR_CODE_HINT);
 		hints.setTryHarder(tryhard);
+		if (finder_patterns) {
+			hints.setResultPointCallback(patternCounter);
+		}
 
 		Ref<BinaryBitmap> binary(new BinaryBitmap(binarizer));
 
@@ -99,7 +147,28 @@ std::vector<std::string> QRCodeInterpreter::decodeImageMulti(Ref<LuminanceSource
 		std::vector<Ref<Result> > results = reader->decodeMultiple(binary, hints);
 
 		for each(Ref<Result> result in results) {
-			textResults.push_back(result->getText()->getText());
+			QRCodeDetection detection;
+			detection.text = result->getText()->getText();
+			detection.left = detection.top = 0.f;
+			detection.right = static_cast<float>(source->getWidth());
+			detection.bottom = static_cast<float>(source->getHeight());
+
+			ArrayRef< Ref<ResultPoint> > & points = result->getResultPoints();
+			for (int i = 0; points && i < points->size(); i++) {
+				float x = points[i]->getX();
+				float y = points[i]->getY();
+				if (i == 0) {
+					detection.left = detection.right = x;
+					detection.top = detection.bottom = y;
+				}
+				else {
+					detection.left = x < detection.left ? x : detection.left;
+					detection.right = x > detection.right ? x : detection.right;
+					detection.top = y < detection.top ? y : detection.top;
+					detection.bottom = y > detection.bottom ? y : detection.bottom;
+				}
+			}
+			detections.push_back(detection);
 		}
 	}
 	catch (const ReaderException& e) {
@@ -119,5 +188,171 @@ std::vector<std::string> QRCodeInterpreter::decodeImageMulti(Ref<LuminanceSource
 			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "std::exception: %s\n", e.what());
 	}
 
-	return textResults;
+	if (finder_patterns) {
+		*finder_patterns = patternCounter->count;
+	}
+	return detections;
+}
+
+QRDecoderSelector::QRDecoderSelector() {
+	adaptive = false;
+	recallThreshold = 0.95;
+	explorationInterval = 50;
+	detections = 0;
+	nextExplored = 0;
+	selected = 0;
+	explorations = 0;
+	for (int i = 0; i < ConfigCount; i++) {
+		stats[i].runs = 0;
+		stats[i].comparedFrames = 0;
+		stats[i].hits = 0;
+		stats[i].recall = 1.0;
+		stats[i].timePerMegapixel = 0.0;
+	}
+}
+
+void QRDecoderSelector::setAdaptive(bool enabled) {
+	adaptive = enabled;
+}
+
+bool QRDecoderSelector::isAdaptive() const {
+	return adaptive;
+}
+
+void QRDecoderSelector::setConfig(int config) {
+	if (config >= 0 && config < ConfigCount) {
+		std::lock_guard<std::mutex> lock(mutex);
+		selected = config;
+	}
+}
+
+void QRDecoderSelector::setRecallThreshold(double recall) {
+	recallThreshold = recall;
+}
+
+double QRDecoderSelector::getRecallThreshold() const {
+	return recallThreshold;
+}
+
+void QRDecoderSelector::setExplorationInterval(std::size_t detections_) {
+	explorationInterval = detections_;
+}
+
+std::vector<QRCodeDetection> QRDecoderSelector::detect(Ref<LuminanceSource> source, int * finder_patterns) {
+	int current = getSelectedConfig();
+	int patterns = 0;
+	std::vector<QRCodeDetection> found = run(current, source, &patterns);
+	if (finder_patterns) {
+		*finder_patterns = patterns;
+	}
+	if (!adaptive) {
+		return found;
+	}
+
+	//a code may be there which this configuration can't decode, the strongest one tells.
+	//Otherwise the others take turns now and then
+	int explored = -1;
+	detections++;
+	if (found.empty() && patterns >= FinderPatternsPerCode && current != ConfigCount - 1) {
+		explored = ConfigCount - 1;
+	}
+	else if (explorationInterval > 0 && detections % explorationInterval == 0) {
+		nextExplored = (nextExplored + 1) % ConfigCount;
+		if (nextExplored == current) {
+			nextExplored = (nextExplored + 1) % ConfigCount;
+		}
+		explored = nextExplored;
+	}
+	if (explored < 0) {
+		return found;
+	}
+
+	std::vector<QRCodeDetection> exploredFound = run(explored, source, nullptr);
+	std::size_t present = countUniqueTexts(found, exploredFound);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		explorations++;
+		if (present > 0) {
+			int configs[2] = { current, explored };
+			std::size_t counts[2] = { countUniqueTexts(found), countUniqueTexts(exploredFound) };
+			for (int i = 0; i < 2; i++) {
+				ConfigStats & s = stats[configs[i]];
+				s.comparedFrames++;
+				s.hits += counts[i] == present ? 1 : 0;
+				s.recall = static_cast<double>(s.hits + 1) / static_cast<double>(s.comparedFrames + 1);
+			}
+		}
+		select();
+	}
+
+	return exploredFound.size() > found.size() ? exploredFound : found;
+}
+
+int QRDecoderSelector::getSelectedConfig() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return selected;
+}
+
+QRDecoderSelector::ConfigStats QRDecoderSelector::getStats(int config) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats[std::max(0, std::min(ConfigCount - 1, config))];
+}
+
+std::size_t QRDecoderSelector::getNumberOfExplorations() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return explorations;
+}
+
+const char * QRDecoderSelector::getConfigName(int config) {
+	const char * names[ConfigCount] = { "global", "hybrid", "global-tryhard", "hybrid-tryhard" };
+	return config >= 0 && config < ConfigCount ? names[config] : "unknown";
+}
+
+int QRDecoderSelector::findConfig(const std::string & name) {
+	for (int i = 0; i < ConfigCount; i++) {
+		if (name == getConfigName(i)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+bool QRDecoderSelector::isHybrid(int config) {
+	return (config & 1) != 0;
+}
+
+bool QRDecoderSelector::isTryHard(int config) {
+	return (config & 2) != 0;
+}
+
+std::vector<QRCodeDetection> QRDecoderSelector::run(int config, Ref<LuminanceSource> source, int * finder_patterns) {
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<QRCodeDetection> found = QRCodeInterpreter::detectImageMulti(source, false, isHybrid(config), isTryHard(config), finder_patterns);
+	double time = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	double megapixels = static_cast<double>(source->getWidth()) * source->getHeight() / 1000000.0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	ConfigStats & s = stats[config];
+	s.runs++;
+	s.timePerMegapixel += (time / std::max(megapixels, 0.000001) - s.timePerMegapixel) / static_cast<double>(s.runs);
+	return found;
+}
+
+//with the mutex locked
+void QRDecoderSelector::select() {
+	//the cheapest measured one with enough recall, else the one with the best recall
+	int cheapest = -1;
+	int best = selected;
+	for (int i = 0; i < ConfigCount; i++) {
+		if (stats[i].runs == 0) {
+			continue;
+		}
+		if (stats[i].recall >= recallThreshold && (cheapest < 0 || stats[i].timePerMegapixel < stats[cheapest].timePerMegapixel)) {
+			cheapest = i;
+		}
+		if (stats[i].recall > stats[best].recall) {
+			best = i;
+		}
+	}
+	selected = cheapest >= 0 ? cheapest : best;
 }
@@ -20,11 +20,83 @@
  */
 
 #include <zxing/LuminanceSource.h>
+#include <vector>
+#include <string>
+#include <mutex>
+
+//A decoded code and the bounds of its finder/alignment pattern centers in source pixels
+struct QRCodeDetection {
+  std::string text;
+  float left;
+  float top;
+  float right;
+  float bottom;
+};
 
 class QRCodeInterpreter {
 public:
   static std::string decodeImage(zxing::Ref<zxing::LuminanceSource> source, bool print_exceptions = false, bool hybrid = false, bool tryhard = false);
   static std::vector<std::string> decodeImageMulti(zxing::Ref<zxing::LuminanceSource> source, bool print_exceptions = false, bool hybrid = false, bool tryhard = false);
+  //finder_patterns gets the number of possible finder pattern centers the detector saw, also when nothing was decoded
+  static std::vector<QRCodeDetection> detectImageMulti(zxing::Ref<zxing::LuminanceSource> source, bool print_exceptions = false, bool hybrid = false, bool tryhard = false,
+    int * finder_patterns = nullptr);
+};
+
+//Picks the binarizer (GlobalHistogram or Hybrid) and try harder setting of the detections.
+//Fixed by default. The adaptive mode uses the cheapest configuration (time per megapixel) whose recall stays above the threshold.
+//Recall is learnt by exploration: every explorationInterval detections, and whenever finder patterns were seen but nothing decoded,
+//another configuration also runs on the same source. Codes found by either count as present, a configuration missing them loses recall.
+class QRDecoderSelector {
+public:
+  static const int ConfigCount = 4; //global, hybrid, global-tryhard, hybrid-tryhard
+
+  struct ConfigStats {
+    std::size_t runs;
+    std::size_t comparedFrames; //explored frames with codes this configuration ran on
+    std::size_t hits; //of those, frames where it found all codes
+    double recall; //(hits + 1) / (comparedFrames + 1), unknown counts as full recall
+    double timePerMegapixel; //average, in seconds
+  };
+
+  QRDecoderSelector();
+
+  //configure before scanning starts, not thread safe
+  void setAdaptive(bool enabled);
+  bool isAdaptive() const;
+  //the configuration when not adaptive, the first one when adaptive
+  void setConfig(int config);
+  void setRecallThreshold(double recall);
+  double getRecallThreshold() const;
+  //0 = only explore when finder patterns were seen but nothing decoded
+  void setExplorationInterval(std::size_t detections);
+
+  std::vector<QRCodeDetection> detect(zxing::Ref<zxing::LuminanceSource> source, int * finder_patterns = nullptr);
+
+  //thread safe
+  int getSelectedConfig() const;
+  ConfigStats getStats(int config) const;
+  std::size_t getNumberOfExplorations() const;
+
+  static const char * getConfigName(int config);
+  //-1 if unknown
+  static int findConfig(const std::string & name);
+
+private:
+  static bool isHybrid(int config);
+  static bool isTryHard(int config);
+  std::vector<QRCodeDetection> run(int config, zxing::Ref<zxing::LuminanceSource> source, int * finder_patterns);
+  void select();
+
+  bool adaptive;
+  double recallThreshold;
+  std::size_t explorationInterval;
+  std::size_t detections;
+  int nextExplored;
+
+  mutable std::mutex mutex;
+  int selected;
+  std::size_t explorations;
+  ConfigStats stats[ConfigCount];
 };
 
 #endif /* _QR_CODE_INTERPRETER_H_ */
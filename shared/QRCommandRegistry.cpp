@@ -0,0 +1,164 @@
+#include "QRCommandRegistry.hpp"
+#include <stdlib.h>
+#include <sstream>
+
+namespace
+{
+	//payloads are slides' markers, a handful in practice, the cache is only bounded against odd decodes
+	const std::size_t MaxCachedCommands = 256;
+
+	struct OperationSyntax
+	{
+		const char * name;
+		QRCommandRegistry::Opcode opcode;
+		int minValues; //floats after '=', -1 takes the text
+		int maxValues;
+	};
+
+	const OperationSyntax Vocabulary[] = {
+		{ "SetActive", QRCommandRegistry::OP_SET_ACTIVE, 0, 0 },
+		{ "Clear", QRCommandRegistry::OP_CLEAR, 0, 0 },
+		{ "Show", QRCommandRegistry::OP_SHOW, 0, 0 },
+		{ "Hide", QRCommandRegistry::OP_HIDE, 0, 0 },
+		{ "Move", QRCommandRegistry::OP_MOVE, 2, 3 },
+		{ "Resize", QRCommandRegistry::OP_RESIZE, 1, 1 },
+		{ "SetImage", QRCommandRegistry::OP_SET_IMAGE, -1, -1 },
+		{ "FadeTime", QRCommandRegistry::OP_FADE_TIME, 1, 1 }
+	};
+}
+
+QRCommandRegistry::QRCommandRegistry()
+{
+	mCompiled = 0;
+	mCacheHits = 0;
+}
+
+void QRCommandRegistry::setPlanes(const std::vector<std::string> & names)
+{
+	mPlaneIndices.clear();
+	for (std::size_t i = 0; i < names.size(); i++)
+		mPlaneIndices.insert(std::make_pair(names[i], static_cast<int>(i))); //the first plane of a name wins, as the linear search did
+	mPlaneNames = names;
+	mCommands.clear();
+}
+
+std::size_t QRCommandRegistry::getPlaneCount() const
+{
+	return mPlaneNames.size();
+}
+
+const std::string & QRCommandRegistry::getPlaneName(std::size_t index) const
+{
+	return mPlaneNames[index];
+}
+
+int QRCommandRegistry::findPlane(const std::string & name) const
+{
+	std::unordered_map<std::string, int>::const_iterator it = mPlaneIndices.find(name);
+	return it != mPlaneIndices.end() ? it->second : -1;
+}
+
+const QRCommandRegistry::Command & QRCommandRegistry::compile(const std::string & payload)
+{
+	std::unordered_map<std::string, Command>::const_iterator cached = mCommands.find(payload);
+	if (cached != mCommands.end())
+	{
+		mCacheHits++;
+		return cached->second;
+	}
+
+	if (mCommands.size() >= MaxCachedCommands)
+		mCommands.clear();
+
+	Command command;
+	command.plane = -1;
+	command.allCaptures = false;
+
+	std::stringstream fields(payload);
+	std::string field;
+	bool first = true;
+	while (std::getline(fields, field, ';'))
+	{
+		if (first)
+		{
+			command.allCaptures = field == "AllCaptures";
+			command.plane = command.allCaptures ? -1 : findPlane(field);
+			if (!command.hasTarget())
+				command.errors.push_back(field);
+			first = false;
+		}
+		else
+			compileOperation(field, command);
+	}
+
+	mCompiled++;
+	return mCommands.insert(std::make_pair(payload, command)).first->second;
+}
+
+std::size_t QRCommandRegistry::getNumberOfCompiledCommands() const
+{
+	return mCompiled;
+}
+
+std::size_t QRCommandRegistry::getNumberOfCacheHits() const
+{
+	return mCacheHits;
+}
+
+const char * QRCommandRegistry::getOpcodeName(Opcode opcode)
+{
+	for (std::size_t i = 0; i < sizeof(Vocabulary) / sizeof(OperationSyntax); i++)
+	{
+		if (Vocabulary[i].opcode == opcode)
+			return Vocabulary[i].name;
+	}
+	return "Unknown";
+}
+
+void QRCommandRegistry::compileOperation(const std::string & field, Command & command) const
+{
+	std::size_t equals = field.find('=');
+	std::string name = field.substr(0, equals);
+	std::string arguments = equals != std::string::npos ? field.substr(equals + 1) : "";
+
+	for (std::size_t i = 0; i < sizeof(Vocabulary) / sizeof(OperationSyntax); i++)
+	{
+		const OperationSyntax & syntax = Vocabulary[i];
+		if (name != syntax.name)
+			continue;
+
+		Operation operation;
+		operation.opcode = syntax.opcode;
+		operation.valueCount = 0;
+		operation.values[0] = operation.values[1] = operation.values[2] = 0.0f;
+		if (syntax.minValues < 0)
+			operation.text = arguments;
+		else if (!arguments.empty())
+		{
+			std::stringstream values(arguments);
+			std::string value;
+			while (std::getline(values, value, ','))
+			{
+				char * end = NULL;
+				float number = static_cast<float>(strtod(value.c_str(), &end));
+				if (operation.valueCount == syntax.maxValues || end == value.c_str() || *end != '\0')
+				{
+					operation.valueCount = -1;
+					break;
+				}
+				operation.values[operation.valueCount++] = number;
+			}
+		}
+
+		//Clear only applies to AllCaptures, everything else but FadeTime needs a plane
+		bool target = syntax.opcode == OP_CLEAR ? command.allCaptures : (syntax.opcode == OP_FADE_TIME || command.plane >= 0);
+		bool values = syntax.minValues < 0 ? !operation.text.empty() : operation.valueCount >= syntax.minValues;
+		if (target && values)
+			command.operations.push_back(operation);
+		else
+			command.errors.push_back(field);
+		return;
+	}
+
+	command.errors.push_back(field);
+}
@@ -0,0 +1,72 @@
+#ifndef __QR_COMMAND_REGISTRY_
+#define __QR_COMMAND_REGISTRY_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+//Turns decoded QR payloads like "FrontCapture;SetActive" or "Content 1;Move=20,45;Resize=2.5"
+//into opcodes once, later decodes of the same payload are a hash lookup.
+//The first field is a plane name or AllCaptures, the others are operations with optional values after '='.
+//Plane names resolve to indices through a hash map which is only rebuilt when the planes change.
+class QRCommandRegistry
+{
+public:
+	enum Opcode
+	{
+		OP_SET_ACTIVE, //capture plane shown live, the other capture planes frozen
+		OP_CLEAR, //AllCaptures: all capture planes frozen and faded out
+		OP_SHOW,
+		OP_HIDE,
+		OP_MOVE, //azimuth, elevation and optionally roll in degrees
+		OP_RESIZE, //height
+		OP_SET_IMAGE, //file name of the plane source
+		OP_FADE_TIME //seconds, for all planes
+	};
+
+	struct Operation
+	{
+		Opcode opcode;
+		float values[3];
+		int valueCount;
+		std::string text;
+	};
+
+	struct Command
+	{
+		int plane; //index, -1 for AllCaptures or an unknown plane
+		bool allCaptures;
+		std::vector<Operation> operations;
+		std::vector<std::string> errors; //fields that could not be compiled
+
+		bool hasTarget() const { return plane >= 0 || allCaptures; }
+	};
+
+	QRCommandRegistry();
+
+	//plane names in index order, compiled commands are dropped as their indices may be stale
+	void setPlanes(const std::vector<std::string> & names);
+	std::size_t getPlaneCount() const;
+	const std::string & getPlaneName(std::size_t index) const;
+	//-1 if unknown
+	int findPlane(const std::string & name) const;
+
+	//valid until the next setPlanes() or compile()
+	const Command & compile(const std::string & payload);
+
+	std::size_t getNumberOfCompiledCommands() const;
+	std::size_t getNumberOfCacheHits() const;
+
+	static const char * getOpcodeName(Opcode opcode);
+
+private:
+	void compileOperation(const std::string & field, Command & command) const;
+
+	std::unordered_map<std::string, int> mPlaneIndices;
+	std::vector<std::string> mPlaneNames;
+	std::unordered_map<std::string, Command> mCommands;
+	std::size_t mCompiled;
+	std::size_t mCacheHits;
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "QRDetectionWorker.hpp"
+
+namespace
+{
+	//results nobody collects are dropped, oldest first
+	const std::size_t MaxPendingResults = 64;
+}
+
+QRDetectionWorker::QRDetectionWorker()
+{
+	mStopping = false;
+	mRunning = false;
+	mHasPostedFrame = false;
+	mLumaBuffer = zxing::Ref<FrameLuminanceSource::LumaBuffer>(new FrameLuminanceSource::LumaBuffer());
+
+	mPostedFrames = 0;
+	mReplacedFrames = 0;
+	mScannedFrames = 0;
+	mAverageScanTime = 0.0;
+}
+
+QRDetectionWorker::~QRDetectionWorker()
+{
+	stop();
+}
+
+void QRDetectionWorker::start()
+{
+	stop();
+
+	mStopping = false;
+	mHasPostedFrame = false;
+	mResults.clear();
+	mPostedFrames = 0;
+	mReplacedFrames = 0;
+	mScannedFrames = 0;
+	mAverageScanTime = 0.0;
+	mScanner.reset();
+
+	mThread = std::thread(&QRDetectionWorker::workerLoop, this);
+	mRunning = true;
+}
+
+void QRDetectionWorker::stop()
+{
+	if (!mThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+
+	mThread.join();
+	mRunning = false;
+}
+
+bool QRDetectionWorker::isRunning() const
+{
+	return mRunning;
+}
+
+QRRegionScanner & QRDetectionWorker::getScanner()
+{
+	return mScanner;
+}
+
+bool QRDetectionWorker::post(const FrameView & frame, bool & replaced, uint64_t & replacedSequence)
+{
+	replaced = false;
+	if (!mRunning || !LumaConverter::isSupported(frame.format) || !frame.planes[0])
+		return false;
+
+	//frames with an owner are kept as they are, the others are copied before taking the lock
+	FrameView posted = frame;
+	if (!frame.isOwned())
+	{
+		std::shared_ptr<std::vector<uint8_t> > buffer = takeCopyBuffer();
+		buffer->resize(frame.getDataSize());
+		frame.copyTo(buffer->data());
+		posted.setPackedPlanes(buffer->data());
+		posted.owner = buffer;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mHasPostedFrame)
+		{
+			replaced = true;
+			replacedSequence = mPostedFrame.sequence;
+			mReplacedFrames++;
+		}
+
+		//the replaced frame is released with posted, outside the lock
+		std::swap(mPostedFrame, posted);
+		mHasPostedFrame = true;
+	}
+	mCondition.notify_one();
+
+	mPostedFrames++;
+	return true;
+}
+
+std::shared_ptr<std::vector<uint8_t> > QRDetectionWorker::takeCopyBuffer()
+{
+	//a buffer only this list holds is neither waiting in the mailbox nor being scanned
+	for (std::size_t i = 0; i < mCopyBuffers.size(); i++)
+	{
+		if (mCopyBuffers[i].use_count() == 1)
+			return mCopyBuffers[i];
+	}
+	mCopyBuffers.push_back(std::make_shared<std::vector<uint8_t> >());
+	return mCopyBuffers.back();
+}
+
+void QRDetectionWorker::takeResults(std::vector<Result> & results)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	results.swap(mResults);
+	mResults.clear();
+}
+
+std::size_t QRDetectionWorker::getNumberOfPostedFrames() const
+{
+	return mPostedFrames;
+}
+
+std::size_t QRDetectionWorker::getNumberOfReplacedFrames() const
+{
+	return mReplacedFrames;
+}
+
+std::size_t QRDetectionWorker::getNumberOfScannedFrames() const
+{
+	return mScannedFrames;
+}
+
+double QRDetectionWorker::getAverageScanTime() const
+{
+	return mAverageScanTime;
+}
+
+void QRDetectionWorker::workerLoop()
+{
+	while (true)
+	{
+		FrameView frame;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mCondition.wait(lock, [this]() { return mStopping || mHasPostedFrame; });
+			if (mStopping)
+				return;
+
+			//take the mailbox, the frame owner keeps its memory until the scan is done
+			std::swap(frame, mPostedFrame);
+			mHasPostedFrame = false;
+		}
+
+		Result result;
+		result.sequence = frame.sequence;
+		result.timestamp = frame.timestamp;
+
+		QRRegionScanner::Scan scan = mScanner.scan(FrameLuminanceSource::create(frame, mLumaBuffer));
+		result.texts = scan.texts;
+		result.scanTime = scan.time;
+		result.fullFrame = scan.fullFrame;
+
+		std::size_t count = ++mScannedFrames;
+		mAverageScanTime = mAverageScanTime + (result.scanTime - mAverageScanTime) / static_cast<double>(count);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mResults.size() >= MaxPendingResults)
+			mResults.erase(mResults.begin());
+		mResults.push_back(result);
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef __QR_DETECTION_WORKER_
+#define __QR_DETECTION_WORKER_
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include "CaptureFrame.hpp"
+#include "QRRegionScanner.hpp"
+#include "FrameLuminanceSource.h"
+
+//Decodes QR codes of captured frames on a thread of its own, so capture and upload never wait for the detector.
+//post() keeps only the most recent frame (latest wins), frames posted while a scan runs replace each other.
+//Every scanned frame gives a result with its sequence number, also when nothing was found,
+//the render thread collects them with takeResults().
+class QRDetectionWorker
+{
+public:
+	struct Result
+	{
+		uint64_t sequence; //of the scanned frame
+		double timestamp; //capture time of the scanned frame
+		std::vector<std::string> texts; //decoded codes, empty if the frame is clean
+		double scanTime; //in seconds
+		bool fullFrame; //false if only regions were scanned
+	};
+
+	QRDetectionWorker();
+	~QRDetectionWorker();
+
+	void start();
+	void stop();
+	bool isRunning() const;
+	//regions, tracking and sweep interval, configure before start()
+	QRRegionScanner & getScanner();
+
+	//capture thread (formats of LumaConverter). Owned frames are scanned where they are,
+	//frames without an owner are copied as their memory is reused after the callback.
+	//replaced is set if a frame that was still waiting got replaced, it will never be scanned
+	bool post(const FrameView & frame, bool & replaced, uint64_t & replacedSequence);
+	//results in sequence order since the last call
+	void takeResults(std::vector<Result> & results);
+
+	std::size_t getNumberOfPostedFrames() const;
+	std::size_t getNumberOfReplacedFrames() const;
+	std::size_t getNumberOfScannedFrames() const;
+	double getAverageScanTime() const;
+
+private:
+	void workerLoop();
+
+	std::thread mThread;
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	bool mStopping;
+	std::atomic<bool> mRunning;
+
+	//copy buffer for a frame without an owner, one no posted or scanned frame still holds
+	std::shared_ptr<std::vector<uint8_t> > takeCopyBuffer();
+
+	//mailbox, the frame keeps its memory alive through its owner
+	FrameView mPostedFrame;
+	bool mHasPostedFrame;
+	std::vector<std::shared_ptr<std::vector<uint8_t> > > mCopyBuffers; //capture thread only
+
+	std::vector<Result> mResults;
+	QRRegionScanner mScanner;
+	zxing::Ref<FrameLuminanceSource::LumaBuffer> mLumaBuffer; //reused for every scanned frame
+
+	std::atomic<std::size_t> mPostedFrames;
+	std::atomic<std::size_t> mReplacedFrames;
+	std::atomic<std::size_t> mScannedFrames;
+	std::atomic<double> mAverageScanTime;
+};
+
+#endif
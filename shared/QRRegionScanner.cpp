@@ -0,0 +1,419 @@
+#include "QRRegionScanner.hpp"
+#include "FrameLuminanceSource.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+	//a version 1 code with its quiet zone is 29 modules, smaller regions can't hold one
+	const int MinRegionSize = 32;
+	//tracked codes are scanned with this share of their size around them,
+	//the result points are pattern centers, the code reaches 3.5 modules further
+	const float TrackingMargin = 0.75f;
+	//finder patterns are still found reliably with modules of this many pixels
+	const float MinModulePixels = 3.f;
+	//a code needs its three finder patterns, fewer means there is nothing to find at finer levels either
+	const int FinderPatternsPerCode = 3;
+
+	double getSeconds(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+QRRegionScanner::QRRegionScanner()
+{
+	mTracking = false;
+	mFullSweepInterval = 30;
+	mFramesSinceSweep = 0;
+	mModuleSize = 0.f;
+	mRescanInterval = 30;
+	mFramesSinceRescan = 0;
+	mSweepDue = true;
+	mWidth = 0;
+	mHeight = 0;
+
+	mFullScans = 0;
+	mRegionScans = 0;
+	mSkippedScans = 0;
+	mAverageFullScanTime = 0.0;
+	mAverageRegionScanTime = 0.0;
+	for (int i = 0; i < PyramidLevels; i++)
+	{
+		mLevelScans[i] = 0;
+		mLevelHits[i] = 0;
+		mAverageLevelScanTime[i] = 0.0;
+	}
+}
+
+bool QRRegionScanner::addRegions(const std::string & description)
+{
+	if (description == "corners")
+	{
+		Region corners[] = { { 0.f, 0.f, 0.3f, 0.4f }, { 0.7f, 0.f, 0.3f, 0.4f }, { 0.f, 0.6f, 0.3f, 0.4f }, { 0.7f, 0.6f, 0.3f, 0.4f } };
+		for (int i = 0; i < 4; i++)
+			addRegion(corners[i]);
+		return true;
+	}
+
+	Region region = { 0.f, 0.f, 1.f, 1.f };
+	if (description == "top")
+		region.height = 0.35f;
+	else if (description == "bottom")
+	{
+		region.y = 0.65f;
+		region.height = 0.35f;
+	}
+	else if (description == "left")
+		region.width = 0.35f;
+	else if (description == "right")
+	{
+		region.x = 0.65f;
+		region.width = 0.35f;
+	}
+	else if (sscanf(description.c_str(), "%f,%f,%f,%f", &region.x, &region.y, &region.width, &region.height) != 4 ||
+		region.x < 0.f || region.y < 0.f || region.width <= 0.f || region.height <= 0.f || region.x + region.width > 1.f || region.y + region.height > 1.f)
+		return false;
+
+	addRegion(region);
+	return true;
+}
+
+void QRRegionScanner::addRegion(const Region & region)
+{
+	mRegions.push_back(region);
+	mWidth = 0; //pixel rectangles are made on the next scan
+}
+
+void QRRegionScanner::clearRegions()
+{
+	mRegions.clear();
+	mWidth = 0;
+}
+
+const std::vector<QRRegionScanner::Region> & QRRegionScanner::getRegions() const
+{
+	return mRegions;
+}
+
+void QRRegionScanner::setTracking(bool enabled)
+{
+	mTracking = enabled;
+	mTracked.clear();
+}
+
+bool QRRegionScanner::isTracking() const
+{
+	return mTracking;
+}
+
+void QRRegionScanner::setFullSweepInterval(std::size_t frames)
+{
+	mFullSweepInterval = frames;
+}
+
+std::size_t QRRegionScanner::getFullSweepInterval() const
+{
+	return mFullSweepInterval;
+}
+
+bool QRRegionScanner::isScanningFullFrames() const
+{
+	return mRegions.empty() && !mTracking;
+}
+
+void QRRegionScanner::setModuleSize(float pixels)
+{
+	mModuleSize = std::max(0.f, pixels);
+}
+
+float QRRegionScanner::getModuleSize() const
+{
+	return mModuleSize;
+}
+
+int QRRegionScanner::getCoarsestLevel() const
+{
+	int level = 0;
+	while (level + 1 < PyramidLevels && mModuleSize / static_cast<float>(1 << (level + 1)) >= MinModulePixels)
+		level++;
+	return level;
+}
+
+void QRRegionScanner::setRescanInterval(std::size_t frames)
+{
+	mRescanInterval = frames;
+	mScanned.clear();
+}
+
+std::size_t QRRegionScanner::getRescanInterval() const
+{
+	return mRescanInterval;
+}
+
+QRDecoderSelector & QRRegionScanner::getDecoder()
+{
+	return mDecoder;
+}
+
+const QRDecoderSelector & QRRegionScanner::getDecoder() const
+{
+	return mDecoder;
+}
+
+void QRRegionScanner::reset()
+{
+	mTracked.clear();
+	mScanned.clear();
+	mSweepDue = true;
+}
+
+QRRegionScanner::Scan QRRegionScanner::scan(zxing::Ref<zxing::LuminanceSource> source)
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	Scan scan;
+	scan.regionCount = 0;
+	scan.skippedRegions = 0;
+	scan.scannedPixels = 0;
+
+	int width = source->getWidth();
+	int height = source->getHeight();
+	if (width != mWidth || height != mHeight)
+	{
+		mWidth = width;
+		mHeight = height;
+		mRegionRects.clear();
+		for (std::size_t i = 0; i < mRegions.size(); i++)
+		{
+			Rect rect;
+			rect.left = static_cast<int>(mRegions[i].x * width);
+			rect.top = static_cast<int>(mRegions[i].y * height);
+			rect.right = std::min(width, static_cast<int>((mRegions[i].x + mRegions[i].width) * width + 0.5f));
+			rect.bottom = std::min(height, static_cast<int>((mRegions[i].y + mRegions[i].height) * height + 0.5f));
+			mRegionRects.push_back(rect);
+		}
+		reset();
+	}
+
+	scan.fullFrame = isScanningFullFrames() || mSweepDue || (mFullSweepInterval > 0 && mFramesSinceSweep >= mFullSweepInterval);
+	std::vector<Rect> rects;
+	if (scan.fullFrame)
+	{
+		mSweepDue = false;
+		mFramesSinceSweep = 0;
+
+		Rect whole = { 0, 0, width, height };
+		rects.push_back(whole);
+	}
+	else
+	{
+		//configured regions first, then tracked codes which are not inside one of them
+		rects = mRegionRects;
+		for (std::size_t i = 0; i < mTracked.size(); i++)
+		{
+			if (!isInsideRegion(mTracked[i]))
+				rects.push_back(mTracked[i]);
+		}
+	}
+
+	bool gating = mRescanInterval > 0;
+	bool rescan = !gating || mFramesSinceRescan >= mRescanInterval;
+	std::vector<ScannedRect> scanned;
+	mTracked.clear();
+	for (std::size_t i = 0; i < rects.size(); i++)
+	{
+		const Rect & rect = rects[i];
+		if (!scan.fullFrame && (rect.right - rect.left < MinRegionSize || rect.bottom - rect.top < MinRegionSize))
+			continue;
+
+		zxing::Ref<zxing::LuminanceSource> region = scan.fullFrame ? source : source->crop(rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top);
+
+		//the same part with the same pixels as last time has the same codes
+		ScannedRect current = { rect, gating ? getSignature(region) : 0, std::vector<QRCodeDetection>() };
+		bool unchanged = false;
+		for (std::size_t s = 0; !rescan && !unchanged && s < mScanned.size(); s++)
+		{
+			const ScannedRect & last = mScanned[s];
+			if (last.signature == current.signature && last.rect.left == rect.left && last.rect.top == rect.top && last.rect.right == rect.right && last.rect.bottom == rect.bottom)
+			{
+				current.detections = last.detections;
+				unchanged = true;
+			}
+		}
+
+		if (unchanged)
+			scan.skippedRegions++;
+		else
+		{
+			current.detections = detect(region);
+			scan.scannedPixels += static_cast<std::size_t>(rect.right - rect.left) * (rect.bottom - rect.top);
+		}
+
+		for (std::size_t d = 0; d < current.detections.size(); d++)
+		{
+			if (addText(scan, current.detections[d].text) && mTracking)
+				mTracked.push_back(getTrackingRect(current.detections[d], rect.left, rect.top));
+		}
+
+		if (!scan.fullFrame)
+			scan.regionCount++;
+		if (gating)
+			scanned.push_back(current);
+	}
+	mScanned.swap(scanned);
+	mFramesSinceRescan = rescan ? 1 : mFramesSinceRescan + 1;
+	mFramesSinceSweep++;
+
+	scan.time = getSeconds(start);
+	if (scan.skippedRegions > 0 && scan.scannedPixels == 0)
+		mSkippedScans++;
+	else if (scan.fullFrame)
+	{
+		std::size_t count = ++mFullScans;
+		mAverageFullScanTime = mAverageFullScanTime + (scan.time - mAverageFullScanTime) / static_cast<double>(count);
+	}
+	else
+	{
+		std::size_t count = ++mRegionScans;
+		mAverageRegionScanTime = mAverageRegionScanTime + (scan.time - mAverageRegionScanTime) / static_cast<double>(count);
+	}
+
+	return scan;
+}
+
+std::size_t QRRegionScanner::getNumberOfFullScans() const
+{
+	return mFullScans;
+}
+
+std::size_t QRRegionScanner::getNumberOfRegionScans() const
+{
+	return mRegionScans;
+}
+
+double QRRegionScanner::getAverageFullScanTime() const
+{
+	return mAverageFullScanTime;
+}
+
+double QRRegionScanner::getAverageRegionScanTime() const
+{
+	return mAverageRegionScanTime;
+}
+
+std::size_t QRRegionScanner::getNumberOfSkippedScans() const
+{
+	return mSkippedScans;
+}
+
+std::size_t QRRegionScanner::getNumberOfLevelScans(int level) const
+{
+	return level >= 0 && level < PyramidLevels ? mLevelScans[level].load() : 0;
+}
+
+std::size_t QRRegionScanner::getNumberOfLevelHits(int level) const
+{
+	return level >= 0 && level < PyramidLevels ? mLevelHits[level].load() : 0;
+}
+
+double QRRegionScanner::getAverageLevelScanTime(int level) const
+{
+	return level >= 0 && level < PyramidLevels ? mAverageLevelScanTime[level].load() : 0.0;
+}
+
+std::vector<QRCodeDetection> QRRegionScanner::detect(zxing::Ref<zxing::LuminanceSource> source)
+{
+	//only our own sources have the pyramid
+	FrameLuminanceSource * frameSource = dynamic_cast<FrameLuminanceSource*>(&*source);
+	int level = frameSource ? getCoarsestLevel() : 0;
+
+	std::vector<QRCodeDetection> detections;
+	for (; level >= 0; level--)
+	{
+		int factor = 1 << level;
+		if (level > 0 && (source->getWidth() / factor < MinRegionSize || source->getHeight() / factor < MinRegionSize))
+			continue;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		int finderPatterns = 0;
+		detections = mDecoder.detect(level > 0 ? frameSource->getScaled(factor) : source, level > 0 ? &finderPatterns : nullptr);
+		double time = getSeconds(start);
+
+		std::size_t count = ++mLevelScans[level];
+		mAverageLevelScanTime[level] = mAverageLevelScanTime[level] + (time - mAverageLevelScanTime[level]) / static_cast<double>(count);
+
+		if (!detections.empty())
+		{
+			mLevelHits[level]++;
+			//pixel centers of the level back to the source
+			float offset = 0.5f * static_cast<float>(factor - 1);
+			for (std::size_t d = 0; d < detections.size(); d++)
+			{
+				detections[d].left = detections[d].left * factor + offset;
+				detections[d].top = detections[d].top * factor + offset;
+				detections[d].right = detections[d].right * factor + offset;
+				detections[d].bottom = detections[d].bottom * factor + offset;
+			}
+			break;
+		}
+
+		if (finderPatterns < FinderPatternsPerCode)
+			break;
+	}
+	return detections;
+}
+
+uint64_t QRRegionScanner::getSignature(zxing::Ref<zxing::LuminanceSource> source) const
+{
+	//our own sources hash the frame pixels, others their luminance
+	FrameLuminanceSource * frameSource = dynamic_cast<FrameLuminanceSource*>(&*source);
+	if (frameSource)
+		return frameSource->getSignature();
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	zxing::ArrayRef<char> row;
+	for (int y = 0; y < source->getHeight(); y++)
+	{
+		row = source->getRow(y, row);
+		for (int x = 0; x < source->getWidth(); x++)
+			hash = (hash ^ static_cast<uint8_t>(row[x])) * 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+bool QRRegionScanner::addText(Scan & scan, const std::string & text)
+{
+	//a code in overlapping regions is found twice
+	if (std::find(scan.texts.begin(), scan.texts.end(), text) != scan.texts.end())
+		return false;
+
+	scan.texts.push_back(text);
+	return true;
+}
+
+bool QRRegionScanner::isInsideRegion(const Rect & rect) const
+{
+	for (std::size_t i = 0; i < mRegionRects.size(); i++)
+	{
+		const Rect & region = mRegionRects[i];
+		if (rect.left >= region.left && rect.top >= region.top && rect.right <= region.right && rect.bottom <= region.bottom)
+			return true;
+	}
+	return false;
+}
+
+QRRegionScanner::Rect QRRegionScanner::getTrackingRect(const QRCodeDetection & detection, int offsetX, int offsetY) const
+{
+	float size = std::max(detection.right - detection.left, detection.bottom - detection.top);
+	float margin = std::max(size * TrackingMargin, static_cast<float>(MinRegionSize));
+
+	Rect rect;
+	rect.left = std::max(0, static_cast<int>(detection.left - margin) + offsetX);
+	rect.top = std::max(0, static_cast<int>(detection.top - margin) + offsetY);
+	rect.right = std::min(mWidth, static_cast<int>(detection.right + margin + 1.f) + offsetX);
+	rect.bottom = std::min(mHeight, static_cast<int>(detection.bottom + margin + 1.f) + offsetY);
+	return rect;
+}
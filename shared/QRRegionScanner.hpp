@@ -0,0 +1,136 @@
+#ifndef __QR_REGION_SCANNER_
+#define __QR_REGION_SCANNER_
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <zxing/LuminanceSource.h>
+#include "QRCodeInterpreter.h"
+
+//Picks the parts of a frame that are scanned for QR codes.
+//Without regions and tracking every frame is scanned as a whole (the default).
+//Configured regions (e.g. the corners of a slide) and, with tracking, the surroundings of the
+//codes found last are scanned instead, a full frame sweep only runs every N frames.
+//Regions are crops of the luminance source, no pixels are copied.
+//With a module size set, FrameLuminanceSources are first scanned at the coarsest pyramid level (2x or 4x box filtered)
+//which still reliably holds a code of that size, finer levels are only tried when the detector saw finder patterns there but decoded nothing.
+//A scanned part whose pixels have the same signature as when it was last decoded reuses those codes,
+//so unchanged slides cost a hash instead of a decode until the periodic rescan.
+class QRRegionScanner
+{
+public:
+	static const int PyramidLevels = 3; //full resolution, 2x and 4x smaller
+
+	//relative to the frame size (0-1), origin in the top left corner as seen by the scanner
+	struct Region
+	{
+		float x;
+		float y;
+		float width;
+		float height;
+	};
+
+	struct Scan
+	{
+		std::vector<std::string> texts; //unique decoded codes
+		bool fullFrame;
+		std::size_t regionCount; //regions scanned, 0 for a full frame scan
+		std::size_t skippedRegions; //unchanged since they were decoded, their codes were reused
+		std::size_t scannedPixels; //decoded
+		double time; //in seconds
+	};
+
+	QRRegionScanner();
+
+	//configure before scanning starts, not thread safe
+	//corners, top, bottom, left, right or x,y,width,height as fractions of the frame
+	bool addRegions(const std::string & description);
+	void addRegion(const Region & region);
+	void clearRegions();
+	const std::vector<Region> & getRegions() const;
+	void setTracking(bool enabled);
+	bool isTracking() const;
+	//number of frames between full frame sweeps when regions or tracking are used, 0 = only the first frame
+	void setFullSweepInterval(std::size_t frames);
+	std::size_t getFullSweepInterval() const;
+	bool isScanningFullFrames() const;
+	//size of a module of the markers in pixels of the frame, 0 = no pyramid, only full resolution (the default)
+	void setModuleSize(float pixels);
+	float getModuleSize() const;
+	//level the scans start at, 0 is full resolution
+	int getCoarsestLevel() const;
+	//unchanged parts are decoded again after this many frames, 0 = decode every frame
+	void setRescanInterval(std::size_t frames);
+	std::size_t getRescanInterval() const;
+	//binarizer and try harder choice of every detection
+	QRDecoderSelector & getDecoder();
+	const QRDecoderSelector & getDecoder() const;
+
+	Scan scan(zxing::Ref<zxing::LuminanceSource> source);
+	//forget tracked codes, the next scan is a full frame sweep
+	void reset();
+
+	std::size_t getNumberOfFullScans() const;
+	std::size_t getNumberOfRegionScans() const;
+	double getAverageFullScanTime() const;
+	double getAverageRegionScanTime() const;
+	//frames where every part was unchanged and nothing was decoded, not counted as full or region scans
+	std::size_t getNumberOfSkippedScans() const;
+	//per pyramid level: detections tried, tries which decoded a code and their time
+	std::size_t getNumberOfLevelScans(int level) const;
+	std::size_t getNumberOfLevelHits(int level) const;
+	double getAverageLevelScanTime(int level) const;
+
+private:
+	//in pixels of the frame
+	struct Rect
+	{
+		int left;
+		int top;
+		int right;
+		int bottom;
+	};
+
+	//detection on the pyramid, the results are in pixels of source
+	std::vector<QRCodeDetection> detect(zxing::Ref<zxing::LuminanceSource> source);
+	uint64_t getSignature(zxing::Ref<zxing::LuminanceSource> source) const;
+	bool addText(Scan & scan, const std::string & text);
+	bool isInsideRegion(const Rect & rect) const;
+	Rect getTrackingRect(const QRCodeDetection & detection, int offsetX, int offsetY) const;
+
+	std::vector<Region> mRegions;
+	std::vector<Rect> mRegionRects; //of the current frame size
+	std::vector<Rect> mTracked;
+
+	//the parts of the last scan with their codes, in their coordinates
+	struct ScannedRect
+	{
+		Rect rect;
+		uint64_t signature;
+		std::vector<QRCodeDetection> detections;
+	};
+	std::vector<ScannedRect> mScanned;
+	std::size_t mRescanInterval;
+	std::size_t mFramesSinceRescan;
+
+	bool mTracking;
+	std::size_t mFullSweepInterval;
+	std::size_t mFramesSinceSweep;
+	float mModuleSize;
+	QRDecoderSelector mDecoder;
+	bool mSweepDue;
+	int mWidth;
+	int mHeight;
+
+	//written by the scanning thread, read by anyone
+	std::atomic<std::size_t> mFullScans;
+	std::atomic<std::size_t> mRegionScans;
+	std::atomic<std::size_t> mSkippedScans;
+	std::atomic<double> mAverageFullScanTime;
+	std::atomic<double> mAverageRegionScanTime;
+	std::atomic<std::size_t> mLevelScans[PyramidLevels];
+	std::atomic<std::size_t> mLevelHits[PyramidLevels];
+	std::atomic<double> mAverageLevelScanTime[PyramidLevels];
+};
+
+#endif
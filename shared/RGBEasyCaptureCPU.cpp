@@ -70,7 +70,8 @@ static USHORT gBitCount = 24;
 static unsigned long gWidth = 0;
 static unsigned long gHeight = 0;
 //callback function pointer
-static std::function<void(void* data, unsigned long width, unsigned long height)> gCaptureCallback = nullptr;
+static std::function<void(const FrameView & frame)> gCaptureCallback = nullptr;
+static uint64_t gFrameSequence = 0;
 
 /******************************************************************************/
 
@@ -154,7 +155,21 @@ void RGBCBKAPI FrameCapturedFnExCPU(
                 if (pFrameData && pFrameData->TimeStamp)
                 {
                     if (gCaptureCallback != nullptr)
-                        gCaptureCallback(pFrameData->PBitmapBits, gWidth, gHeight);
+                    {
+                        /* The buffer goes back to the driver after the callback,
+                        * so the view has no owner. */
+                        FrameView frame;
+                        frame.planes[0] = static_cast<uint8_t*>(pFrameData->PBitmapBits);
+                        frame.linesizes[0] = ((gWidth * gBitCount + 31) / 32) * 4; /* DIB rows are DWORD aligned */
+                        frame.width = static_cast<int>(gWidth);
+                        frame.height = static_cast<int>(gHeight);
+                        frame.format = FRAME_FORMAT_BGR24;
+                        frame.orientation = FRAME_BOTTOM_UP;
+                        frame.timestamp = sgct::Engine::getTime();
+                        frame.pts = static_cast<int64_t>(pFrameData->TimeStamp);
+                        frame.sequence = gFrameSequence++;
+                        gCaptureCallback(frame);
+                    }
                 }
                 /* We own the buffer until it is passed back into the driver. Once we
                 * chain it back in it will be reused in another capture. */
@@ -342,7 +357,7 @@ void RGBEasyCaptureCPU::setCaptureInput(int input)
     mCaptureInput = input;
 }
 
-void RGBEasyCaptureCPU::setCaptureCallback(std::function<void(void* data, unsigned long width, unsigned long height)> cb)
+void RGBEasyCaptureCPU::setCaptureCallback(std::function<void(const FrameView & frame)> cb)
 {
     gCaptureCallback = cb;
 }
@@ -353,4 +368,14 @@ unsigned long  RGBEasyCaptureCPU::getWidth() {
 
 unsigned long RGBEasyCaptureCPU::getHeight() {
 	return gHeight;
+}
+
+FrameOrientation RGBEasyCaptureCPU::getOrientation() const {
+	//positive biHeight, the DIB rows are stored bottom-up
+	return FRAME_BOTTOM_UP;
+}
+
+FramePixelFormat RGBEasyCaptureCPU::getFramePixelFormat() const {
+	//24 bit DIB
+	return FRAME_FORMAT_BGR24;
 }
\ No newline at end of file
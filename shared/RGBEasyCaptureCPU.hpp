@@ -12,6 +12,7 @@ For conditions of distribution and use, see copyright notice in sgct.h
 
 #include <string>
 #include <functional>
+#include "CaptureFrame.hpp"
 
 class RGBEasyCaptureCPU
 {
@@ -25,10 +26,12 @@ public:
 
     void setCaptureHost(std::string hostAdress);
 	void setCaptureInput(int input);
-    void setCaptureCallback(std::function<void(void* data, unsigned long width, unsigned long height)> cb);
+    void setCaptureCallback(std::function<void(const FrameView & frame)> cb);
 
 	unsigned long getWidth();
 	unsigned long getHeight();
+	FrameOrientation getOrientation() const;
+	FramePixelFormat getFramePixelFormat() const;
 
     std::string getCaptureHost() const;
 
@@ -159,6 +159,10 @@ static GLOBAL Global =
 
 static int currentBufferIndex = 0;
 static GLsync currentFence = 0;
+/* Latest buffer prepared for rendering, described by getFrameView. */
+static int renderedBufferIndex = NO_BUFFER;
+static double renderedBufferTime = 0.0;
+static uint64_t renderedBufferSequence = 0;
 
 unsigned long
 DoGanging(unsigned long input)
@@ -767,6 +771,10 @@ bool RGBEasyCaptureGPU::prepareForRendering() {
 
 		glBindTexture(GL_TEXTURE_2D, Global.OGLTexture[currentBufferIndex]);
 
+		renderedBufferIndex = currentBufferIndex;
+		renderedBufferTime = sgct::Engine::getTime();
+		renderedBufferSequence++;
+
 		if (Global.Hardware == GPU_AMD)
 		{
 			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, Global.OGLBuffer[currentBufferIndex]);
@@ -849,4 +857,24 @@ unsigned long RGBEasyCaptureGPU::getHeight() {
 
 bool RGBEasyCaptureGPU::getGanging() {
 	return mCaptureGanging;
+}
+
+FrameView RGBEasyCaptureGPU::getFrameView() const {
+	/* The frame stays on the GPU, only the texture is described. */
+	FrameView frame;
+	frame.width = static_cast<int>(Global.Width);
+	frame.height = static_cast<int>(Global.Height);
+	switch (Global.FormatSize)
+	{
+	case 1: frame.format = FRAME_FORMAT_GREY; break;
+	case 2: frame.format = FRAME_FORMAT_RGB565; break;
+	case 3: frame.format = FRAME_FORMAT_BGR24; break;
+	case 4: frame.format = FRAME_FORMAT_BGRA; break;
+	}
+	frame.orientation = FRAME_BOTTOM_UP;
+	frame.timestamp = renderedBufferTime;
+	frame.sequence = renderedBufferSequence;
+	if (renderedBufferIndex != NO_BUFFER)
+		frame.texture = Global.OGLTexture[renderedBufferIndex];
+	return frame;
 }
\ No newline at end of file
@@ -11,6 +11,7 @@ For conditions of distribution and use, see copyright notice in sgct.h
 #define __RGBEASY_CAPTURE_GPU_
 
 #include <string>
+#include "CaptureFrame.hpp"
 
 class RGBEasyCaptureGPU
 {
@@ -35,6 +36,7 @@ public:
 	unsigned long getWidth();
 	unsigned long getHeight();
 	bool getGanging();
+	FrameView getFrameView() const;
 
     std::string getCaptureHost() const;
 
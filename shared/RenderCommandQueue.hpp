@@ -0,0 +1,74 @@
+#ifndef __RENDER_COMMAND_QUEUE_
+#define __RENDER_COMMAND_QUEUE_
+
+#include <vector>
+#include <atomic>
+#include <functional>
+
+//Lock-free single producer/single consumer queue of commands for the render thread.
+//A capture thread posts what needs the render context or the draw state, the render thread runs them in drain(),
+//so neither side ever waits for the other. When full the post fails and the producer retries with a later frame.
+class RenderCommandQueue
+{
+public:
+	typedef std::function<void()> Command;
+
+	explicit RenderCommandQueue(std::size_t capacity = 16)
+		: mCommands(capacity + 1) //one slot stays empty to tell full from empty
+		, mHead(0)
+		, mTail(0)
+		, mDropped(0)
+	{
+	}
+
+	//producer thread only
+	bool post(const Command & command)
+	{
+		std::size_t tail = mTail.load(std::memory_order_relaxed);
+		std::size_t next = (tail + 1) % mCommands.size();
+		if (next == mHead.load(std::memory_order_acquire))
+		{
+			mDropped++;
+			return false;
+		}
+		mCommands[tail] = command;
+		mTail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	//consumer thread only, runs the commands posted so far in order and returns how many
+	std::size_t drain()
+	{
+		std::size_t head = mHead.load(std::memory_order_relaxed);
+		std::size_t tail = mTail.load(std::memory_order_acquire);
+		std::size_t count = 0;
+		while (head != tail)
+		{
+			Command command;
+			command.swap(mCommands[head]);
+			head = (head + 1) % mCommands.size();
+			mHead.store(head, std::memory_order_release); //the slot can be reused while the command runs
+			command();
+			count++;
+		}
+		return count;
+	}
+
+	bool empty() const
+	{
+		return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+	}
+
+	std::size_t getNumberOfDropped() const
+	{
+		return mDropped.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::vector<Command> mCommands;
+	std::atomic<std::size_t> mHead; //next to run, written by the consumer
+	std::atomic<std::size_t> mTail; //next free, written by the producer
+	std::atomic<std::size_t> mDropped;
+};
+
+#endif
@@ -0,0 +1,198 @@
+#include "SliceConverter.hpp"
+#include <algorithm>
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+SliceConverter::SliceConverter()
+{
+	mWidth = 0;
+	mHeight = 0;
+	mSrcFormat = AV_PIX_FMT_NONE;
+	mDstFormat = AV_PIX_FMT_NONE;
+	mSrcChromaShift = 0;
+	mDstChromaShift = 0;
+	mSliceAlignment = 1;
+	mUseKernels = false;
+	mLevel = CONVERSION_SCALAR;
+	mInited = false;
+}
+
+SliceConverter::~SliceConverter()
+{
+	cleanup();
+}
+
+bool SliceConverter::init(int width, int height, AVPixelFormat srcFormat, AVPixelFormat dstFormat, std::size_t threadCount, bool useKernels, ConversionLevel level)
+{
+	cleanup();
+
+	const AVPixFmtDescriptor * srcDesc = av_pix_fmt_desc_get(srcFormat);
+	const AVPixFmtDescriptor * dstDesc = av_pix_fmt_desc_get(dstFormat);
+	if (!srcDesc || !dstDesc || width <= 0 || height <= 0)
+		return false;
+
+	mWidth = width;
+	mHeight = height;
+	mSrcFormat = srcFormat;
+	mDstFormat = dstFormat;
+	mSrcChromaShift = srcDesc->log2_chroma_h;
+	mDstChromaShift = dstDesc->log2_chroma_h;
+	//slices start on a row that has its own chroma row in both formats
+	mSliceAlignment = 1 << std::max(mSrcChromaShift, mDstChromaShift);
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+	//no point in slices thinner than a few rows
+	threadCount = std::max<std::size_t>(1, std::min<std::size_t>(threadCount, static_cast<std::size_t>(height / (8 * mSliceAlignment))));
+
+	FrameView src;
+	src.width = width;
+	src.height = height;
+	src.format = toFramePixelFormat(srcFormat);
+	mUseKernels = useKernels && FrameConverter::isSupported(src, toFramePixelFormat(dstFormat));
+	mLevel = std::min(level, FrameConverter::getBestLevel());
+
+	if (!mUseKernels)
+	{
+		for (std::size_t i = 0; i < threadCount; i++)
+		{
+			int firstRow, rowCount;
+			SliceWorkerPool::getSliceRows(i, threadCount, height, mSliceAlignment, firstRow, rowCount);
+			SwsContext * context = sws_getContext(width, rowCount, srcFormat,
+				width, rowCount, dstFormat,
+				SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+			if (!context)
+			{
+				cleanup();
+				return false;
+			}
+			mSliceContexts.push_back(context);
+		}
+	}
+
+	mPool.start(threadCount);
+	mInited = true;
+	return true;
+}
+
+void SliceConverter::cleanup()
+{
+	mPool.stop();
+
+	for (std::size_t i = 0; i < mSliceContexts.size(); i++)
+		sws_freeContext(mSliceContexts[i]);
+	mSliceContexts.clear();
+
+	mUseKernels = false;
+	mInited = false;
+}
+
+bool SliceConverter::isInited() const
+{
+	return mInited;
+}
+
+bool SliceConverter::convert(const uint8_t * const srcData[], const int srcLinesize[], uint8_t * const dstData[], const int dstLinesize[])
+{
+	if (!mInited)
+		return false;
+
+	std::size_t sliceCount = mPool.getThreadCount();
+	mPool.run(sliceCount, [&](std::size_t slice) {
+		convertSlice(slice, srcData, srcLinesize, dstData, dstLinesize);
+	});
+
+	return true;
+}
+
+void SliceConverter::convertSlice(std::size_t slice, const uint8_t * const srcData[], const int srcLinesize[], uint8_t * const dstData[], const int dstLinesize[])
+{
+	int firstRow, rowCount;
+	SliceWorkerPool::getSliceRows(slice, mPool.getThreadCount(), mHeight, mSliceAlignment, firstRow, rowCount);
+	if (rowCount == 0)
+		return;
+
+	if (mUseKernels)
+	{
+		FrameView src;
+		src.width = mWidth;
+		src.height = mHeight;
+		src.format = toFramePixelFormat(mSrcFormat);
+		FrameView dst;
+		dst.width = mWidth;
+		dst.height = mHeight;
+		dst.format = toFramePixelFormat(mDstFormat);
+		for (int i = 0; i < 4; i++)
+		{
+			src.planes[i] = const_cast<uint8_t*>(srcData[i]);
+			src.linesizes[i] = srcLinesize[i];
+			dst.planes[i] = dstData[i];
+			dst.linesizes[i] = dstLinesize[i];
+		}
+		FrameConverter::convertRows(src, dst, firstRow, rowCount, mLevel);
+		return;
+	}
+
+	//each slice context sees its part as a frame of its own
+	const uint8_t * srcSlice[4] = { nullptr, nullptr, nullptr, nullptr };
+	uint8_t * dstSlice[4] = { nullptr, nullptr, nullptr, nullptr };
+	for (int i = 0; i < 4; i++)
+	{
+		//planes 1 and 2 are chroma in planar and semi-planar formats
+		int srcRow = (i == 1 || i == 2) ? (firstRow >> mSrcChromaShift) : firstRow;
+		int dstRow = (i == 1 || i == 2) ? (firstRow >> mDstChromaShift) : firstRow;
+		if (srcData[i])
+			srcSlice[i] = srcData[i] + static_cast<std::ptrdiff_t>(srcRow) * srcLinesize[i];
+		if (dstData[i])
+			dstSlice[i] = dstData[i] + static_cast<std::ptrdiff_t>(dstRow) * dstLinesize[i];
+	}
+	sws_scale(mSliceContexts[slice], srcSlice, srcLinesize, 0, rowCount, dstSlice, dstLinesize);
+}
+
+bool SliceConverter::isUsingKernels() const
+{
+	return mUseKernels;
+}
+
+std::size_t SliceConverter::getThreadCount() const
+{
+	return mPool.getThreadCount();
+}
+
+const char * SliceConverter::getName() const
+{
+	return mUseKernels ? FrameConverter::getLevelName(mLevel) : "swscale";
+}
+
+FramePixelFormat SliceConverter::toFramePixelFormat(AVPixelFormat pix_fmt)
+{
+	switch (pix_fmt)
+	{
+	case AV_PIX_FMT_BGR24: return FRAME_FORMAT_BGR24;
+	case AV_PIX_FMT_RGB24: return FRAME_FORMAT_RGB24;
+	case AV_PIX_FMT_BGRA: return FRAME_FORMAT_BGRA;
+	case AV_PIX_FMT_YUYV422: return FRAME_FORMAT_YUYV422;
+	case AV_PIX_FMT_UYVY422: return FRAME_FORMAT_UYVY422;
+	case AV_PIX_FMT_NV12: return FRAME_FORMAT_NV12;
+	case AV_PIX_FMT_YUV420P: return FRAME_FORMAT_YUV420P;
+	default: return FRAME_FORMAT_UNKNOWN;
+	}
+}
+
+AVPixelFormat SliceConverter::toAVPixelFormat(FramePixelFormat format)
+{
+	switch (format)
+	{
+	case FRAME_FORMAT_BGR24: return AV_PIX_FMT_BGR24;
+	case FRAME_FORMAT_RGB24: return AV_PIX_FMT_RGB24;
+	case FRAME_FORMAT_BGRA: return AV_PIX_FMT_BGRA;
+	case FRAME_FORMAT_YUYV422: return AV_PIX_FMT_YUYV422;
+	case FRAME_FORMAT_UYVY422: return AV_PIX_FMT_UYVY422;
+	case FRAME_FORMAT_NV12: return AV_PIX_FMT_NV12;
+	case FRAME_FORMAT_YUV420P: return AV_PIX_FMT_YUV420P;
+	default: return AV_PIX_FMT_NONE;
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef __SLICE_CONVERTER_
+#define __SLICE_CONVERTER_
+
+extern "C"
+{
+#ifndef __STDC_CONSTANT_MACROS
+#define __STDC_CONSTANT_MACROS
+#endif
+#include <libswscale/swscale.h>
+}
+
+#include <vector>
+#include "CaptureFrame.hpp"
+#include "FrameConverter.hpp"
+#include "SliceWorkerPool.hpp"
+
+//Pixel format conversion of whole frames split in horizontal slices over a worker pool.
+//Uses the FrameConverter kernels when they support the formats, otherwise one SwsContext per slice.
+class SliceConverter
+{
+public:
+	SliceConverter();
+	~SliceConverter();
+
+	//threadCount 0 picks up to 4 threads from the number of cores
+	bool init(int width, int height, AVPixelFormat srcFormat, AVPixelFormat dstFormat, std::size_t threadCount, bool useKernels, ConversionLevel level);
+	void cleanup();
+	bool isInited() const;
+
+	bool convert(const uint8_t * const srcData[], const int srcLinesize[], uint8_t * const dstData[], const int dstLinesize[]);
+
+	bool isUsingKernels() const;
+	std::size_t getThreadCount() const;
+	const char * getName() const; //kernel level or swscale
+
+	static FramePixelFormat toFramePixelFormat(AVPixelFormat pix_fmt);
+	static AVPixelFormat toAVPixelFormat(FramePixelFormat format);
+
+private:
+	void convertSlice(std::size_t slice, const uint8_t * const srcData[], const int srcLinesize[], uint8_t * const dstData[], const int dstLinesize[]);
+
+	int mWidth;
+	int mHeight;
+	AVPixelFormat mSrcFormat;
+	AVPixelFormat mDstFormat;
+	int mSrcChromaShift; //log2 of the vertical chroma subsampling
+	int mDstChromaShift;
+	int mSliceAlignment;
+	bool mUseKernels;
+	ConversionLevel mLevel;
+	bool mInited;
+
+	std::vector<SwsContext*> mSliceContexts;
+	SliceWorkerPool mPool;
+};
+
+#endif
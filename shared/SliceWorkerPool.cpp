@@ -0,0 +1,113 @@
+#include "SliceWorkerPool.hpp"
+
+SliceWorkerPool::SliceWorkerPool()
+{
+	mJob = nullptr;
+	mSliceCount = 0;
+	mNextSlice = 0;
+	mActiveWorkers = 0;
+	mGeneration = 0;
+	mStopping = false;
+}
+
+SliceWorkerPool::~SliceWorkerPool()
+{
+	stop();
+}
+
+void SliceWorkerPool::start(std::size_t threadCount)
+{
+	stop();
+
+	mStopping = false;
+	for (std::size_t i = 1; i < threadCount; i++)
+		mThreads.push_back(std::thread(&SliceWorkerPool::workerLoop, this, mGeneration));
+}
+
+void SliceWorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mStartCondition.notify_all();
+
+	for (std::size_t i = 0; i < mThreads.size(); i++)
+		mThreads[i].join();
+	mThreads.clear();
+}
+
+std::size_t SliceWorkerPool::getThreadCount() const
+{
+	return mThreads.size() + 1;
+}
+
+void SliceWorkerPool::run(std::size_t sliceCount, const std::function<void(std::size_t slice)> & job)
+{
+	if (mThreads.empty() || sliceCount <= 1)
+	{
+		for (std::size_t i = 0; i < sliceCount; i++)
+			job(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJob = &job;
+		mSliceCount = sliceCount;
+		mNextSlice = 0;
+		mActiveWorkers = mThreads.size();
+		mGeneration++;
+	}
+	mStartCondition.notify_all();
+
+	runSlices();
+
+	//every worker has to leave the job before it goes out of scope
+	std::unique_lock<std::mutex> lock(mMutex);
+	mDoneCondition.wait(lock, [this]() { return mActiveWorkers == 0; });
+	mJob = nullptr;
+}
+
+void SliceWorkerPool::runSlices()
+{
+	std::size_t slice;
+	while ((slice = mNextSlice++) < mSliceCount)
+		(*mJob)(slice);
+}
+
+void SliceWorkerPool::workerLoop(uint64_t lastGeneration)
+{
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mStartCondition.wait(lock, [&]() { return mStopping || mGeneration != lastGeneration; });
+			if (mStopping)
+				return;
+			lastGeneration = mGeneration;
+		}
+
+		runSlices();
+
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mActiveWorkers--;
+		}
+		mDoneCondition.notify_one();
+	}
+}
+
+void SliceWorkerPool::getSliceRows(std::size_t slice, std::size_t sliceCount, int height, int alignment, int & firstRow, int & rowCount)
+{
+	//split in aligned blocks, the last slice takes the remainder
+	int blocks = (height + alignment - 1) / alignment;
+	int count = static_cast<int>(sliceCount);
+	int index = static_cast<int>(slice);
+	int firstBlock = static_cast<int>((static_cast<int64_t>(blocks) * index) / count);
+	int endBlock = static_cast<int>((static_cast<int64_t>(blocks) * (index + 1)) / count);
+
+	firstRow = firstBlock * alignment;
+	int endRow = endBlock * alignment < height ? endBlock * alignment : height;
+	rowCount = endRow > firstRow ? endRow - firstRow : 0;
+}
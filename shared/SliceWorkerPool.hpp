@@ -0,0 +1,48 @@
+#ifndef __SLICE_WORKER_POOL_
+#define __SLICE_WORKER_POOL_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+//Small pool of threads that runs the slices of a job in parallel.
+//The calling thread takes slices as well and run() returns when all of them are done,
+//so a job may reference data on the caller's stack.
+class SliceWorkerPool
+{
+public:
+	SliceWorkerPool();
+	~SliceWorkerPool();
+
+	//threadCount includes the calling thread, 1 runs everything on the caller
+	void start(std::size_t threadCount);
+	void stop();
+	std::size_t getThreadCount() const;
+
+	void run(std::size_t sliceCount, const std::function<void(std::size_t slice)> & job);
+
+	//rows of a slice when height is split in sliceCount parts starting at multiples of alignment
+	static void getSliceRows(std::size_t slice, std::size_t sliceCount, int height, int alignment, int & firstRow, int & rowCount);
+
+private:
+	void workerLoop(uint64_t lastGeneration);
+	void runSlices();
+
+	std::vector<std::thread> mThreads;
+	std::mutex mMutex;
+	std::condition_variable mStartCondition;
+	std::condition_variable mDoneCondition;
+
+	const std::function<void(std::size_t slice)> * mJob;
+	std::size_t mSliceCount;
+	std::atomic<std::size_t> mNextSlice;
+	std::size_t mActiveWorkers;
+	uint64_t mGeneration;
+	bool mStopping;
+};
+
+#endif
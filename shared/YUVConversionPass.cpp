@@ -0,0 +1,341 @@
+#include "YUVConversionPass.hpp"
+
+namespace
+{
+	//fullscreen triangle without any vertex data
+	const char * ConversionVertexShader =
+		"#version 330 core\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+		"	gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);\n"
+		"}\n";
+
+	//planeLayout 0 yuyv, 1 uyvy, 2 nv12, 3 i420
+	//integer math identical to FrameConverter, texel rows are the frame rows
+	const char * ConversionFragmentShader =
+		"#version 330 core\n"
+		"uniform sampler2D Plane0;\n"
+		"uniform sampler2D Plane1;\n"
+		"uniform sampler2D Plane2;\n"
+		"uniform int planeLayout;\n"
+		"out vec4 color;\n"
+		"\n"
+		"ivec4 toBytes(vec4 v)\n"
+		"{\n"
+		"	return ivec4(v * 255.0 + 0.5);\n"
+		"}\n"
+		"\n"
+		"void main()\n"
+		"{\n"
+		"	ivec2 p = ivec2(gl_FragCoord.xy);\n"
+		"	ivec2 chroma = p >> 1;\n"
+		"	int y, u, v;\n"
+		"	if (planeLayout == 0)\n"
+		"	{\n"
+		"		ivec4 pair = toBytes(texelFetch(Plane0, ivec2(chroma.x, p.y), 0));\n"
+		"		y = (p.x & 1) == 0 ? pair.r : pair.b;\n"
+		"		u = pair.g;\n"
+		"		v = pair.a;\n"
+		"	}\n"
+		"	else if (planeLayout == 1)\n"
+		"	{\n"
+		"		ivec4 pair = toBytes(texelFetch(Plane0, ivec2(chroma.x, p.y), 0));\n"
+		"		y = (p.x & 1) == 0 ? pair.g : pair.a;\n"
+		"		u = pair.r;\n"
+		"		v = pair.b;\n"
+		"	}\n"
+		"	else if (planeLayout == 2)\n"
+		"	{\n"
+		"		y = toBytes(texelFetch(Plane0, p, 0)).r;\n"
+		"		ivec4 uv = toBytes(texelFetch(Plane1, chroma, 0));\n"
+		"		u = uv.r;\n"
+		"		v = uv.g;\n"
+		"	}\n"
+		"	else\n"
+		"	{\n"
+		"		y = toBytes(texelFetch(Plane0, p, 0)).r;\n"
+		"		u = toBytes(texelFetch(Plane1, chroma, 0)).r;\n"
+		"		v = toBytes(texelFetch(Plane2, chroma, 0)).r;\n"
+		"	}\n"
+		"\n"
+		"	int c = 75 * (y - 16);\n"
+		"	int d = u - 128;\n"
+		"	int e = v - 128;\n"
+		"	ivec3 rgb = ivec3(c + 102 * e + 32, c - 25 * d - 52 * e + 32, c + 129 * d + 32) >> 6;\n"
+		"	color = vec4(vec3(clamp(rgb, 0, 255)) / 255.0, 1.0);\n"
+		"}\n";
+
+	bool compileShader(GLuint shader, const char * source)
+	{
+		glShaderSource(shader, 1, &source, nullptr);
+		glCompileShader(shader);
+
+		GLint status = GL_FALSE;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		if (status != GL_TRUE)
+		{
+			char log[1024];
+			glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+			sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "YUV conversion shader failed to compile:\n%s\n", log);
+			return false;
+		}
+		return true;
+	}
+}
+
+YUVConversionPass::YUVConversionPass()
+{
+	for (int i = 0; i < 3; i++)
+		mPlanes[i].texture = 0;
+	mPlaneCount = 0;
+	mWidth = 0;
+	mHeight = 0;
+	mFormat = FRAME_FORMAT_UNKNOWN;
+
+	mProgram = 0;
+	mPlaneLayoutLoc = -1;
+	mInited = false;
+}
+
+YUVConversionPass::~YUVConversionPass()
+{
+}
+
+bool YUVConversionPass::init(int width, int height, FramePixelFormat format)
+{
+	cleanup();
+
+	if (!isSupported(format, width) || height <= 0)
+	{
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "Can't convert %s frames of %dx%d on the GPU!\n", getFramePixelFormatName(format), width, height);
+		return false;
+	}
+
+	mWidth = width;
+	mHeight = height;
+	mFormat = format;
+	mPlaneCount = getFramePlaneCount(format);
+
+	std::size_t offset = 0;
+	for (int p = 0; p < mPlaneCount; p++)
+	{
+		Plane & plane = mPlanes[p];
+		int rowBytes = getFramePlaneRowBytes(format, p, width);
+		plane.height = getFramePlaneHeight(format, p, height);
+		plane.offset = offset;
+		offset += static_cast<std::size_t>(rowBytes) * plane.height;
+
+		if (format == FRAME_FORMAT_YUYV422 || format == FRAME_FORMAT_UYVY422)
+		{
+			//one texel per pixel pair
+			plane.width = rowBytes / 4;
+			plane.internalFormat = GL_RGBA8;
+			plane.format = GL_RGBA;
+		}
+		else if (format == FRAME_FORMAT_NV12 && p == 1)
+		{
+			//interleaved u and v
+			plane.width = rowBytes / 2;
+			plane.internalFormat = GL_RG8;
+			plane.format = GL_RG;
+		}
+		else
+		{
+			plane.width = rowBytes;
+			plane.internalFormat = GL_R8;
+			plane.format = GL_RED;
+		}
+
+		glGenTextures(1, &plane.texture);
+		glBindTexture(GL_TEXTURE_2D, plane.texture);
+		glTexStorage2D(GL_TEXTURE_2D, 1, plane.internalFormat, plane.width, plane.height);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (!buildProgram())
+	{
+		cleanup();
+		return false;
+	}
+
+	mInited = true;
+
+	sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_INFO, "GPU conversion of %s frames (%dx%d)\n", getFramePixelFormatName(format), width, height);
+
+	return true;
+}
+
+bool YUVConversionPass::buildProgram()
+{
+	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	bool compiled = compileShader(vertexShader, ConversionVertexShader) && compileShader(fragmentShader, ConversionFragmentShader);
+
+	if (compiled)
+	{
+		mProgram = glCreateProgram();
+		glAttachShader(mProgram, vertexShader);
+		glAttachShader(mProgram, fragmentShader);
+		glBindFragDataLocation(mProgram, 0, "color");
+		glLinkProgram(mProgram);
+	}
+
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	if (!compiled)
+		return false;
+
+	GLint status = GL_FALSE;
+	glGetProgramiv(mProgram, GL_LINK_STATUS, &status);
+	if (status != GL_TRUE)
+	{
+		char log[1024];
+		glGetProgramInfoLog(mProgram, sizeof(log), nullptr, log);
+		sgct::MessageHandler::instance()->print(sgct::MessageHandler::NOTIFY_ERROR, "YUV conversion program failed to link:\n%s\n", log);
+		return false;
+	}
+
+	GLint previousProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glUseProgram(mProgram);
+	glUniform1i(glGetUniformLocation(mProgram, "Plane0"), 0);
+	glUniform1i(glGetUniformLocation(mProgram, "Plane1"), 1);
+	glUniform1i(glGetUniformLocation(mProgram, "Plane2"), 2);
+	mPlaneLayoutLoc = glGetUniformLocation(mProgram, "planeLayout");
+	glUseProgram(static_cast<GLuint>(previousProgram));
+
+	return true;
+}
+
+void YUVConversionPass::cleanup()
+{
+	mInited = false;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (mPlanes[i].texture)
+		{
+			glDeleteTextures(1, &mPlanes[i].texture);
+			mPlanes[i].texture = 0;
+		}
+	}
+	mPlaneCount = 0;
+
+	if (mProgram)
+	{
+		glDeleteProgram(mProgram);
+		mProgram = 0;
+	}
+}
+
+bool YUVConversionPass::isInited() const
+{
+	return mInited;
+}
+
+void YUVConversionPass::uploadPlanes(const unsigned char * data)
+{
+	if (!mInited)
+		return;
+
+	glActiveTexture(GL_TEXTURE0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int p = 0; p < mPlaneCount; p++)
+	{
+		const Plane & plane = mPlanes[p];
+		glBindTexture(GL_TEXTURE_2D, plane.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane.width, plane.height, plane.format, GL_UNSIGNED_BYTE, data + plane.offset);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void YUVConversionPass::convert(GLuint target)
+{
+	if (!mInited || !target)
+		return;
+
+	//framebuffers and vertex arrays are not shared between contexts, so they only live for this call
+	GLint previousFramebuffer = 0;
+	GLint previousProgram = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean blend = glIsEnabled(GL_BLEND);
+
+	GLuint fbo = 0;
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+	glViewport(0, 0, mWidth, mHeight);
+
+	glUseProgram(mProgram);
+	switch (mFormat)
+	{
+	case FRAME_FORMAT_YUYV422: glUniform1i(mPlaneLayoutLoc, 0); break;
+	case FRAME_FORMAT_UYVY422: glUniform1i(mPlaneLayoutLoc, 1); break;
+	case FRAME_FORMAT_NV12: glUniform1i(mPlaneLayoutLoc, 2); break;
+	default: glUniform1i(mPlaneLayoutLoc, 3); break;
+	}
+
+	for (int p = 0; p < mPlaneCount; p++)
+	{
+		glActiveTexture(GL_TEXTURE0 + p);
+		glBindTexture(GL_TEXTURE_2D, mPlanes[p].texture);
+	}
+
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	for (int p = mPlaneCount - 1; p >= 0; p--)
+	{
+		glActiveTexture(GL_TEXTURE0 + p);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	glBindVertexArray(0);
+	glDeleteVertexArrays(1, &vao);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+	glDeleteFramebuffers(1, &fbo);
+
+	glUseProgram(static_cast<GLuint>(previousProgram));
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+	if (depthTest)
+		glEnable(GL_DEPTH_TEST);
+	if (blend)
+		glEnable(GL_BLEND);
+}
+
+FramePixelFormat YUVConversionPass::getFormat() const
+{
+	return mFormat;
+}
+
+bool YUVConversionPass::isSupported(FramePixelFormat format, int width)
+{
+	switch (format)
+	{
+	case FRAME_FORMAT_YUYV422:
+	case FRAME_FORMAT_UYVY422:
+		//pixel pairs are one texel
+		return width > 0 && (width & 1) == 0;
+	case FRAME_FORMAT_NV12:
+	case FRAME_FORMAT_YUV420P:
+		return width > 0;
+	default:
+		return false;
+	}
+}
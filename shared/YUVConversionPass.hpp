@@ -0,0 +1,56 @@
+#ifndef __YUV_CONVERSION_PASS_
+#define __YUV_CONVERSION_PASS_
+
+#include <sgct.h>
+#include "CaptureFrame.hpp"
+
+//Converts YUV frames to rgb on the GPU, once per captured frame.
+//The planes are uploaded as they are (2 or 1.5 bytes per pixel instead of 3 for bgr24)
+//and drawn into an rgb texture, so every shader, freeze and copy keeps working on rgb.
+//The conversion uses the same fixed point BT.601 math as FrameConverter, the result is bit exact.
+class YUVConversionPass
+{
+public:
+	YUVConversionPass();
+	~YUVConversionPass(); //no context at exit, GL objects are only deleted by cleanup()
+
+	//any context shared with the one that converts, textures and programs are shared
+	bool init(int width, int height, FramePixelFormat format);
+	//with such a context current, owners call it before they go away (CaptureTextureRing in cleanup() and init())
+	void cleanup();
+	bool isInited() const;
+
+	//planes in the unpadded layout of FrameView::copyTo, data is an offset when a pixel unpack buffer is bound
+	void uploadPlanes(const unsigned char * data);
+	//draws the uploaded planes into an rgb texture of the frame size (current context)
+	void convert(GLuint target);
+
+	FramePixelFormat getFormat() const;
+
+	static bool isSupported(FramePixelFormat format, int width);
+
+private:
+	struct Plane
+	{
+		GLuint texture;
+		int width; //in texels
+		int height;
+		GLenum internalFormat;
+		GLenum format;
+		std::size_t offset; //in the packed frame
+	};
+
+	bool buildProgram();
+
+	Plane mPlanes[3];
+	int mPlaneCount;
+	int mWidth;
+	int mHeight;
+	FramePixelFormat mFormat;
+
+	GLuint mProgram;
+	GLint mPlaneLayoutLoc;
+	bool mInited;
+};
+
+#endif